@@ -8,80 +8,131 @@
  */
 
 #include "connmannetworkproxyfactory.h"
+#include "connmanproxyexcludes.h"
+#if HAVE_PAC
+#include "connmanpacresolver.h"
+#endif
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QDebug>
+
+// Immutable once published
+struct ConnmanProxyList
+{
+    QList<QNetworkProxy> all;
+    QList<QNetworkProxy> udpSocketOrTcpServerCapable;
+    // Hosts that are always connected to directly
+    ConnmanProxyExcludes excludes;
+#if HAVE_PAC
+    // Takes over from the lists when set
+    QSharedPointer<ConnmanPacResolver> pac;
+#endif
+};
 
 class ConnmanNetworkProxyFactoryPrivate
 {
 public:
     ConnmanNetworkProxyFactoryPrivate();
+    ~ConnmanNetworkProxyFactoryPrivate();
+
+    QList<QNetworkProxy> proxies(const QNetworkProxyQuery &query) const;
+    void publish(const ConnmanProxyList *proxies);
+
+    static ConnmanProxyList *noProxy();
+    ConnmanProxyList *parse(const QVariantMap &proxy) const;
 
     QPointer<NetworkService> m_defaultRoute;
-    QList<QNetworkProxy> m_cachedProxies_all;
-    QList<QNetworkProxy> m_cachedProxies_udpSocketOrTcpServerCapable;
     QSharedPointer<NetworkManager> m_networkManager;
+
+    // queryProxy() may be called on any thread. Readers only load the
+    // current list and copy it. Replaced lists are retired and freed once
+    // no reader is inside proxies(), later readers can't see them anymore.
+    QAtomicPointer<const ConnmanProxyList> m_proxies;
+    mutable QAtomicInt m_readers;
+    QList<const ConnmanProxyList *> m_retired;
 };
 
 ConnmanNetworkProxyFactoryPrivate::ConnmanNetworkProxyFactoryPrivate()
     : m_networkManager(NetworkManager::sharedInstance())
+    , m_proxies(noProxy())
 {
 }
 
-ConnmanNetworkProxyFactory::ConnmanNetworkProxyFactory(QObject *parent)
-    : QObject(parent)
-    , d_ptr(new ConnmanNetworkProxyFactoryPrivate)
+ConnmanNetworkProxyFactoryPrivate::~ConnmanNetworkProxyFactoryPrivate()
 {
-    connect(d_ptr->m_networkManager.data(), &NetworkManager::defaultRouteChanged,
-            this, &ConnmanNetworkProxyFactory::onDefaultRouteChanged);
-    onDefaultRouteChanged(d_ptr->m_networkManager->defaultRoute());
+    delete m_proxies.loadAcquire();
+    qDeleteAll(m_retired);
 }
 
-ConnmanNetworkProxyFactory::~ConnmanNetworkProxyFactory()
+QList<QNetworkProxy> ConnmanNetworkProxyFactoryPrivate::proxies(const QNetworkProxyQuery &query) const
 {
-    delete d_ptr;
-    d_ptr = nullptr;
-}
+    const bool udpSocketOrTcpServer = query.queryType() == QNetworkProxyQuery::UdpSocket
+            || query.queryType() == QNetworkProxyQuery::TcpServer;
 
-QList<QNetworkProxy> ConnmanNetworkProxyFactory::queryProxy(const QNetworkProxyQuery & query)
-{
-    return (query.queryType() == QNetworkProxyQuery::UdpSocket
-            || query.queryType() == QNetworkProxyQuery::TcpServer)
-        ? d_ptr->m_cachedProxies_udpSocketOrTcpServerCapable
-        : d_ptr->m_cachedProxies_all;
+    m_readers.ref();
+    const ConnmanProxyList *proxies = m_proxies.loadAcquire();
+    const bool excluded = proxies->excludes.matches(query);
+    const QList<QNetworkProxy> list(udpSocketOrTcpServer ? proxies->udpSocketOrTcpServerCapable : proxies->all);
+#if HAVE_PAC
+    const QSharedPointer<ConnmanPacResolver> pac(excluded ? QSharedPointer<ConnmanPacResolver>() : proxies->pac);
+#endif
+    m_readers.deref();
+
+    if (excluded)
+        return QList<QNetworkProxy>() << QNetworkProxy::NoProxy;
+
+#if HAVE_PAC
+    // The resolver stays alive with the reference even if replaced meanwhile
+    if (pac)
+        return pac->queryProxy(query);
+#endif
+    return list;
 }
 
-void ConnmanNetworkProxyFactory::onDefaultRouteChanged(NetworkService *defaultRoute)
+void ConnmanNetworkProxyFactoryPrivate::publish(const ConnmanProxyList *proxies)
 {
-    if (d_ptr->m_defaultRoute) {
-        d_ptr->m_defaultRoute->disconnect(this);
-        d_ptr->m_defaultRoute = nullptr;
+    m_retired.append(m_proxies.fetchAndStoreOrdered(proxies));
+    if (m_readers.loadAcquire() == 0) {
+        qDeleteAll(m_retired);
+        m_retired.clear();
     }
+}
 
-    d_ptr->m_cachedProxies_all = QList<QNetworkProxy>() << QNetworkProxy::NoProxy;
-    d_ptr->m_cachedProxies_udpSocketOrTcpServerCapable = QList<QNetworkProxy>() << QNetworkProxy::NoProxy;
-
-    if (defaultRoute) {
-        d_ptr->m_defaultRoute = defaultRoute;
-        connect(d_ptr->m_defaultRoute, SIGNAL(proxyChanged(QVariantMap)),
-                this, SLOT(onProxyChanged(QVariantMap)));
-        onProxyChanged(d_ptr->m_defaultRoute->proxy());
-    }
+ConnmanProxyList *ConnmanNetworkProxyFactoryPrivate::noProxy()
+{
+    ConnmanProxyList *proxies = new ConnmanProxyList;
+    proxies->all.append(QNetworkProxy::NoProxy);
+    proxies->udpSocketOrTcpServerCapable.append(QNetworkProxy::NoProxy);
+    return proxies;
 }
 
-void ConnmanNetworkProxyFactory::onProxyChanged(const QVariantMap &proxy)
+ConnmanProxyList *ConnmanNetworkProxyFactoryPrivate::parse(const QVariantMap &proxy) const
 {
-    d_ptr->m_cachedProxies_all.clear();
-    d_ptr->m_cachedProxies_udpSocketOrTcpServerCapable.clear();
+    ConnmanProxyList *proxies = new ConnmanProxyList;
 
     QList<QUrl> proxyUrls;
     if (proxy.value("Method").toString() == QLatin1String("auto")) {
-        const QUrl proxyUrl = proxy.value("URL").toUrl();
-        if (!proxyUrl.isEmpty()) {
-            proxyUrls.append(proxyUrl);
+        const QUrl pacUrl = proxy.value("URL").toUrl();
+#if HAVE_PAC
+        if (!pacUrl.isEmpty()) {
+            // Keep the loaded script and its cache if only something else changed
+            const ConnmanProxyList *current = m_proxies.loadAcquire();
+            proxies->pac = (current->pac && current->pac->url() == pacUrl)
+                    ? current->pac
+                    : QSharedPointer<ConnmanPacResolver>(new ConnmanPacResolver(pacUrl));
+        }
+#else
+        if (!pacUrl.isEmpty()) {
+            qWarning() << "Built without PAC support, ignoring" << pacUrl;
         }
+#endif
     } else if (proxy.value("Method").toString() == QLatin1String("manual")) {
         const QStringList proxyUrlStrings = proxy.value("Servers").toStringList();
         for (const QString &proxyUrlString : proxyUrlStrings) {
             proxyUrls.append(QUrl(proxyUrlString));
         }
+        proxies->excludes = ConnmanProxyExcludes(proxy.value("Excludes").toStringList());
     }
 
     for (const QUrl &url : proxyUrls) {
@@ -89,28 +140,72 @@ void ConnmanNetworkProxyFactory::onProxyChanged(const QVariantMap &proxy)
             QNetworkProxy proxy(QNetworkProxy::Socks5Proxy, url.host(),
                                 url.port() ? url.port() : 1080,
                                 url.userName(), url.password());
-            d_ptr->m_cachedProxies_all.append(proxy);
-            d_ptr->m_cachedProxies_udpSocketOrTcpServerCapable.append(proxy);
+            proxies->all.append(proxy);
+            proxies->udpSocketOrTcpServerCapable.append(proxy);
         } else if (url.scheme() == QLatin1String("socks5h")) {
             QNetworkProxy proxy(QNetworkProxy::Socks5Proxy, url.host(),
                                 url.port() ? url.port() : 1080,
                                 url.userName(), url.password());
             proxy.setCapabilities(QNetworkProxy::HostNameLookupCapability);
-            d_ptr->m_cachedProxies_all.append(proxy);
-            d_ptr->m_cachedProxies_udpSocketOrTcpServerCapable.append(proxy);
+            proxies->all.append(proxy);
+            proxies->udpSocketOrTcpServerCapable.append(proxy);
         } else if (url.scheme() == QLatin1String("http") || url.scheme().isEmpty()) {
             QNetworkProxy proxy(QNetworkProxy::HttpProxy, url.host(),
                                 url.port() ? url.port() : 8080,
                                 url.userName(), url.password());
-            d_ptr->m_cachedProxies_all.append(proxy);
+            proxies->all.append(proxy);
         }
     }
 
-    if (d_ptr->m_cachedProxies_all.isEmpty()) {
-        d_ptr->m_cachedProxies_all.append(QNetworkProxy::NoProxy);
+    if (proxies->all.isEmpty()) {
+        proxies->all.append(QNetworkProxy::NoProxy);
     }
 
-    if (d_ptr->m_cachedProxies_udpSocketOrTcpServerCapable.isEmpty()) {
-        d_ptr->m_cachedProxies_udpSocketOrTcpServerCapable.append(QNetworkProxy::NoProxy);
+    if (proxies->udpSocketOrTcpServerCapable.isEmpty()) {
+        proxies->udpSocketOrTcpServerCapable.append(QNetworkProxy::NoProxy);
     }
+
+    return proxies;
+}
+
+ConnmanNetworkProxyFactory::ConnmanNetworkProxyFactory(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new ConnmanNetworkProxyFactoryPrivate)
+{
+    connect(d_ptr->m_networkManager.data(), &NetworkManager::defaultRouteChanged,
+            this, &ConnmanNetworkProxyFactory::onDefaultRouteChanged);
+    onDefaultRouteChanged(d_ptr->m_networkManager->defaultRoute());
+}
+
+ConnmanNetworkProxyFactory::~ConnmanNetworkProxyFactory()
+{
+    delete d_ptr;
+    d_ptr = nullptr;
+}
+
+QList<QNetworkProxy> ConnmanNetworkProxyFactory::queryProxy(const QNetworkProxyQuery & query)
+{
+    return d_ptr->proxies(query);
+}
+
+void ConnmanNetworkProxyFactory::onDefaultRouteChanged(NetworkService *defaultRoute)
+{
+    if (d_ptr->m_defaultRoute) {
+        d_ptr->m_defaultRoute->disconnect(this);
+        d_ptr->m_defaultRoute = nullptr;
+    }
+
+    if (defaultRoute) {
+        d_ptr->m_defaultRoute = defaultRoute;
+        connect(d_ptr->m_defaultRoute, SIGNAL(proxyChanged(QVariantMap)),
+                this, SLOT(onProxyChanged(QVariantMap)));
+        onProxyChanged(d_ptr->m_defaultRoute->proxy());
+    } else {
+        d_ptr->publish(ConnmanNetworkProxyFactoryPrivate::noProxy());
+    }
+}
+
+void ConnmanNetworkProxyFactory::onProxyChanged(const QVariantMap &proxy)
+{
+    d_ptr->publish(d_ptr->parse(proxy));
 }
@@ -0,0 +1,842 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "connmanpacresolver.h"
+#include "logging.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QHostInfo>
+#include <QJSEngine>
+#include <QMutexLocker>
+#include <QNetworkAccessManager>
+#include <QNetworkInterface>
+#include <QNetworkReply>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QTimer>
+#include <QWaitCondition>
+
+static const int CacheSize = 256; // hosts
+static const qint64 CacheTtl = 5 * 60 * 1000; // ms
+static const qint64 MaxScriptSize = 1024 * 1024;
+static const int FetchTimeout = 30000; // ms
+// How long a query waits for the script, also while it's being loaded
+static const int LookupTimeout = 3000; // ms
+// Evaluations running longer are interrupted
+static const int EvaluationTimeout = 2000; // ms
+static const int DnsTimeout = 1000; // ms
+static const qint64 DnsCacheTtl = 60 * 1000; // ms
+static const int DnsCacheSize = 256; // hosts
+static const int DnsThreads = 4;
+
+// The helper functions of the PAC "standard". dnsResolve() and
+// myIpAddress() need the host, they go through ConnmanPacHelpers
+static const char PacUtils[] = R"JS(
+var __months = { JAN: 0, FEB: 1, MAR: 2, APR: 3, MAY: 4, JUN: 5,
+                 JUL: 6, AUG: 7, SEP: 8, OCT: 9, NOV: 10, DEC: 11 };
+var __weekdays = { SUN: 0, MON: 1, TUE: 2, WED: 3, THU: 4, FRI: 5, SAT: 6 };
+
+function isPlainHostName(host) {
+    return host.indexOf('.') < 0;
+}
+
+function dnsDomainIs(host, domain) {
+    return host.length >= domain.length
+        && host.substring(host.length - domain.length) == domain;
+}
+
+function localHostOrDomainIs(host, hostdom) {
+    return host == hostdom || hostdom.lastIndexOf(host + '.', 0) == 0;
+}
+
+function dnsDomainLevels(host) {
+    return host.split('.').length - 1;
+}
+
+function shExpMatch(str, pattern) {
+    pattern = pattern.replace(/[.+^${}()|[\]\\]/g, '\\$&')
+                     .replace(/\*/g, '.*').replace(/\?/g, '.');
+    return new RegExp('^' + pattern + '$').test(str);
+}
+
+function dnsResolve(host) {
+    var address = __connman.dnsResolve(host);
+    return address ? address : null;
+}
+
+function isResolvable(host) {
+    return !!__connman.dnsResolve(host);
+}
+
+function myIpAddress() {
+    return __connman.myIpAddress();
+}
+
+function __ipv4(address) {
+    var bytes = address.split('.');
+    return ((bytes[0] & 0xff) << 24 | (bytes[1] & 0xff) << 16
+            | (bytes[2] & 0xff) << 8 | (bytes[3] & 0xff)) >>> 0;
+}
+
+function isInNet(host, pattern, mask) {
+    var address = /^\d+\.\d+\.\d+\.\d+$/.test(host) ? host : __connman.dnsResolve(host);
+    if (!address || address.indexOf(':') >= 0)
+        return false;
+    var m = __ipv4(mask);
+    return ((__ipv4(address) & m) >>> 0) == ((__ipv4(pattern) & m) >>> 0);
+}
+
+function __args(args) {
+    var list = Array.prototype.slice.call(args);
+    var gmt = list.length > 0 && list[list.length - 1] == 'GMT';
+    if (gmt)
+        list.pop();
+    return { list: list, gmt: gmt, now: new Date() };
+}
+
+function __inRange(from, to, value) {
+    return from <= to ? (from <= value && value <= to) : (value >= from || value <= to);
+}
+
+function weekdayRange() {
+    var a = __args(arguments);
+    if (a.list.length < 1 || a.list.length > 2)
+        return false;
+    var from = __weekdays[a.list[0]];
+    var to = __weekdays[a.list[a.list.length - 1]];
+    if (from === undefined || to === undefined)
+        return false;
+    return __inRange(from, to, a.gmt ? a.now.getUTCDay() : a.now.getDay());
+}
+
+function dateRange() {
+    var a = __args(arguments);
+    var today = { day: a.gmt ? a.now.getUTCDate() : a.now.getDate(),
+                  month: a.gmt ? a.now.getUTCMonth() : a.now.getMonth(),
+                  year: a.gmt ? a.now.getUTCFullYear() : a.now.getFullYear() };
+    // Components left out match today's
+    function key(values) {
+        var date = { day: today.day, month: today.month, year: today.year };
+        for (var i = 0; i < values.length; ++i) {
+            if (values[i] in __months)
+                date.month = __months[values[i]];
+            else if (values[i] > 31)
+                date.year = Number(values[i]);
+            else
+                date.day = Number(values[i]);
+        }
+        return (date.year * 12 + date.month) * 32 + date.day;
+    }
+    var count = a.list.length;
+    if (count == 1)
+        return key(a.list) == key([]);
+    if (count == 0 || count % 2 || count > 6)
+        return false;
+    return __inRange(key(a.list.slice(0, count / 2)), key(a.list.slice(count / 2)), key([]));
+}
+
+function timeRange() {
+    var a = __args(arguments);
+    var h = a.gmt ? a.now.getUTCHours() : a.now.getHours();
+    var m = a.gmt ? a.now.getUTCMinutes() : a.now.getMinutes();
+    var s = a.gmt ? a.now.getUTCSeconds() : a.now.getSeconds();
+    var v = a.list.map(Number);
+    var from, to;
+    switch (v.length) {
+    case 1: from = v[0] * 3600; to = from + 3599; break;
+    case 2: from = v[0] * 3600; to = v[1] * 3600 - 1; break;
+    case 4: from = v[0] * 3600 + v[1] * 60; to = v[2] * 3600 + v[3] * 60 + 59; break;
+    case 6: from = v[0] * 3600 + v[1] * 60 + v[2]; to = v[3] * 3600 + v[4] * 60 + v[5]; break;
+    default: return false;
+    }
+    return __inRange(from, to, h * 3600 + m * 60 + s);
+}
+)JS";
+
+class ConnmanPacDns;
+
+// State shared by the querying threads, the engine thread and the
+// watchdog. The engine may still be shutting down after the resolver is
+// gone.
+class ConnmanPacShared
+{
+public:
+    enum State {
+        Loading,
+        Ready,
+        Failed
+    };
+
+    struct Entry {
+        QList<QNetworkProxy> proxies;
+        qint64 resolved;
+    };
+
+    ConnmanPacShared();
+
+    // With the mutex held. Gives the cached result, if any, and whether
+    // it's still fresh.
+    bool cached(const QString &key, QList<QNetworkProxy> *proxies) const;
+
+    void setEngine(QJSEngine *engine);
+    // False once stopped, nothing is evaluated any more then
+    bool beginEvaluation();
+    void endEvaluation();
+    // -1 if no evaluation is running
+    qint64 evaluationTime();
+    void interruptIfStuck();
+    void stop();
+
+    QMutex mutex;
+    QWaitCondition changed;
+    State state;
+    QCache<QString, Entry> cache;
+    QStringList queue;
+    QHash<QString, QString> pending; // key to host, queued or being evaluated
+    QElapsedTimer clock;
+
+private:
+    void interrupt();
+
+private:
+    QMutex m_engineMutex;
+    QJSEngine *m_engine;
+    qint64 m_evaluationStarted;
+    bool m_stopped;
+};
+
+// The only host functionality visible to the scripts
+class ConnmanPacHelpers : public QObject
+{
+    Q_OBJECT
+
+public:
+    ConnmanPacHelpers(ConnmanPacDns *dns, QObject *parent) : QObject(parent), m_dns(dns) {}
+
+    Q_INVOKABLE QString dnsResolve(const QString &host) const;
+    Q_INVOKABLE QString myIpAddress() const;
+
+private:
+    ConnmanPacDns *m_dns;
+};
+
+// Host name lookups for the scripts. They run on a thread pool and are
+// cached, a script waits for one for a bounded time only.
+class ConnmanPacDns
+{
+public:
+    ConnmanPacDns();
+    ~ConnmanPacDns();
+
+    QString resolve(const QString &host);
+    void resolved(const QString &host, const QString &address);
+
+private:
+    struct Entry {
+        QString address;
+        qint64 resolved;
+        bool pending;
+    };
+
+    void prune();
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_resolved;
+    QHash<QString, Entry> m_entries;
+    QElapsedTimer m_clock;
+    QThreadPool m_pool;
+};
+
+class ConnmanPacDnsLookup : public QRunnable
+{
+public:
+    ConnmanPacDnsLookup(ConnmanPacDns *dns, const QString &host) : m_dns(dns), m_host(host) {}
+
+    void run() override;
+
+private:
+    ConnmanPacDns *m_dns;
+    const QString m_host;
+};
+
+class ConnmanPacEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    ConnmanPacEngine(const QUrl &url, const QSharedPointer<ConnmanPacShared> &shared);
+    ~ConnmanPacEngine();
+
+Q_SIGNALS:
+    void evaluationStarted();
+
+public Q_SLOTS:
+    void load();
+    // Evaluates the queued lookups once the script has been loaded
+    void processLookups();
+
+private Q_SLOTS:
+    void onFetchFinished();
+
+private:
+    void setScript(const QByteArray &script);
+    void setState(ConnmanPacShared::State state);
+    bool findProxy(const QString &url, const QString &host, QString *result);
+
+private:
+    const QUrl m_url;
+    const QSharedPointer<ConnmanPacShared> m_shared;
+    ConnmanPacDns *m_dns;
+    QJSEngine *m_engine;
+    QNetworkAccessManager *m_network;
+    QJSValue m_findProxyForUrl;
+};
+
+// Interrupts scripts that run for too long, also when nobody is waiting
+// for them
+class ConnmanPacWatchdog : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ConnmanPacWatchdog(const QSharedPointer<ConnmanPacShared> &shared);
+
+public Q_SLOTS:
+    void arm();
+
+private Q_SLOTS:
+    void check();
+
+private:
+    const QSharedPointer<ConnmanPacShared> m_shared;
+    QTimer m_timer;
+};
+
+// ==========================================================================
+// ConnmanPacShared
+// ==========================================================================
+
+ConnmanPacShared::ConnmanPacShared()
+    : state(Loading)
+    , cache(CacheSize)
+    , m_engine(nullptr)
+    , m_evaluationStarted(-1)
+    , m_stopped(false)
+{
+    clock.start();
+}
+
+bool ConnmanPacShared::cached(const QString &key, QList<QNetworkProxy> *proxies) const
+{
+    const Entry *entry = cache.object(key);
+    if (!entry)
+        return false;
+
+    *proxies = entry->proxies;
+    return clock.elapsed() - entry->resolved < CacheTtl;
+}
+
+void ConnmanPacShared::setEngine(QJSEngine *engine)
+{
+    QMutexLocker locker(&m_engineMutex);
+    m_engine = engine;
+}
+
+bool ConnmanPacShared::beginEvaluation()
+{
+    QMutexLocker locker(&m_engineMutex);
+    if (m_stopped)
+        return false;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5,14,0)
+    if (m_engine)
+        m_engine->setInterrupted(false);
+#endif
+    m_evaluationStarted = clock.elapsed();
+    return true;
+}
+
+void ConnmanPacShared::endEvaluation()
+{
+    QMutexLocker locker(&m_engineMutex);
+    m_evaluationStarted = -1;
+}
+
+qint64 ConnmanPacShared::evaluationTime()
+{
+    QMutexLocker locker(&m_engineMutex);
+    return m_evaluationStarted < 0 ? -1 : clock.elapsed() - m_evaluationStarted;
+}
+
+void ConnmanPacShared::interruptIfStuck()
+{
+    QMutexLocker locker(&m_engineMutex);
+    if (m_evaluationStarted >= 0 && clock.elapsed() - m_evaluationStarted >= EvaluationTimeout) {
+        qWarning() << "PAC script running for too long, interrupting it";
+        interrupt();
+    }
+}
+
+void ConnmanPacShared::stop()
+{
+    QMutexLocker locker(&m_engineMutex);
+    m_stopped = true;
+    interrupt();
+}
+
+void ConnmanPacShared::interrupt()
+{
+    // Before Qt 5.14 a script can't be interrupted, the queries still
+    // time out
+#if QT_VERSION >= QT_VERSION_CHECK(5,14,0)
+    if (m_engine)
+        m_engine->setInterrupted(true);
+#endif
+}
+
+// ==========================================================================
+// ConnmanPacHelpers
+// ==========================================================================
+
+QString ConnmanPacHelpers::dnsResolve(const QString &host) const
+{
+    return m_dns->resolve(host);
+}
+
+QString ConnmanPacHelpers::myIpAddress() const
+{
+    const QList<QHostAddress> addresses(QNetworkInterface::allAddresses());
+    for (const QHostAddress &address : addresses) {
+        if (address.protocol() == QAbstractSocket::IPv4Protocol && !address.isLoopback())
+            return address.toString();
+    }
+    return QStringLiteral("127.0.0.1");
+}
+
+// ==========================================================================
+// ConnmanPacDns
+// ==========================================================================
+
+ConnmanPacDns::ConnmanPacDns()
+{
+    m_clock.start();
+    m_pool.setMaxThreadCount(DnsThreads);
+}
+
+ConnmanPacDns::~ConnmanPacDns()
+{
+    // On the engine thread, a lookup in progress isn't waited for on the
+    // thread of the resolver
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+QString ConnmanPacDns::resolve(const QString &host)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QHash<QString, Entry>::ConstIterator it = m_entries.constFind(host);
+    if (it == m_entries.constEnd() || (!it->pending && m_clock.elapsed() - it->resolved >= DnsCacheTtl)) {
+        prune();
+        Entry entry;
+        entry.resolved = -1;
+        entry.pending = true;
+        m_entries.insert(host, entry);
+        m_pool.start(new ConnmanPacDnsLookup(this, host));
+    }
+
+    QElapsedTimer waiting;
+    waiting.start();
+    while (m_entries.value(host).pending) {
+        const qint64 remaining = DnsTimeout - waiting.elapsed();
+        if (remaining <= 0 || !m_resolved.wait(&m_mutex, static_cast<unsigned long>(remaining))) {
+            qCDebug(lcConnman) << "PAC lookup of" << host << "timed out";
+            return QString();
+        }
+    }
+    return m_entries.value(host).address;
+}
+
+void ConnmanPacDns::resolved(const QString &host, const QString &address)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QHash<QString, Entry>::Iterator it = m_entries.find(host);
+    if (it != m_entries.end()) {
+        it->address = address;
+        it->resolved = m_clock.elapsed();
+        it->pending = false;
+    }
+    m_resolved.wakeAll();
+}
+
+// With the mutex held, lookups in progress are kept
+void ConnmanPacDns::prune()
+{
+    if (m_entries.count() < DnsCacheSize)
+        return;
+
+    QHash<QString, Entry>::Iterator it = m_entries.begin();
+    while (it != m_entries.end()) {
+        if (!it->pending)
+            it = m_entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+void ConnmanPacDnsLookup::run()
+{
+    const QList<QHostAddress> addresses(QHostInfo::fromName(m_host).addresses());
+    QString resolved(addresses.isEmpty() ? QString() : addresses.first().toString());
+    for (const QHostAddress &address : addresses) {
+        if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+            resolved = address.toString();
+            break;
+        }
+    }
+    m_dns->resolved(m_host, resolved);
+}
+
+// ==========================================================================
+// ConnmanPacEngine
+// ==========================================================================
+
+ConnmanPacEngine::ConnmanPacEngine(const QUrl &url, const QSharedPointer<ConnmanPacShared> &shared)
+    : m_url(url)
+    , m_shared(shared)
+    , m_dns(nullptr)
+    , m_engine(nullptr)
+    , m_network(nullptr)
+{
+}
+
+ConnmanPacEngine::~ConnmanPacEngine()
+{
+    m_shared->setEngine(nullptr);
+    delete m_dns;
+}
+
+void ConnmanPacEngine::load()
+{
+    if (m_url.isLocalFile()) {
+        QFile file(m_url.toLocalFile());
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Failed to open PAC file" << file.fileName() << file.errorString();
+            setState(ConnmanPacShared::Failed);
+        } else {
+            setScript(file.read(MaxScriptSize));
+        }
+    } else if (m_url.scheme() == QLatin1String("http") || m_url.scheme() == QLatin1String("https")) {
+        m_network = new QNetworkAccessManager(this);
+        // Must not ask the application proxy factory, that is us
+        m_network->setProxy(QNetworkProxy::NoProxy);
+
+        QNetworkRequest request(m_url);
+#if (QT_VERSION >= QT_VERSION_CHECK(5,6,0)) && (QT_VERSION < QT_VERSION_CHECK(6,0,0))
+        request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+#endif
+#if (QT_VERSION >= QT_VERSION_CHECK(5,15,0))
+        request.setTransferTimeout(FetchTimeout);
+#endif
+        QNetworkReply *reply = m_network->get(request);
+        connect(reply, SIGNAL(finished()), this, SLOT(onFetchFinished()));
+    } else {
+        qWarning() << "Unsupported PAC URL" << m_url;
+        setState(ConnmanPacShared::Failed);
+    }
+}
+
+void ConnmanPacEngine::onFetchFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    reply->deleteLater();
+
+    if (reply->error() != QNetworkReply::NoError) {
+        qWarning() << "Failed to fetch PAC file" << m_url << reply->errorString();
+        setState(ConnmanPacShared::Failed);
+    } else {
+        setScript(reply->read(MaxScriptSize));
+    }
+}
+
+void ConnmanPacEngine::setScript(const QByteArray &script)
+{
+    m_dns = new ConnmanPacDns;
+
+    // No extensions installed, the scripts can't reach anything but the
+    // helpers
+    m_engine = new QJSEngine(this);
+    m_shared->setEngine(m_engine);
+    QJSValue helpers(m_engine->newQObject(new ConnmanPacHelpers(m_dns, this)));
+    m_engine->globalObject().setProperty(QStringLiteral("__connman"), helpers);
+    m_engine->evaluate(QString::fromLatin1(PacUtils));
+
+    if (!m_shared->beginEvaluation()) {
+        setState(ConnmanPacShared::Failed);
+        return;
+    }
+    Q_EMIT evaluationStarted();
+    const QJSValue result(m_engine->evaluate(QString::fromUtf8(script), m_url.toString()));
+    m_shared->endEvaluation();
+    m_findProxyForUrl = m_engine->globalObject().property(QStringLiteral("FindProxyForURL"));
+
+    if (result.isError()) {
+        qWarning() << "Failed to evaluate PAC file" << m_url << result.toString();
+        setState(ConnmanPacShared::Failed);
+    } else if (!m_findProxyForUrl.isCallable()) {
+        qWarning() << "No FindProxyForURL in PAC file" << m_url;
+        setState(ConnmanPacShared::Failed);
+    } else {
+        qCDebug(lcConnman) << "Loaded PAC file" << m_url;
+        setState(ConnmanPacShared::Ready);
+    }
+}
+
+void ConnmanPacEngine::setState(ConnmanPacShared::State state)
+{
+    {
+        QMutexLocker locker(&m_shared->mutex);
+        m_shared->state = state;
+    }
+    processLookups();
+}
+
+void ConnmanPacEngine::processLookups()
+{
+    for (;;) {
+        QString key;
+        QString host;
+        {
+            QMutexLocker locker(&m_shared->mutex);
+            if (m_shared->state == ConnmanPacShared::Loading) {
+                return;
+            } else if (m_shared->state == ConnmanPacShared::Failed) {
+                m_shared->queue.clear();
+                m_shared->pending.clear();
+                m_shared->changed.wakeAll();
+                return;
+            } else if (m_shared->queue.isEmpty()) {
+                return;
+            }
+            key = m_shared->queue.takeFirst();
+            host = m_shared->pending.value(key);
+        }
+
+        QString result;
+        const bool found = findProxy(key, host, &result);
+
+        QMutexLocker locker(&m_shared->mutex);
+        if (found) {
+            ConnmanPacShared::Entry *entry = new ConnmanPacShared::Entry;
+            entry->proxies = ConnmanPacResolver::parseResult(result);
+            entry->resolved = m_shared->clock.elapsed();
+            m_shared->cache.insert(key, entry);
+        }
+        m_shared->pending.remove(key);
+        m_shared->changed.wakeAll();
+    }
+}
+
+bool ConnmanPacEngine::findProxy(const QString &url, const QString &host, QString *result)
+{
+    if (!m_shared->beginEvaluation())
+        return false;
+
+    Q_EMIT evaluationStarted();
+    const QJSValue value(m_findProxyForUrl.call(QJSValueList() << url << host));
+    m_shared->endEvaluation();
+
+    if (value.isError() || !value.isString()) {
+        qWarning() << "FindProxyForURL failed for" << host << value.toString();
+        return false;
+    }
+    *result = value.toString();
+    return true;
+}
+
+// ==========================================================================
+// ConnmanPacWatchdog
+// ==========================================================================
+
+ConnmanPacWatchdog::ConnmanPacWatchdog(const QSharedPointer<ConnmanPacShared> &shared)
+    : m_shared(shared)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(check()));
+}
+
+void ConnmanPacWatchdog::arm()
+{
+    if (!m_timer.isActive())
+        m_timer.start(EvaluationTimeout);
+}
+
+void ConnmanPacWatchdog::check()
+{
+    m_shared->interruptIfStuck();
+
+    // Another evaluation may have started meanwhile
+    const qint64 running = m_shared->evaluationTime();
+    if (running >= 0)
+        m_timer.start(running < EvaluationTimeout ? int(EvaluationTimeout - running) : EvaluationTimeout);
+}
+
+// ==========================================================================
+// ConnmanPacResolver
+// ==========================================================================
+
+ConnmanPacResolver::ConnmanPacResolver(const QUrl &url)
+    : m_url(url)
+    , m_shared(new ConnmanPacShared)
+    , m_thread(new QThread)
+    , m_engine(new ConnmanPacEngine(url, m_shared))
+    , m_watchdog(new ConnmanPacWatchdog(m_shared))
+{
+    m_engine->moveToThread(m_thread);
+    QObject::connect(m_thread, SIGNAL(finished()), m_engine, SLOT(deleteLater()));
+    QObject::connect(m_thread, SIGNAL(finished()), m_thread, SLOT(deleteLater()));
+    QObject::connect(m_engine, SIGNAL(evaluationStarted()), m_watchdog, SLOT(arm()));
+    m_thread->start();
+    QMetaObject::invokeMethod(m_engine, "load", Qt::QueuedConnection);
+}
+
+ConnmanPacResolver::~ConnmanPacResolver()
+{
+    // The last reference may be dropped on any thread, including the GUI
+    // thread while the proxies are being published. The thread isn't
+    // joined, a running script is interrupted and the engine and the
+    // thread are deleted once it has finished.
+    m_shared->stop();
+    m_thread->quit();
+
+    if (m_watchdog->thread() == QThread::currentThread())
+        delete m_watchdog;
+    else
+        m_watchdog->deleteLater();
+}
+
+QUrl ConnmanPacResolver::url() const
+{
+    return m_url;
+}
+
+QList<QNetworkProxy> ConnmanPacResolver::queryProxy(const QNetworkProxyQuery &query)
+{
+    const bool socketOnly = query.queryType() == QNetworkProxyQuery::UdpSocket
+            || query.queryType() == QNetworkProxyQuery::TcpServer;
+
+    QUrl origin;
+    if (query.queryType() == QNetworkProxyQuery::UrlRequest) {
+        origin.setScheme(query.url().scheme());
+        origin.setHost(query.url().host());
+        origin.setPort(query.url().port());
+    } else {
+        const QString tag(query.protocolTag());
+        origin.setScheme(!tag.isEmpty() ? tag
+                         : query.queryType() == QNetworkProxyQuery::UdpSocket ? QStringLiteral("udp")
+                         : QStringLiteral("tcp"));
+        origin.setHost(query.peerHostName());
+        origin.setPort(query.peerPort());
+    }
+    origin.setPath(QStringLiteral("/"));
+
+    QList<QNetworkProxy> proxies;
+    if (origin.host().isEmpty()) {
+        proxies.append(QNetworkProxy::NoProxy);
+        return proxies;
+    }
+
+    const QString key(origin.toString());
+    bool fresh = false;
+    bool waited = false;
+    {
+        QMutexLocker locker(&m_shared->mutex);
+        fresh = m_shared->cached(key, &proxies);
+
+        // The engine itself never asks, but it must not wait for itself
+        if (!fresh && m_shared->state != ConnmanPacShared::Failed
+                && QThread::currentThread() != m_thread) {
+            if (!m_shared->pending.contains(key)) {
+                m_shared->pending.insert(key, origin.host());
+                m_shared->queue.append(key);
+                if (m_shared->queue.count() == 1)
+                    QMetaObject::invokeMethod(m_engine, "processLookups", Qt::QueuedConnection);
+            }
+
+            QElapsedTimer waiting;
+            waiting.start();
+            while (m_shared->pending.contains(key)) {
+                const qint64 remaining = LookupTimeout - waiting.elapsed();
+                if (remaining <= 0
+                        || !m_shared->changed.wait(&m_shared->mutex, static_cast<unsigned long>(remaining))) {
+                    break;
+                }
+            }
+            fresh = m_shared->cached(key, &proxies);
+            waited = true;
+        }
+    }
+
+    if (waited && !fresh) {
+        m_shared->interruptIfStuck();
+        qWarning() << "No PAC result for" << key
+                   << (proxies.isEmpty() ? "connecting directly" : "using the previous one");
+    }
+
+    if (socketOnly) {
+        QList<QNetworkProxy>::Iterator it = proxies.begin();
+        while (it != proxies.end()) {
+            if (it->type() == QNetworkProxy::HttpProxy)
+                it = proxies.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    if (proxies.isEmpty())
+        proxies.append(QNetworkProxy::NoProxy);
+    return proxies;
+}
+
+QList<QNetworkProxy> ConnmanPacResolver::parseResult(const QString &result)
+{
+    QList<QNetworkProxy> proxies;
+
+    const QStringList entries(result.split(QLatin1Char(';')));
+    for (const QString &entry : entries) {
+        const QStringList parts(entry.simplified().split(QLatin1Char(' ')));
+        const QString type(parts.first().toUpper());
+
+        if (type == QLatin1String("DIRECT")) {
+            proxies.append(QNetworkProxy::NoProxy);
+            continue;
+        } else if (parts.count() < 2) {
+            continue;
+        }
+
+        const QUrl server(QStringLiteral("//") + parts.at(1));
+        if (server.host().isEmpty()) {
+            continue;
+        } else if (type == QLatin1String("PROXY") || type == QLatin1String("HTTP")) {
+            proxies.append(QNetworkProxy(QNetworkProxy::HttpProxy, server.host(), server.port(8080)));
+        } else if (type == QLatin1String("SOCKS") || type == QLatin1String("SOCKS5")) {
+            proxies.append(QNetworkProxy(QNetworkProxy::Socks5Proxy, server.host(), server.port(1080)));
+        } else {
+            // HTTPS and SOCKS4 proxies are not supported by Qt
+            qCDebug(lcConnman) << "Skipping PAC entry" << entry;
+        }
+    }
+
+    return proxies;
+}
+
+#include "connmanpacresolver.moc"
@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef CONNMANPACRESOLVER_H
+#define CONNMANPACRESOLVER_H
+
+#include <QNetworkProxy>
+#include <QSharedPointer>
+#include <QThread>
+#include <QUrl>
+
+class ConnmanPacEngine;
+class ConnmanPacShared;
+class ConnmanPacWatchdog;
+
+/*
+ * Resolves proxies with a proxy auto-config script, as announced by
+ * ConnMan with the "auto" proxy method.
+ *
+ * The script is fetched (file, http or https) and run on a worker thread
+ * in a script engine of its own, which only has the ECMAScript built-ins
+ * and the PAC helper functions. FindProxyForURL() sees the origin of the
+ * request only, its results are cached per scheme, host and port for a
+ * few minutes. The DNS lookups of the script run on a thread pool with a
+ * timeout and are cached as well.
+ *
+ * queryProxy() may be called from any thread. It waits a few seconds at
+ * most for the script, also while it's still being loaded. Evaluations
+ * that run for too long are interrupted (Qt 5.14 or later). Without a
+ * result from the script the previous one for the host is used, or a
+ * direct connection if there is none, with a warning. If the script
+ * fails to load all hosts are direct.
+ */
+class ConnmanPacResolver
+{
+public:
+    explicit ConnmanPacResolver(const QUrl &url);
+    ~ConnmanPacResolver();
+
+    QUrl url() const;
+    QList<QNetworkProxy> queryProxy(const QNetworkProxyQuery &query);
+
+    // Parses a FindProxyForURL() result, unsupported entries are skipped
+    static QList<QNetworkProxy> parseResult(const QString &result);
+
+private:
+    Q_DISABLE_COPY(ConnmanPacResolver)
+
+    const QUrl m_url;
+    const QSharedPointer<ConnmanPacShared> m_shared;
+    // Deletes itself once stopped, it's not joined
+    QThread *m_thread;
+    ConnmanPacEngine *m_engine;
+    ConnmanPacWatchdog *m_watchdog;
+};
+
+#endif // CONNMANPACRESOLVER_H
@@ -0,0 +1,165 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "connmanproxyexcludes.h"
+#include "logging.h"
+
+#include <QUrl>
+
+#include <algorithm>
+
+static int compareLabel(const QString &label, const QChar *other, int length)
+{
+    const int common = qMin(label.length(), length);
+    const QChar *data = label.constData();
+    for (int i = 0; i < common; ++i) {
+        if (data[i] != other[i])
+            return data[i].unicode() < other[i].unicode() ? -1 : 1;
+    }
+    return label.length() - length;
+}
+
+ConnmanProxyExcludes::ConnmanProxyExcludes()
+    : m_all(false)
+{
+}
+
+ConnmanProxyExcludes::ConnmanProxyExcludes(const QStringList &excludes)
+    : m_all(false)
+{
+    for (const QString &exclude : excludes) {
+        QString pattern(exclude.trimmed().toLower());
+        if (pattern.isEmpty())
+            continue;
+
+        if (pattern == QLatin1String("*")) {
+            m_all = true;
+            continue;
+        }
+
+        if (pattern.contains(QLatin1Char('/'))) {
+            const QPair<QHostAddress, int> subnet(QHostAddress::parseSubnet(pattern));
+            if (subnet.first.isNull())
+                qWarning() << "Invalid proxy exclude" << exclude;
+            else
+                m_subnets.append(subnet);
+            continue;
+        }
+
+        const QHostAddress address(pattern);
+        if (!address.isNull()) {
+            m_subnets.append(qMakePair(address, address.protocol() == QAbstractSocket::IPv6Protocol ? 128 : 32));
+            continue;
+        }
+
+        int flags = MatchDomain | MatchSubdomains;
+        if (pattern.startsWith(QLatin1String("*."))) {
+            pattern.remove(0, 2);
+            flags = MatchSubdomains;
+        } else if (pattern.startsWith(QLatin1Char('.'))) {
+            pattern.remove(0, 1);
+        }
+
+        if (pattern.endsWith(QLatin1Char('.')))
+            pattern.chop(1);
+
+        if (pattern.isEmpty() || pattern.contains(QLatin1Char('*'))) {
+            qWarning() << "Unsupported proxy exclude" << exclude;
+            continue;
+        }
+
+        addDomain(pattern, flags);
+    }
+}
+
+void ConnmanProxyExcludes::addDomain(const QString &domain, int flags)
+{
+    if (m_nodes.isEmpty())
+        m_nodes.append(Node());
+
+    int node = 0;
+    const QStringList labels(domain.split(QLatin1Char('.')));
+    for (int i = labels.count() - 1; i >= 0; --i) {
+        const QString &label = labels.at(i);
+        bool found;
+        const int index = findChild(node, label.constData(), label.length(), &found);
+        if (found) {
+            node = m_nodes.at(node).children.at(index).node;
+        } else {
+            // Don't keep a reference to the parent across the append
+            const Child child = { label, m_nodes.count() };
+            m_nodes.append(Node());
+            m_nodes[node].children.insert(index, child);
+            node = child.node;
+        }
+    }
+    m_nodes[node].flags |= flags;
+}
+
+// Returns the index of the label among the children of the node, or where
+// it would be inserted
+int ConnmanProxyExcludes::findChild(int node, const QChar *label, int length, bool *found) const
+{
+    const QVector<Child> &children = m_nodes.at(node).children;
+    QVector<Child>::ConstIterator it = std::lower_bound(children.constBegin(), children.constEnd(), 0,
+            [label, length](const Child &child, int) {
+                return compareLabel(child.label, label, length) < 0;
+            });
+
+    *found = it != children.constEnd() && compareLabel(it->label, label, length) == 0;
+    return int(it - children.constBegin());
+}
+
+bool ConnmanProxyExcludes::isEmpty() const
+{
+    return !m_all && m_nodes.isEmpty() && m_subnets.isEmpty();
+}
+
+bool ConnmanProxyExcludes::matches(const QString &host) const
+{
+    if (m_all)
+        return true;
+
+    if (host.isEmpty() || isEmpty())
+        return false;
+
+    QHostAddress address;
+    if (address.setAddress(host)) {
+        for (const QPair<QHostAddress, int> &subnet : m_subnets) {
+            if (address.isInSubnet(subnet))
+                return true;
+        }
+        return false;
+    }
+
+    if (m_nodes.isEmpty())
+        return false;
+
+    const QString name(host.toLower());
+    int end = name.endsWith(QLatin1Char('.')) ? name.length() - 1 : name.length();
+    int node = 0;
+    while (end > 0) {
+        const int dot = name.lastIndexOf(QLatin1Char('.'), end - 1);
+        bool found;
+        const int index = findChild(node, name.constData() + dot + 1, end - dot - 1, &found);
+        if (!found)
+            return false;
+
+        node = m_nodes.at(node).children.at(index).node;
+        if (m_nodes.at(node).flags & ((dot < 0) ? MatchDomain : MatchSubdomains))
+            return true;
+        end = dot;
+    }
+    return false;
+}
+
+bool ConnmanProxyExcludes::matches(const QNetworkProxyQuery &query) const
+{
+    return matches(query.queryType() == QNetworkProxyQuery::UrlRequest
+                   ? query.url().host() : query.peerHostName());
+}
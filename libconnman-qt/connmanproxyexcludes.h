@@ -0,0 +1,66 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef CONNMANPROXYEXCLUDES_H
+#define CONNMANPROXYEXCLUDES_H
+
+#include <QHostAddress>
+#include <QNetworkProxy>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+/*
+ * Matches hosts against the "Excludes" of a ConnMan proxy configuration.
+ *
+ * Domain names are compiled into a trie of labels, starting from the top
+ * level domain, so a lookup takes one binary search per label of the host.
+ * The labels are compared in place, matching doesn't allocate per label.
+ * "example.com" and ".example.com" match the domain and all its
+ * subdomains, "*.example.com" only the subdomains. IP addresses and
+ * subnets ("10.0.0.0/8", "fe80::/10") are matched against addresses
+ * only, "*" matches everything.
+ */
+class ConnmanProxyExcludes
+{
+public:
+    ConnmanProxyExcludes();
+    explicit ConnmanProxyExcludes(const QStringList &excludes);
+
+    bool isEmpty() const;
+    bool matches(const QString &host) const;
+    bool matches(const QNetworkProxyQuery &query) const;
+
+private:
+    enum MatchFlag {
+        MatchDomain = 0x01,
+        MatchSubdomains = 0x02
+    };
+
+    struct Child {
+        QString label;
+        int node;
+    };
+
+    struct Node {
+        Node() : flags(0) {}
+
+        QVector<Child> children; // sorted by label
+        int flags;
+    };
+
+    void addDomain(const QString &domain, int flags);
+    int findChild(int node, const QChar *label, int length, bool *found) const;
+
+private:
+    bool m_all;
+    QVector<Node> m_nodes; // m_nodes[0] is the root
+    QVector<QPair<QHostAddress, int> > m_subnets;
+};
+
+#endif // CONNMANPROXYEXCLUDES_H
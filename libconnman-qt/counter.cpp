@@ -7,39 +7,40 @@
  *
  */
 
-#include <QtDBus/QDBusConnection>
-#if (QT_VERSION >= QT_VERSION_CHECK(5,10,0))
-#include <QRandomGenerator>
-#endif
-
 #include "counter.h"
-#include "networkmanager.h"
+#include "counterhub.h"
 
-class CounterAdaptor : public QDBusAbstractAdaptor
-{
-    Q_OBJECT
-    Q_CLASSINFO("D-Bus Interface", "net.connman.Counter")
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
 
-public:
-    explicit CounterAdaptor(Counter *parent);
-    virtual ~CounterAdaptor();
+// Reports in a row it takes to halve or double the adaptive interval
+static const int BusyReports = 2;
+static const int IdleReports = 3;
 
-public Q_SLOTS:
-    void Release();
-    void Usage(const QDBusObjectPath &service_path,
-                                const QVariantMap &home,
-                                const QVariantMap &roaming);
+namespace {
 
-private:
-    Counter *m_counter;
+// The reports of one service, for its throughput
+struct Throughput
+{
+    Throughput() : rx(0), tx(0), rate(0), busy(0), idle(0) {}
+
+    QElapsedTimer lastReport;
+    quint64 rx;
+    quint64 tx;
+    double rate;  // bytes per second
+    int busy;     // reports in a row
+    int idle;
 };
 
+}
+
 class CounterPrivate
 {
 public:
     CounterPrivate();
 
-    QSharedPointer<NetworkManager> m_manager;
+    QSharedPointer<CounterHub> m_hub;
 
     quint64 bytesInHome;
     quint64 bytesOutHome;
@@ -53,14 +54,23 @@ public:
     quint32 currentInterval;
     quint32 currentAccuracy;
 
-    QString counterPath;
     bool shouldBeRunning;
 
     bool registered;
+
+    bool adaptive;
+    quint32 minimumInterval;
+    quint32 maximumInterval;
+    quint32 adaptiveInterval;
+    quint64 quota;
+    quint64 quotaUsed;
+
+    // Per service path and roaming
+    QHash<QPair<QString, bool>, Throughput> throughput;
 };
 
 CounterPrivate::CounterPrivate()
-    : m_manager(NetworkManager::sharedInstance())
+    : m_hub(CounterHub::sharedInstance())
     , bytesInHome(0)
     , bytesOutHome(0)
     , secondsOnlineHome(0)
@@ -72,6 +82,12 @@ CounterPrivate::CounterPrivate()
     , currentAccuracy(1024)
     , shouldBeRunning(false)
     , registered(false)
+    , adaptive(false)
+    , minimumInterval(1)
+    , maximumInterval(60)
+    , adaptiveInterval(1)
+    , quota(0)
+    , quotaUsed(0)
 {
 }
 
@@ -79,29 +95,11 @@ Counter::Counter(QObject *parent)
     : QObject(parent)
     , d_ptr(new CounterPrivate)
 {
-#if (QT_VERSION >= QT_VERSION_CHECK(5,10,0))
-    quint32 randomValue = QRandomGenerator::global()->generate();
-#else
-    QTime time = QTime::currentTime();
-    qsrand((uint)time.msec());
-    int randomValue = qrand();
-#endif
-
-    //this needs to be unique so we can use more than one at a time with different processes
-    d_ptr->counterPath = "/ConnectivityCounter" + QString::number(randomValue);
-
-    new CounterAdaptor(this);
-    if (!QDBusConnection::systemBus().registerObject(d_ptr->counterPath, this))
-        qWarning("Could not register DBus object on %s", qPrintable(d_ptr->counterPath));
-
-    connect(d_ptr->m_manager.data(), &NetworkManager::availabilityChanged,
-            this, &Counter::updateCounterAgent);
 }
 
 Counter::~Counter()
 {
-    if (d_ptr->registered)
-        d_ptr->m_manager->unregisterCounter(d_ptr->counterPath);
+    d_ptr->m_hub->detach(this);
 
     delete d_ptr;
     d_ptr = nullptr;
@@ -148,12 +146,112 @@ void Counter::serviceUsage(const QString &servicePath, const QVariantMap &counte
         Q_EMIT bytesTransmittedChanged(txbytes);
     if (time != 0)
         Q_EMIT secondsOnlineChanged(time);
+
+    adapt(servicePath, counters, roaming);
 }
 
-void Counter::release()
+/*
+ * Reports come when the accuracy is reached or the interval has passed.
+ * Less than a quarter of the accuracy in an interval counts as idle, the
+ * whole accuracy as busy. Each interval change re-registers the counter,
+ * so the interval is only halved after BusyReports busy reports of a
+ * service in a row, and only doubled after IdleReports idle ones while no
+ * other service is busy.
+ *
+ * The bytes moved on all services count against the quota.
+ */
+void Counter::adapt(const QString &servicePath, const QVariantMap &counters, bool roaming)
 {
-    d_ptr->registered = false;
-    Q_EMIT runningChanged(d_ptr->registered);
+    Throughput &service = d_ptr->throughput[qMakePair(servicePath, roaming)];
+    const quint64 rx = counters.value("RX.Bytes", service.rx).toULongLong();
+    const quint64 tx = counters.value("TX.Bytes", service.tx).toULongLong();
+
+    // The first report has the bytes since some earlier time
+    const bool continued = service.lastReport.isValid() && rx >= service.rx && tx >= service.tx;
+    const qint64 elapsed = continued ? service.lastReport.restart() : 0;
+    if (!continued)
+        service.lastReport.start();
+    const quint64 moved = continued ? (rx - service.rx) + (tx - service.tx) : 0;
+    service.rx = rx;
+    service.tx = tx;
+    service.rate = elapsed > 0 ? moved * 1000.0 / elapsed : 0.0;
+    d_ptr->quotaUsed += moved;
+
+    if (!d_ptr->adaptive || !continued)
+        return;
+
+    const quint64 threshold = quint64(d_ptr->currentAccuracy) * 1024;
+    if (moved >= threshold) {
+        service.busy++;
+        service.idle = 0;
+    } else if (moved < threshold / 4) {
+        service.idle++;
+        service.busy = 0;
+    } else {
+        service.busy = 0;
+        service.idle = 0;
+    }
+
+    // Services that haven't reported for a while are gone
+    const qint64 expiry = qint64(d_ptr->maximumInterval) * 2000;
+    QList<QPair<QString, bool> > expired;
+    double rate = 0;
+    bool busyElsewhere = false;
+    for (QHash<QPair<QString, bool>, Throughput>::ConstIterator it = d_ptr->throughput.constBegin();
+            it != d_ptr->throughput.constEnd(); ++it) {
+        if (it.value().lastReport.hasExpired(expiry)) {
+            expired.append(it.key());
+        } else {
+            rate += it.value().rate;
+            busyElsewhere = busyElsewhere || (&it.value() != &service && it.value().busy > 0);
+        }
+    }
+
+    bool quotaNear = false;
+    if (d_ptr->quota) {
+        const quint64 remaining = d_ptr->quotaUsed < d_ptr->quota ? d_ptr->quota - d_ptr->quotaUsed : 0;
+        quotaNear = remaining <= d_ptr->quota / 10
+                || rate * d_ptr->maximumInterval >= double(remaining);
+    }
+
+    quint32 interval = d_ptr->adaptiveInterval;
+    if (quotaNear) {
+        interval = d_ptr->minimumInterval;
+    } else if (service.busy >= BusyReports) {
+        interval /= 2;
+        service.busy = 0;
+    } else if (service.idle >= IdleReports && !busyElsewhere) {
+        interval *= 2;
+        service.idle = 0;
+    }
+
+    // Not before, removing may move the others
+    for (const QPair<QString, bool> &key : expired)
+        d_ptr->throughput.remove(key);
+
+    setAdaptiveInterval(interval);
+}
+
+void Counter::setAdaptiveInterval(quint32 interval)
+{
+    interval = qBound(d_ptr->minimumInterval, interval, d_ptr->maximumInterval);
+    if (d_ptr->adaptiveInterval == interval)
+        return;
+
+    d_ptr->adaptiveInterval = interval;
+    if (d_ptr->adaptive) {
+        Q_EMIT effectiveIntervalChanged(interval);
+        if (d_ptr->shouldBeRunning)
+            updateCounterAgent();
+    }
+}
+
+void Counter::setRegistered(bool registered)
+{
+    if (d_ptr->registered != registered) {
+        d_ptr->registered = registered;
+        Q_EMIT runningChanged(d_ptr->registered);
+    }
 }
 
 bool Counter::roaming() const
@@ -192,8 +290,11 @@ quint32 Counter::secondsOnline() const
  *The accuracy value is in kilo-bytes. It defines
             the update threshold.
 
-Changing the accuracy will reset the counters, as it will
-need to be re registered from the manager.
+The counter registration is shared with the other counters of the
+process, it is only re-registered if the accuracy becomes the smallest
+one. Otherwise the updates are only passed on less often. Changes made
+together are applied with one re-registration on the next turn of the
+event loop, and the counters continue from their values.
 */
 void Counter::setAccuracy(quint32 accuracy)
 {
@@ -212,8 +313,8 @@ quint32 Counter::accuracy() const
 
 /*
  *The interval value is in seconds.
-Changing the accuracy will reset the counters, as it will
-need to be re registered from the manager.
+Like the accuracy, it only causes a re-registration if it becomes the
+smallest interval of the process.
 */
 void Counter::setInterval(quint32 interval)
 {
@@ -222,7 +323,10 @@ void Counter::setInterval(quint32 interval)
 
     d_ptr->currentInterval = interval;
     Q_EMIT intervalChanged(interval);
-    updateCounterAgent();
+    if (!d_ptr->adaptive) {
+        Q_EMIT effectiveIntervalChanged(interval);
+        updateCounterAgent();
+    }
 }
 
 quint32 Counter::interval() const
@@ -230,78 +334,114 @@ quint32 Counter::interval() const
     return d_ptr->currentInterval;
 }
 
-void Counter::setRunning(bool on)
+/*
+ * Starts from the minimum interval, so that the first reports come soon.
+ */
+void Counter::setAdaptive(bool adaptive)
 {
-    if (d_ptr->shouldBeRunning == on)
+    if (d_ptr->adaptive == adaptive)
         return;
 
-    d_ptr->shouldBeRunning = on;
+    d_ptr->adaptive = adaptive;
+    d_ptr->adaptiveInterval = d_ptr->minimumInterval;
+    for (Throughput &service : d_ptr->throughput) {
+        service.busy = 0;
+        service.idle = 0;
+    }
+    Q_EMIT adaptiveChanged(adaptive);
+    Q_EMIT effectiveIntervalChanged(effectiveInterval());
     updateCounterAgent();
 }
 
-void Counter::updateCounterAgent()
+bool Counter::adaptive() const
 {
-    if (!d_ptr->m_manager->isAvailable()) {
-        if (d_ptr->registered) {
-            d_ptr->registered = false;
-            Q_EMIT runningChanged(d_ptr->registered);
-        }
+    return d_ptr->adaptive;
+}
+
+void Counter::setMinimumInterval(quint32 interval)
+{
+    interval = qMax(interval, 1u);
+    if (d_ptr->minimumInterval == interval)
         return;
+
+    d_ptr->minimumInterval = interval;
+    if (d_ptr->maximumInterval < interval) {
+        d_ptr->maximumInterval = interval;
+        Q_EMIT maximumIntervalChanged(interval);
     }
+    Q_EMIT minimumIntervalChanged(interval);
+    setAdaptiveInterval(d_ptr->adaptiveInterval);
+}
 
-    if (d_ptr->registered) {
-        d_ptr->m_manager->unregisterCounter(d_ptr->counterPath);
-        if (!d_ptr->shouldBeRunning) {
-            d_ptr->registered = false;
-            Q_EMIT runningChanged(d_ptr->registered);
-            return;
-        }
+quint32 Counter::minimumInterval() const
+{
+    return d_ptr->minimumInterval;
+}
+
+void Counter::setMaximumInterval(quint32 interval)
+{
+    interval = qMax(interval, 1u);
+    if (d_ptr->maximumInterval == interval)
+        return;
+
+    d_ptr->maximumInterval = interval;
+    if (d_ptr->minimumInterval > interval) {
+        d_ptr->minimumInterval = interval;
+        Q_EMIT minimumIntervalChanged(interval);
     }
+    Q_EMIT maximumIntervalChanged(interval);
+    setAdaptiveInterval(d_ptr->adaptiveInterval);
+}
 
-    if (d_ptr->shouldBeRunning) {
-        d_ptr->m_manager->registerCounter(d_ptr->counterPath, d_ptr->currentAccuracy, d_ptr->currentInterval);
-        if (!d_ptr->registered) {
-            d_ptr->registered = true;
-            Q_EMIT runningChanged(d_ptr->registered);
-        }
+quint32 Counter::maximumInterval() const
+{
+    return d_ptr->maximumInterval;
+}
+
+void Counter::setQuota(quint64 quota)
+{
+    if (d_ptr->quota != quota) {
+        d_ptr->quota = quota;
+        d_ptr->quotaUsed = 0;
+        Q_EMIT quotaChanged(quota);
     }
 }
 
-bool Counter::running() const
+quint64 Counter::quota() const
 {
-    return d_ptr->registered;
+    return d_ptr->quota;
 }
 
-/*
- *This is the dbus adaptor to the connman interface
- **/
-CounterAdaptor::CounterAdaptor(Counter* parent)
-  : QDBusAbstractAdaptor(parent),
-    m_counter(parent)
+quint64 Counter::quotaUsed() const
 {
+    return d_ptr->quotaUsed;
 }
 
-CounterAdaptor::~CounterAdaptor()
+quint32 Counter::effectiveInterval() const
 {
+    return d_ptr->adaptive ? d_ptr->adaptiveInterval : d_ptr->currentInterval;
 }
 
-void CounterAdaptor::Release()
+void Counter::setRunning(bool on)
 {
-     m_counter->release();
+    if (d_ptr->shouldBeRunning == on)
+        return;
+
+    d_ptr->shouldBeRunning = on;
+    updateCounterAgent();
 }
 
-void CounterAdaptor::Usage(const QDBusObjectPath &service_path,
-                           const QVariantMap &home,
-                           const QVariantMap &roaming)
+void Counter::updateCounterAgent()
 {
-    if (!home.isEmpty()) {
-        // home
-        m_counter->serviceUsage(service_path.path(), home, false);
-    }
-    if (!roaming.isEmpty()) {
-        //roaming
-        m_counter->serviceUsage(service_path.path(), roaming, true);
+    if (d_ptr->shouldBeRunning) {
+        d_ptr->m_hub->attach(this, d_ptr->currentAccuracy, effectiveInterval());
+    } else {
+        d_ptr->m_hub->detach(this);
+        setRegistered(false);
     }
 }
 
-#include "counter.moc"
+bool Counter::running() const
+{
+    return d_ptr->registered;
+}
@@ -34,6 +34,11 @@ class Counter : public QObject
     Q_PROPERTY(quint32 accuracy READ accuracy WRITE setAccuracy NOTIFY accuracyChanged)
     Q_PROPERTY(quint32 interval READ interval WRITE setInterval NOTIFY intervalChanged)
     Q_PROPERTY(bool running READ running WRITE setRunning NOTIFY runningChanged)
+    Q_PROPERTY(bool adaptive READ adaptive WRITE setAdaptive NOTIFY adaptiveChanged)
+    Q_PROPERTY(quint32 minimumInterval READ minimumInterval WRITE setMinimumInterval NOTIFY minimumIntervalChanged)
+    Q_PROPERTY(quint32 maximumInterval READ maximumInterval WRITE setMaximumInterval NOTIFY maximumIntervalChanged)
+    Q_PROPERTY(quint64 quota READ quota WRITE setQuota NOTIFY quotaChanged)
+    Q_PROPERTY(quint32 effectiveInterval READ effectiveInterval NOTIFY effectiveIntervalChanged)
 
     Q_DISABLE_COPY(Counter)
 
@@ -56,6 +61,26 @@ public:
     bool running() const;
     void setRunning(bool on);
 
+    // In the adaptive mode the interval follows the traffic between the
+    // minimum and maximum, the interval property is not used
+    bool adaptive() const;
+    void setAdaptive(bool adaptive);
+
+    quint32 minimumInterval() const;
+    void setMinimumInterval(quint32 interval);
+
+    quint32 maximumInterval() const;
+    void setMaximumInterval(quint32 interval);
+
+    // Bytes received and transmitted on all services, 0 for none. The
+    // minimum interval is used when the quota is near.
+    quint64 quota() const;
+    void setQuota(quint64 quota);
+    // The bytes counted against the quota, from when it was set
+    quint64 quotaUsed() const;
+
+    quint32 effectiveInterval() const;
+
 Q_SIGNALS:
     void counterChanged(const QString &servicePath, const QVariantMap &counters, bool roaming);
     void bytesReceivedChanged(quint64 bytesRx);
@@ -65,6 +90,11 @@ Q_SIGNALS:
     void accuracyChanged(quint32 accuracy);
     void intervalChanged(quint32 interval);
     void runningChanged(bool running);
+    void adaptiveChanged(bool adaptive);
+    void minimumIntervalChanged(quint32 interval);
+    void maximumIntervalChanged(quint32 interval);
+    void quotaChanged(quint64 quota);
+    void effectiveIntervalChanged(quint32 interval);
 
 private Q_SLOTS:
     void updateCounterAgent();
@@ -72,10 +102,12 @@ private Q_SLOTS:
 private:
     CounterPrivate *d_ptr;
 
-    friend class CounterAdaptor;
+    friend class CounterHub;
 
     void serviceUsage(const QString &servicePath, const QVariantMap &counters, bool roaming);
-    void release();
+    void setRegistered(bool registered);
+    void adapt(const QString &servicePath, const QVariantMap &counters, bool roaming);
+    void setAdaptiveInterval(quint32 interval);
 };
 
 #endif // COUNTER_H
@@ -0,0 +1,477 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "counterhistory.h"
+#include "counter.h"
+#include "counterhistoryfile.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
+
+static const int DefaultCapacity = 720;
+
+namespace {
+
+// Usage reports only carry the values that changed, the totals are the
+// bytes seen since the series started and keep growing across resets
+struct CounterEntry
+{
+    CounterSample sample;
+    quint64 rxTotal;
+    quint64 txTotal;
+};
+
+class CounterSeries
+{
+public:
+    CounterSeries() : m_first(0) {}
+
+    int count() const { return m_ring.count(); }
+    const CounterEntry &at(int index) const
+        { return m_ring.at((m_first + index) % m_ring.count()); }
+    const CounterEntry &last() const { return at(count() - 1); }
+
+    void append(const CounterEntry &entry, int capacity);
+    void truncate(int capacity);
+    int lowerBound(qint64 timestamp) const;
+
+private:
+    QVector<CounterEntry> m_ring;
+    int m_first;
+};
+
+void CounterSeries::append(const CounterEntry &entry, int capacity)
+{
+    if (m_ring.count() < capacity) {
+        // Not wrapped around yet, m_first is 0
+        m_ring.append(entry);
+    } else {
+        m_ring[m_first] = entry;
+        m_first = (m_first + 1) % m_ring.count();
+    }
+}
+
+void CounterSeries::truncate(int capacity)
+{
+    if (m_ring.count() <= capacity && m_first == 0)
+        return;
+
+    QVector<CounterEntry> ring;
+    ring.reserve(qMin(capacity, m_ring.count()));
+    for (int i = qMax(0, count() - capacity); i < count(); ++i)
+        ring.append(at(i));
+    m_ring.swap(ring);
+    m_first = 0;
+}
+
+int CounterSeries::lowerBound(qint64 timestamp) const
+{
+    int low = 0;
+    int high = count();
+    while (low < high) {
+        const int middle = (low + high) / 2;
+        if (at(middle).sample.timestamp < timestamp)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+}
+
+typedef QPair<QString, bool> CounterSeriesKey; // service path, roaming
+typedef QPair<CounterSeriesKey, quint32> CounterUsageKey; // year * 100 + month
+
+static quint32 monthOf(qint64 timestamp)
+{
+    const QDate date(QDateTime::fromMSecsSinceEpoch(timestamp).date());
+    return date.year() * 100 + date.month();
+}
+
+static qint64 startOfMonth(quint32 month)
+{
+    return QDateTime(QDate(month / 100, month % 100, 1), QTime(0, 0)).toMSecsSinceEpoch();
+}
+
+// A counter that went backwards was reset and counts from zero again
+template <typename T> static T increase(T from, T to)
+{
+    return (to >= from) ? to - from : to;
+}
+
+class CounterHistoryPrivate
+{
+public:
+    CounterHistoryPrivate(CounterHistory *history);
+
+    const CounterSeries *series(const QString &servicePath, bool roaming) const;
+    double rate(const QString &servicePath, int window, bool roaming, bool rx) const;
+    qint64 timestamp();
+    void addSample(const QString &servicePath, const QVariantMap &counters, bool roaming);
+    bool append(const QString &servicePath, bool roaming, const CounterSample &sample, bool store);
+    void addUsage(const QString &servicePath, bool roaming, qint64 timestamp,
+                  quint64 rxBytes, quint64 txBytes, quint32 seconds);
+    void restore();
+
+    CounterHistory *q;
+    Counter *m_counter;
+    int m_capacity;
+    QStringList m_services;
+    QHash<CounterSeriesKey, CounterSeries> m_series;
+    QHash<CounterUsageKey, CounterSample> m_usage;
+    QString m_storagePath;
+    CounterHistoryFile m_file;
+    qint64 m_lastTimestamp;
+    QElapsedTimer m_sinceLastTimestamp;
+};
+
+CounterHistoryPrivate::CounterHistoryPrivate(CounterHistory *history)
+    : q(history)
+    , m_counter(new Counter(history))
+    , m_capacity(DefaultCapacity)
+    , m_lastTimestamp(0)
+{
+}
+
+const CounterSeries *CounterHistoryPrivate::series(const QString &servicePath, bool roaming) const
+{
+    QHash<CounterSeriesKey, CounterSeries>::ConstIterator it
+            = m_series.constFind(CounterSeriesKey(servicePath, roaming));
+    return (it != m_series.constEnd()) ? &it.value() : nullptr;
+}
+
+double CounterHistoryPrivate::rate(const QString &servicePath, int window, bool roaming, bool rx) const
+{
+    const CounterSeries *s = series(servicePath, roaming);
+    if (!s || s->count() < 2)
+        return 0;
+
+    const CounterEntry &last = s->last();
+    int first = s->count() - 2;
+    if (window > 0)
+        first = qMin(first, s->lowerBound(last.sample.timestamp - qint64(window) * 1000));
+
+    const CounterEntry &from = s->at(first);
+    const qint64 elapsed = last.sample.timestamp - from.sample.timestamp;
+    if (elapsed <= 0)
+        return 0;
+
+    const quint64 bytes = rx ? (last.rxTotal - from.rxTotal) : (last.txTotal - from.txTotal);
+    return bytes * 1000.0 / elapsed;
+}
+
+// The series are searched by timestamp, they must not go backwards when
+// the clock is turned back. Until the clock catches up, the time keeps
+// running from the latest sample.
+qint64 CounterHistoryPrivate::timestamp()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now < m_lastTimestamp) {
+        now = m_lastTimestamp;
+        if (m_sinceLastTimestamp.isValid())
+            now += m_sinceLastTimestamp.elapsed();
+    }
+
+    m_lastTimestamp = now;
+    m_sinceLastTimestamp.start();
+    return now;
+}
+
+void CounterHistoryPrivate::addSample(const QString &servicePath, const QVariantMap &counters, bool roaming)
+{
+    const CounterSeries *s = series(servicePath, roaming);
+    const CounterSample previous((s && s->count() > 0) ? s->last().sample : CounterSample());
+
+    CounterSample sample;
+    sample.timestamp = timestamp();
+    sample.rxBytes = counters.value("RX.Bytes", previous.rxBytes).toULongLong();
+    sample.txBytes = counters.value("TX.Bytes", previous.txBytes).toULongLong();
+    sample.seconds = counters.value("Time", previous.seconds).toUInt();
+    append(servicePath, roaming, sample, true);
+
+    if (!m_services.contains(servicePath)) {
+        m_services.append(servicePath);
+        Q_EMIT q->servicesChanged();
+    }
+    Q_EMIT q->sampleAdded(servicePath, roaming);
+}
+
+bool CounterHistoryPrivate::append(const QString &servicePath, bool roaming, const CounterSample &sample,
+                                   bool store)
+{
+    CounterSeries &s = m_series[CounterSeriesKey(servicePath, roaming)];
+
+    CounterEntry entry;
+    entry.sample = sample;
+    entry.rxTotal = 0;
+    entry.txTotal = 0;
+
+    if (s.count() > 0) {
+        const CounterEntry &last = s.last();
+
+        // Stored records out of order are left over from an interrupted
+        // compaction
+        if (!store && sample.timestamp < last.sample.timestamp)
+            return false;
+
+        const quint64 rx = increase(last.sample.rxBytes, sample.rxBytes);
+        const quint64 tx = increase(last.sample.txBytes, sample.txBytes);
+        entry.rxTotal = last.rxTotal + rx;
+        entry.txTotal = last.txTotal + tx;
+
+        if (store)
+            addUsage(servicePath, roaming, sample.timestamp, rx, tx, increase(last.sample.seconds, sample.seconds));
+    }
+
+    s.append(entry, m_capacity);
+
+    if (store && m_file.isOpen()) {
+        const int service = m_file.serviceIndex(servicePath);
+        if (service >= 0) {
+            CounterHistoryFile::Record record;
+            record.timestamp = sample.timestamp;
+            record.rxBytes = sample.rxBytes;
+            record.txBytes = sample.txBytes;
+            record.seconds = sample.seconds;
+            record.service = quint16(service);
+            record.roaming = roaming;
+            record.reserved = 0;
+            m_file.append(record);
+        }
+    }
+    return true;
+}
+
+void CounterHistoryPrivate::addUsage(const QString &servicePath, bool roaming, qint64 timestamp,
+                                     quint64 rxBytes, quint64 txBytes, quint32 seconds)
+{
+    const quint32 month = monthOf(timestamp);
+    CounterSample &usage = m_usage[CounterUsageKey(CounterSeriesKey(servicePath, roaming), month)];
+    usage.timestamp = startOfMonth(month);
+    usage.rxBytes += rxBytes;
+    usage.txBytes += txBytes;
+    usage.seconds += seconds;
+
+    const int service = m_file.serviceIndex(servicePath);
+    if (service >= 0) {
+        CounterHistoryFile::Rollup *rollup = m_file.rollup(quint16(service), roaming, month);
+        rollup->rxBytes = usage.rxBytes;
+        rollup->txBytes = usage.txBytes;
+        rollup->seconds = usage.seconds;
+    }
+}
+
+void CounterHistoryPrivate::restore()
+{
+    const QStringList services(m_file.services());
+
+    for (int i = 0; i < m_file.recordCount(); ++i) {
+        const CounterHistoryFile::Record &record = m_file.record(i);
+        if (record.service >= services.count())
+            continue;
+
+        CounterSample sample;
+        sample.timestamp = record.timestamp;
+        sample.rxBytes = record.rxBytes;
+        sample.txBytes = record.txBytes;
+        sample.seconds = record.seconds;
+        if (!append(services.at(record.service), record.roaming, sample, false))
+            continue;
+
+        if (sample.timestamp > m_lastTimestamp) {
+            m_lastTimestamp = sample.timestamp;
+            m_sinceLastTimestamp.invalidate();
+        }
+        if (!m_services.contains(services.at(record.service)))
+            m_services.append(services.at(record.service));
+    }
+
+    for (int i = 0; i < m_file.rollupCapacity(); ++i) {
+        const CounterHistoryFile::Rollup &rollup = m_file.rollup(i);
+        if (!rollup.used || rollup.service >= services.count())
+            continue;
+
+        CounterSample &usage = m_usage[CounterUsageKey(CounterSeriesKey(services.at(rollup.service),
+                                                                         rollup.roaming), rollup.month)];
+        usage.timestamp = startOfMonth(rollup.month);
+        usage.rxBytes = rollup.rxBytes;
+        usage.txBytes = rollup.txBytes;
+        usage.seconds = quint32(rollup.seconds);
+    }
+}
+
+CounterHistory::CounterHistory(QObject *parent)
+    : QObject(parent)
+    , d_ptr(new CounterHistoryPrivate(this))
+{
+    connect(d_ptr->m_counter, &Counter::counterChanged,
+            this, [this](const QString &servicePath, const QVariantMap &counters, bool roaming) {
+        d_ptr->addSample(servicePath, counters, roaming);
+    });
+    connect(d_ptr->m_counter, &Counter::runningChanged, this, &CounterHistory::runningChanged);
+    connect(d_ptr->m_counter, &Counter::accuracyChanged, this, &CounterHistory::accuracyChanged);
+    connect(d_ptr->m_counter, &Counter::intervalChanged, this, &CounterHistory::intervalChanged);
+}
+
+CounterHistory::~CounterHistory()
+{
+    delete d_ptr;
+    d_ptr = nullptr;
+}
+
+bool CounterHistory::running() const
+{
+    return d_ptr->m_counter->running();
+}
+
+void CounterHistory::setRunning(bool running)
+{
+    d_ptr->m_counter->setRunning(running);
+}
+
+quint32 CounterHistory::accuracy() const
+{
+    return d_ptr->m_counter->accuracy();
+}
+
+void CounterHistory::setAccuracy(quint32 accuracy)
+{
+    d_ptr->m_counter->setAccuracy(accuracy);
+}
+
+quint32 CounterHistory::interval() const
+{
+    return d_ptr->m_counter->interval();
+}
+
+void CounterHistory::setInterval(quint32 interval)
+{
+    d_ptr->m_counter->setInterval(interval);
+}
+
+int CounterHistory::capacity() const
+{
+    return d_ptr->m_capacity;
+}
+
+void CounterHistory::setCapacity(int capacity)
+{
+    capacity = qMax(2, capacity);
+    if (d_ptr->m_capacity == capacity)
+        return;
+
+    const bool truncated = capacity < d_ptr->m_capacity;
+    d_ptr->m_capacity = capacity;
+    for (CounterSeries &s : d_ptr->m_series)
+        s.truncate(capacity);
+
+    Q_EMIT capacityChanged();
+    if (truncated)
+        Q_EMIT historyReset();
+}
+
+QString CounterHistory::storagePath() const
+{
+    return d_ptr->m_storagePath;
+}
+
+void CounterHistory::setStoragePath(const QString &storagePath)
+{
+    if (d_ptr->m_storagePath == storagePath)
+        return;
+
+    d_ptr->m_storagePath = storagePath;
+    d_ptr->m_file.close();
+    d_ptr->m_series.clear();
+    d_ptr->m_usage.clear();
+    d_ptr->m_services.clear();
+
+    if (!storagePath.isEmpty() && d_ptr->m_file.open(storagePath))
+        d_ptr->restore();
+
+    Q_EMIT storagePathChanged();
+    Q_EMIT servicesChanged();
+    Q_EMIT historyReset();
+}
+
+QStringList CounterHistory::services() const
+{
+    return d_ptr->m_services;
+}
+
+int CounterHistory::count(const QString &servicePath, bool roaming) const
+{
+    const CounterSeries *s = d_ptr->series(servicePath, roaming);
+    return s ? s->count() : 0;
+}
+
+CounterSample CounterHistory::sample(const QString &servicePath, int index, bool roaming) const
+{
+    const CounterSeries *s = d_ptr->series(servicePath, roaming);
+    return (s && index >= 0 && index < s->count()) ? s->at(index).sample : CounterSample();
+}
+
+CounterSample CounterHistory::latest(const QString &servicePath, bool roaming) const
+{
+    const CounterSeries *s = d_ptr->series(servicePath, roaming);
+    return (s && s->count() > 0) ? s->last().sample : CounterSample();
+}
+
+QVector<CounterSample> CounterHistory::samples(const QString &servicePath, bool roaming) const
+{
+    QVector<CounterSample> result;
+    if (const CounterSeries *s = d_ptr->series(servicePath, roaming)) {
+        result.reserve(s->count());
+        for (int i = 0; i < s->count(); ++i)
+            result.append(s->at(i).sample);
+    }
+    return result;
+}
+
+QVector<CounterSample> CounterHistory::samples(const QString &servicePath, qint64 from, qint64 to,
+                                               bool roaming) const
+{
+    QVector<CounterSample> result;
+    if (const CounterSeries *s = d_ptr->series(servicePath, roaming)) {
+        const int end = s->lowerBound(to);
+        for (int i = s->lowerBound(from); i < end; ++i)
+            result.append(s->at(i).sample);
+    }
+    return result;
+}
+
+CounterSample CounterHistory::monthlyUsage(const QString &servicePath, int year, int month, bool roaming) const
+{
+    const quint32 key = year * 100 + month;
+    CounterSample usage(d_ptr->m_usage.value(CounterUsageKey(CounterSeriesKey(servicePath, roaming), key)));
+    usage.timestamp = startOfMonth(key);
+    return usage;
+}
+
+double CounterHistory::rxRate(const QString &servicePath, int window, bool roaming) const
+{
+    return d_ptr->rate(servicePath, window, roaming, true);
+}
+
+double CounterHistory::txRate(const QString &servicePath, int window, bool roaming) const
+{
+    return d_ptr->rate(servicePath, window, roaming, false);
+}
+
+void CounterHistory::clear()
+{
+    d_ptr->m_series.clear();
+    if (!d_ptr->m_services.isEmpty()) {
+        d_ptr->m_services.clear();
+        Q_EMIT servicesChanged();
+    }
+    Q_EMIT historyReset();
+}
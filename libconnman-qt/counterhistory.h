@@ -0,0 +1,121 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef COUNTERHISTORY_H
+#define COUNTERHISTORY_H
+
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+struct CounterSample
+{
+    CounterSample() : timestamp(0), rxBytes(0), txBytes(0), seconds(0) {}
+
+    qint64 timestamp; // ms since the epoch
+    quint64 rxBytes;
+    quint64 txBytes;
+    quint32 seconds;
+};
+
+Q_DECLARE_TYPEINFO(CounterSample, Q_MOVABLE_TYPE);
+
+class CounterHistoryPrivate;
+
+/*
+ * Keeps the recent usage reports of ConnMan per service, home and roaming
+ * separately, in ring buffers of a fixed capacity. The oldest samples are
+ * dropped once a buffer is full.
+ *
+ * The sampling follows the accuracy and interval, as with Counter. Rates
+ * are in bytes per second and survive counter resets within the window.
+ *
+ * With a storage path the samples are also written to a memory mapped
+ * file, which is mapped again on the next start. The usage is summed up
+ * per month as it comes in, also while the application wasn't running,
+ * the sums are kept in the file longer than the samples. Only one process
+ * at a time can use the same storage path.
+ *
+ * The timestamps of the samples never go backwards, also when the system
+ * clock is turned back.
+ */
+class CounterHistory : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool running READ running WRITE setRunning NOTIFY runningChanged)
+    Q_PROPERTY(quint32 accuracy READ accuracy WRITE setAccuracy NOTIFY accuracyChanged)
+    Q_PROPERTY(quint32 interval READ interval WRITE setInterval NOTIFY intervalChanged)
+    Q_PROPERTY(int capacity READ capacity WRITE setCapacity NOTIFY capacityChanged)
+    Q_PROPERTY(QString storagePath READ storagePath WRITE setStoragePath NOTIFY storagePathChanged)
+    Q_PROPERTY(QStringList services READ services NOTIFY servicesChanged)
+
+    Q_DISABLE_COPY(CounterHistory)
+
+public:
+    explicit CounterHistory(QObject *parent = nullptr);
+    ~CounterHistory();
+
+    bool running() const;
+    void setRunning(bool running);
+
+    quint32 accuracy() const;
+    void setAccuracy(quint32 accuracy);
+
+    quint32 interval() const;
+    void setInterval(quint32 interval);
+
+    // Samples kept per service, default 720 (an hour at 5 s intervals)
+    int capacity() const;
+    void setCapacity(int capacity);
+
+    // Replaces the samples in memory with the stored ones
+    QString storagePath() const;
+    void setStoragePath(const QString &storagePath);
+
+    QStringList services() const;
+
+    Q_INVOKABLE int count(const QString &servicePath, bool roaming = false) const;
+    // Index 0 is the oldest sample
+    CounterSample sample(const QString &servicePath, int index, bool roaming = false) const;
+    CounterSample latest(const QString &servicePath, bool roaming = false) const;
+    QVector<CounterSample> samples(const QString &servicePath, bool roaming = false) const;
+    // Samples with from <= timestamp < to
+    QVector<CounterSample> samples(const QString &servicePath, qint64 from, qint64 to,
+                                   bool roaming = false) const;
+
+    // The bytes and seconds used in the month, the timestamp is the
+    // start of the month
+    CounterSample monthlyUsage(const QString &servicePath, int year, int month,
+                               bool roaming = false) const;
+
+    // Over the given number of seconds, or between the two latest samples
+    // if the window is 0
+    Q_INVOKABLE double rxRate(const QString &servicePath, int window = 0, bool roaming = false) const;
+    Q_INVOKABLE double txRate(const QString &servicePath, int window = 0, bool roaming = false) const;
+
+    // Drops the samples in memory, the stored ones and the monthly usage
+    // are kept
+    Q_INVOKABLE void clear();
+
+Q_SIGNALS:
+    void runningChanged();
+    void accuracyChanged();
+    void intervalChanged();
+    void capacityChanged();
+    void storagePathChanged();
+    void servicesChanged();
+    void sampleAdded(const QString &servicePath, bool roaming);
+    // The samples were dropped or truncated
+    void historyReset();
+
+private:
+    CounterHistoryPrivate *d_ptr;
+    friend class CounterHistoryPrivate;
+};
+
+#endif // COUNTERHISTORY_H
@@ -0,0 +1,304 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "counterhistoryfile.h"
+#include "logging.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QVector>
+
+#include <string.h>
+
+static const char Magic[8] = { 'C', 'M', 'N', 'H', 'I', 'S', 'T', '1' };
+static const quint32 Version = 1;
+
+static const int MaxServices = 64;
+static const int ServicePathSize = 254;
+static const int RollupCapacity = 1024;
+static const int RecordCapacity = 8192;
+
+struct CounterHistoryFile::Header {
+    char magic[8];
+    quint32 version;
+    quint32 recordSize;
+    quint32 serviceCount;
+    quint32 recordCount;
+    quint32 reserved[10];
+};
+
+struct CounterHistoryFile::ServiceSlot {
+    quint16 length;
+    char path[ServicePathSize];
+};
+
+Q_STATIC_ASSERT(sizeof(CounterHistoryFile::Record) == 32);
+Q_STATIC_ASSERT(sizeof(CounterHistoryFile::Rollup) == 32);
+
+static const qint64 ServicesOffset = 64;
+static const qint64 RollupsOffset = ServicesOffset + MaxServices * 256;
+static const qint64 RecordsOffset = RollupsOffset + RollupCapacity * qint64(sizeof(CounterHistoryFile::Rollup));
+static const qint64 FileSize = RecordsOffset + RecordCapacity * qint64(sizeof(CounterHistoryFile::Record));
+
+CounterHistoryFile::CounterHistoryFile()
+    : m_data(nullptr)
+{
+    Q_STATIC_ASSERT(sizeof(Header) == ServicesOffset);
+    Q_STATIC_ASSERT(sizeof(ServiceSlot) == 256);
+}
+
+CounterHistoryFile::~CounterHistoryFile()
+{
+    close();
+}
+
+bool CounterHistoryFile::open(const QString &path)
+{
+    close();
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    // Two writers would corrupt each other's records. The lock of a process
+    // that is gone is taken over, however long it was held.
+    m_lock.reset(new QLockFile(path + QLatin1String(".lock")));
+    m_lock->setStaleLockTime(0);
+    if (!m_lock->tryLock()) {
+        qWarning() << "Counter history" << path << "is in use by another process";
+        m_lock.reset();
+        return false;
+    }
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qWarning() << "Failed to open counter history" << path << m_file.errorString();
+        close();
+        return false;
+    }
+
+    const bool valid = m_file.size() == FileSize;
+    if (!valid && !m_file.resize(FileSize)) {
+        qWarning() << "Failed to resize counter history" << path << m_file.errorString();
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, FileSize);
+    if (!m_data) {
+        qWarning() << "Failed to map counter history" << path << m_file.errorString();
+        close();
+        return false;
+    }
+
+    Header *h = header();
+    if (!valid || memcmp(h->magic, Magic, sizeof(Magic)) != 0 || h->version != Version
+            || h->recordSize != sizeof(Record) || h->serviceCount > MaxServices
+            || h->recordCount > RecordCapacity) {
+        qCDebug(lcConnman) << "Initializing counter history" << path;
+        initialize();
+    }
+
+    for (quint32 i = 0; i < h->serviceCount; ++i) {
+        const ServiceSlot *slot = serviceSlot(i);
+        m_services.append(QString::fromUtf8(slot->path, qMin<int>(slot->length, ServicePathSize)));
+    }
+
+    for (int i = 0; i < RollupCapacity; ++i) {
+        const Rollup *slot = rollupSlot(i);
+        if (slot->used)
+            m_rollups.insert(rollupKey(slot->service, slot->roaming, slot->month), i);
+    }
+
+    return true;
+}
+
+void CounterHistoryFile::close()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+    m_file.close();
+    m_lock.reset();
+    m_services.clear();
+    m_rollups.clear();
+}
+
+bool CounterHistoryFile::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+void CounterHistoryFile::initialize()
+{
+    memset(m_data, 0, FileSize);
+
+    Header *h = header();
+    memcpy(h->magic, Magic, sizeof(Magic));
+    h->version = Version;
+    h->recordSize = sizeof(Record);
+}
+
+CounterHistoryFile::Header *CounterHistoryFile::header() const
+{
+    return reinterpret_cast<Header *>(m_data);
+}
+
+CounterHistoryFile::ServiceSlot *CounterHistoryFile::serviceSlot(int index) const
+{
+    return reinterpret_cast<ServiceSlot *>(m_data + ServicesOffset) + index;
+}
+
+CounterHistoryFile::Rollup *CounterHistoryFile::rollupSlot(int index) const
+{
+    return reinterpret_cast<Rollup *>(m_data + RollupsOffset) + index;
+}
+
+CounterHistoryFile::Record *CounterHistoryFile::recordSlot(int index) const
+{
+    return reinterpret_cast<Record *>(m_data + RecordsOffset) + index;
+}
+
+QStringList CounterHistoryFile::services() const
+{
+    return m_services;
+}
+
+int CounterHistoryFile::serviceIndex(const QString &servicePath)
+{
+    int index = m_services.indexOf(servicePath);
+    if (index >= 0 || !m_data)
+        return index;
+
+    const QByteArray path(servicePath.toUtf8());
+    if (path.size() <= ServicePathSize)
+        index = m_services.count() < MaxServices ? m_services.count() : unusedServiceSlot();
+
+    if (index < 0) {
+        qWarning() << "Not storing the counter history of" << servicePath;
+        return -1;
+    }
+
+    ServiceSlot *slot = serviceSlot(index);
+    memset(slot, 0, sizeof(ServiceSlot));
+    slot->length = quint16(path.size());
+    memcpy(slot->path, path.constData(), path.size());
+    if (index < m_services.count()) {
+        qCDebug(lcConnman) << "Counter history of" << m_services.at(index) << "replaced by" << servicePath;
+        m_services[index] = servicePath;
+    } else {
+        header()->serviceCount = index + 1;
+        m_services.append(servicePath);
+    }
+    return index;
+}
+
+// A slot that neither the records nor the monthly totals refer to any more
+int CounterHistoryFile::unusedServiceSlot() const
+{
+    QVector<bool> used(m_services.count(), false);
+    for (quint32 i = 0; i < header()->recordCount; ++i) {
+        const quint16 service = recordSlot(i)->service;
+        if (service < used.count())
+            used[service] = true;
+    }
+    for (int i = 0; i < RollupCapacity; ++i) {
+        const Rollup *slot = rollupSlot(i);
+        if (slot->used && slot->service < used.count())
+            used[slot->service] = true;
+    }
+    return used.indexOf(false);
+}
+
+int CounterHistoryFile::recordCapacity() const
+{
+    return m_data ? RecordCapacity : 0;
+}
+
+int CounterHistoryFile::recordCount() const
+{
+    return m_data ? header()->recordCount : 0;
+}
+
+const CounterHistoryFile::Record &CounterHistoryFile::record(int index) const
+{
+    return *recordSlot(index);
+}
+
+void CounterHistoryFile::append(const Record &record)
+{
+    if (!m_data)
+        return;
+
+    if (header()->recordCount >= RecordCapacity)
+        compact();
+
+    // The record is in place before it's counted
+    *recordSlot(header()->recordCount) = record;
+    header()->recordCount++;
+}
+
+void CounterHistoryFile::compact()
+{
+    const int dropped = RecordCapacity / 2;
+    const int kept = header()->recordCount - dropped;
+
+    memmove(recordSlot(0), recordSlot(dropped), kept * sizeof(Record));
+    header()->recordCount = kept;
+    qCDebug(lcConnman) << "Compacted counter history to" << kept << "records";
+}
+
+int CounterHistoryFile::rollupCapacity() const
+{
+    return m_data ? RollupCapacity : 0;
+}
+
+const CounterHistoryFile::Rollup &CounterHistoryFile::rollup(int index) const
+{
+    return *rollupSlot(index);
+}
+
+CounterHistoryFile::Rollup *CounterHistoryFile::rollup(quint16 service, bool roaming, quint32 month)
+{
+    if (!m_data)
+        return nullptr;
+
+    const quint64 key = rollupKey(service, roaming, month);
+    QHash<quint64, int>::ConstIterator it = m_rollups.constFind(key);
+    if (it != m_rollups.constEnd())
+        return rollupSlot(it.value());
+
+    int index = -1;
+    if (m_rollups.count() < RollupCapacity) {
+        for (int i = 0; i < RollupCapacity && index < 0; ++i) {
+            if (!rollupSlot(i)->used)
+                index = i;
+        }
+    } else {
+        index = 0;
+        for (int i = 1; i < RollupCapacity; ++i) {
+            if (rollupSlot(i)->month < rollupSlot(index)->month)
+                index = i;
+        }
+        const Rollup *oldest = rollupSlot(index);
+        m_rollups.remove(rollupKey(oldest->service, oldest->roaming, oldest->month));
+    }
+
+    Rollup *slot = rollupSlot(index);
+    memset(slot, 0, sizeof(Rollup));
+    slot->month = month;
+    slot->service = service;
+    slot->roaming = roaming;
+    slot->used = 1;
+    m_rollups.insert(key, index);
+    return slot;
+}
+
+quint64 CounterHistoryFile::rollupKey(quint16 service, bool roaming, quint32 month)
+{
+    return (quint64(month) << 32) | (quint64(service) << 1) | (roaming ? 1 : 0);
+}
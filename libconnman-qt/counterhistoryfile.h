@@ -0,0 +1,100 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef COUNTERHISTORYFILE_H
+#define COUNTERHISTORYFILE_H
+
+#include <QFile>
+#include <QHash>
+#include <QLockFile>
+#include <QScopedPointer>
+#include <QStringList>
+
+/*
+ * Memory mapped storage of CounterHistory.
+ *
+ * The file has a fixed size and layout: a header, a table of the service
+ * paths, a table of monthly totals and an append-only area of fixed size
+ * records. Nothing is parsed when it is opened, the records are read in
+ * place. When the record area fills up, the older half of it is dropped,
+ * the monthly totals are kept. The slots of services that are no longer
+ * referred to are taken by new services once the table is full.
+ *
+ * The layout is in host byte order, the file is not meant to be moved
+ * between devices. Only one process at a time can have the file open, it
+ * is locked with a lock file next to it.
+ */
+class CounterHistoryFile
+{
+public:
+    struct Record {
+        qint64 timestamp; // ms since the epoch
+        quint64 rxBytes;
+        quint64 txBytes;
+        quint32 seconds;
+        quint16 service;  // index to services()
+        quint8 roaming;
+        quint8 reserved;
+    };
+
+    struct Rollup {
+        quint32 month;    // year * 100 + month
+        quint16 service;
+        quint8 roaming;
+        quint8 used;
+        quint64 rxBytes;
+        quint64 txBytes;
+        quint64 seconds;
+    };
+
+    CounterHistoryFile();
+    ~CounterHistoryFile();
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+
+    QStringList services() const;
+    // Adds the service if needed. When the table is full, the slot of a
+    // service that no record or monthly total refers to is reused.
+    // Returns -1 if there is none.
+    int serviceIndex(const QString &servicePath);
+
+    int recordCapacity() const;
+    int recordCount() const;
+    const Record &record(int index) const;
+    void append(const Record &record);
+
+    int rollupCapacity() const;
+    const Rollup &rollup(int index) const;
+    // Replaces the totals of the oldest month if the table is full
+    Rollup *rollup(quint16 service, bool roaming, quint32 month);
+
+private:
+    struct Header;
+    struct ServiceSlot;
+
+    Header *header() const;
+    ServiceSlot *serviceSlot(int index) const;
+    Rollup *rollupSlot(int index) const;
+    Record *recordSlot(int index) const;
+    void initialize();
+    void compact();
+    int unusedServiceSlot() const;
+
+    static quint64 rollupKey(quint16 service, bool roaming, quint32 month);
+
+private:
+    QScopedPointer<QLockFile> m_lock;
+    QFile m_file;
+    uchar *m_data;
+    QStringList m_services;
+    QHash<quint64, int> m_rollups;
+};
+
+#endif // COUNTERHISTORYFILE_H
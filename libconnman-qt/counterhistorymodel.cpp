@@ -0,0 +1,168 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "counterhistorymodel.h"
+
+#include <QDateTime>
+
+CounterHistoryModel::CounterHistoryModel(QObject *parent)
+    : QAbstractListModel(parent)
+    , m_roaming(false)
+    , m_count(0)
+{
+}
+
+CounterHistoryModel::~CounterHistoryModel()
+{
+}
+
+QHash<int, QByteArray> CounterHistoryModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[TimestampRole] = "timestamp";
+    roles[RxBytesRole] = "rxBytes";
+    roles[TxBytesRole] = "txBytes";
+    roles[SecondsRole] = "seconds";
+    roles[RxRateRole] = "rxRate";
+    roles[TxRateRole] = "txRate";
+    return roles;
+}
+
+int CounterHistoryModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_count;
+}
+
+QVariant CounterHistoryModel::data(const QModelIndex &index, int role) const
+{
+    if (!m_history || index.row() < 0 || index.row() >= m_count)
+        return QVariant();
+
+    const CounterSample sample(m_history->sample(m_servicePath, index.row(), m_roaming));
+
+    switch (role) {
+    case TimestampRole:
+        return QDateTime::fromMSecsSinceEpoch(sample.timestamp);
+    case RxBytesRole:
+        return sample.rxBytes;
+    case TxBytesRole:
+        return sample.txBytes;
+    case SecondsRole:
+        return sample.seconds;
+    case RxRateRole:
+    case TxRateRole: {
+        if (index.row() == 0)
+            return 0.0;
+
+        const CounterSample previous(m_history->sample(m_servicePath, index.row() - 1, m_roaming));
+        const qint64 elapsed = sample.timestamp - previous.timestamp;
+        const quint64 bytes = (role == RxRateRole) ? sample.rxBytes : sample.txBytes;
+        const quint64 previousBytes = (role == RxRateRole) ? previous.rxBytes : previous.txBytes;
+        if (elapsed <= 0 || bytes < previousBytes)
+            return 0.0;
+        return (bytes - previousBytes) * 1000.0 / elapsed;
+    }
+    default:
+        return QVariant();
+    }
+}
+
+CounterHistory *CounterHistoryModel::history() const
+{
+    return m_history;
+}
+
+void CounterHistoryModel::setHistory(CounterHistory *history)
+{
+    if (m_history == history)
+        return;
+
+    if (m_history)
+        m_history->disconnect(this);
+
+    m_history = history;
+    if (m_history) {
+        connect(m_history.data(), &CounterHistory::sampleAdded,
+                this, &CounterHistoryModel::onSampleAdded);
+        connect(m_history.data(), &CounterHistory::historyReset,
+                this, &CounterHistoryModel::reset);
+        connect(m_history.data(), &QObject::destroyed,
+                this, &CounterHistoryModel::reset);
+    }
+
+    reset();
+    Q_EMIT historyChanged();
+}
+
+QString CounterHistoryModel::servicePath() const
+{
+    return m_servicePath;
+}
+
+void CounterHistoryModel::setServicePath(const QString &servicePath)
+{
+    if (m_servicePath != servicePath) {
+        m_servicePath = servicePath;
+        reset();
+        Q_EMIT servicePathChanged();
+    }
+}
+
+bool CounterHistoryModel::roaming() const
+{
+    return m_roaming;
+}
+
+void CounterHistoryModel::setRoaming(bool roaming)
+{
+    if (m_roaming != roaming) {
+        m_roaming = roaming;
+        reset();
+        Q_EMIT roamingChanged();
+    }
+}
+
+int CounterHistoryModel::count() const
+{
+    return m_count;
+}
+
+void CounterHistoryModel::onSampleAdded(const QString &servicePath, bool roaming)
+{
+    if (servicePath != m_servicePath || roaming != m_roaming)
+        return;
+
+    const int previousCount = m_count;
+    const int count = m_history->count(m_servicePath, m_roaming);
+    if (count == m_count) {
+        // Full, the oldest sample was dropped
+        beginRemoveRows(QModelIndex(), 0, 0);
+        --m_count;
+        endRemoveRows();
+    }
+
+    beginInsertRows(QModelIndex(), m_count, m_count);
+    m_count = count;
+    endInsertRows();
+
+    if (m_count != previousCount)
+        Q_EMIT countChanged();
+}
+
+void CounterHistoryModel::reset()
+{
+    const int count = m_history ? m_history->count(m_servicePath, m_roaming) : 0;
+
+    beginResetModel();
+    const bool changed = count != m_count;
+    m_count = count;
+    endResetModel();
+
+    if (changed)
+        Q_EMIT countChanged();
+}
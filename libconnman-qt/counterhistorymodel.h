@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef COUNTERHISTORYMODEL_H
+#define COUNTERHISTORYMODEL_H
+
+#include <QAbstractListModel>
+#include <QPointer>
+
+#include "counterhistory.h"
+
+/*
+ * List model of the samples a CounterHistory has for one service, oldest
+ * first. The rates are against the previous sample.
+ */
+class CounterHistoryModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(CounterHistoryModel)
+
+    Q_PROPERTY(CounterHistory *history READ history WRITE setHistory NOTIFY historyChanged)
+    Q_PROPERTY(QString servicePath READ servicePath WRITE setServicePath NOTIFY servicePathChanged)
+    Q_PROPERTY(bool roaming READ roaming WRITE setRoaming NOTIFY roamingChanged)
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    enum ItemRoles {
+        TimestampRole = Qt::UserRole + 1,
+        RxBytesRole,
+        TxBytesRole,
+        SecondsRole,
+        RxRateRole,
+        TxRateRole
+    };
+
+    explicit CounterHistoryModel(QObject *parent = nullptr);
+    ~CounterHistoryModel() Q_DECL_OVERRIDE;
+
+    QVariant data(const QModelIndex &index, int role) const Q_DECL_OVERRIDE;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+    QHash<int, QByteArray> roleNames() const Q_DECL_OVERRIDE;
+
+    CounterHistory *history() const;
+    void setHistory(CounterHistory *history);
+
+    QString servicePath() const;
+    void setServicePath(const QString &servicePath);
+
+    bool roaming() const;
+    void setRoaming(bool roaming);
+
+    int count() const;
+
+Q_SIGNALS:
+    void historyChanged();
+    void servicePathChanged();
+    void roamingChanged();
+    void countChanged();
+
+private Q_SLOTS:
+    void onSampleAdded(const QString &servicePath, bool roaming);
+    void reset();
+
+private:
+    QPointer<CounterHistory> m_history;
+    QString m_servicePath;
+    bool m_roaming;
+    int m_count;
+};
+
+#endif // COUNTERHISTORYMODEL_H
@@ -0,0 +1,367 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "counterhub.h"
+#include "counter.h"
+#include "logging.h"
+#include "networkmanager.h"
+
+#include <QtDBus/QDBusAbstractAdaptor>
+#include <QtDBus/QDBusConnection>
+#include <QtDBus/QDBusObjectPath>
+#if (QT_VERSION >= QT_VERSION_CHECK(5,10,0))
+#include <QRandomGenerator>
+#else
+#include <QTime>
+#endif
+
+#include <limits>
+
+static const QString RxBytesKey("RX.Bytes");
+static const QString TxBytesKey("TX.Bytes");
+
+class CounterAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "net.connman.Counter")
+
+public:
+    explicit CounterAdaptor(CounterHub *parent);
+    virtual ~CounterAdaptor();
+
+public Q_SLOTS:
+    void Release();
+    void Usage(const QDBusObjectPath &service_path,
+                                const QVariantMap &home,
+                                const QVariantMap &roaming);
+
+private:
+    CounterHub *m_hub;
+};
+
+// ==========================================================================
+// CounterHub
+// ==========================================================================
+
+QSharedPointer<CounterHub> CounterHub::sharedInstance()
+{
+    static QWeakPointer<CounterHub> sharedHub;
+
+    QSharedPointer<CounterHub> hub = sharedHub.toStrongRef();
+
+    if (!hub) {
+        hub = QSharedPointer<CounterHub>(new CounterHub);
+        sharedHub = hub;
+    }
+
+    return hub;
+}
+
+CounterHub::CounterHub()
+    : m_manager(NetworkManager::sharedInstance())
+    , m_registered(false)
+    , m_updatePending(false)
+    , m_accuracy(0)
+    , m_interval(0)
+    , m_flushDeadline(-1)
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5,10,0))
+    quint32 randomValue = QRandomGenerator::global()->generate();
+#else
+    QTime time = QTime::currentTime();
+    qsrand((uint)time.msec());
+    int randomValue = qrand();
+#endif
+
+    //this needs to be unique so we can use more than one at a time with different processes
+    m_path = "/ConnectivityCounter" + QString::number(randomValue);
+
+    new CounterAdaptor(this);
+    if (!QDBusConnection::systemBus().registerObject(m_path, this))
+        qWarning("Could not register DBus object on %s", qPrintable(m_path));
+
+    m_clock.start();
+    m_flushTimer.setSingleShot(true);
+    connect(&m_flushTimer, &QTimer::timeout, this, &CounterHub::flush);
+    connect(m_manager.data(), &NetworkManager::availabilityChanged,
+            this, &CounterHub::updateRegistration);
+}
+
+CounterHub::~CounterHub()
+{
+    if (m_registered)
+        m_manager->unregisterCounter(m_path);
+    QDBusConnection::systemBus().unregisterObject(m_path);
+}
+
+void CounterHub::attach(Counter *counter, quint32 accuracy, quint32 interval)
+{
+    int index = indexOf(counter);
+    if (index < 0) {
+        Client client;
+        client.counter = counter;
+
+        // Joining a running registration, pass on what ConnMan has
+        // reported so far
+        for (QHash<StreamKey, QVariantMap>::ConstIterator it = m_latest.constBegin();
+             it != m_latest.constEnd(); ++it) {
+            client.streams[it.key()].pending = it.value();
+        }
+        if (!m_latest.isEmpty())
+            scheduleFlush(m_clock.elapsed(), m_clock.elapsed());
+
+        m_clients.append(client);
+        index = m_clients.count() - 1;
+    }
+
+    m_clients[index].accuracy = accuracy;
+    m_clients[index].interval = interval;
+    updateRegistrationLater();
+}
+
+void CounterHub::detach(Counter *counter)
+{
+    const int index = indexOf(counter);
+    if (index >= 0) {
+        m_clients.remove(index);
+        updateRegistrationLater();
+    }
+}
+
+bool CounterHub::isRegistered() const
+{
+    return m_registered;
+}
+
+int CounterHub::indexOf(Counter *counter) const
+{
+    for (int i = 0; i < m_clients.count(); ++i) {
+        if (m_clients.at(i).counter == counter)
+            return i;
+    }
+    return -1;
+}
+
+void CounterHub::updateRegistrationLater()
+{
+    // Bindings tend to change the accuracy and interval one after another
+    if (!m_updatePending) {
+        m_updatePending = true;
+        QMetaObject::invokeMethod(this, "updateRegistration", Qt::QueuedConnection);
+    }
+}
+
+void CounterHub::updateRegistration()
+{
+    m_updatePending = false;
+
+    const bool available = m_manager->isAvailable();
+
+    quint32 accuracy = std::numeric_limits<quint32>::max();
+    quint32 interval = std::numeric_limits<quint32>::max();
+    for (const Client &client : m_clients) {
+        accuracy = qMin(accuracy, client.accuracy);
+        interval = qMin(interval, client.interval);
+    }
+
+    const bool wanted = available && !m_clients.isEmpty();
+    if (m_registered && wanted && accuracy == m_accuracy && interval == m_interval) {
+        setRegistered(true);
+        return;
+    }
+
+    if (m_registered && available)
+        m_manager->unregisterCounter(m_path);
+
+    if (wanted) {
+        qCDebug(lcConnman) << "Registering counter" << m_path << accuracy << interval
+                           << "for" << m_clients.count() << "counters";
+        m_manager->registerCounter(m_path, accuracy, interval);
+        m_accuracy = accuracy;
+        m_interval = interval;
+
+        // ConnMan starts over with a full report, which may also have
+        // started counting from zero again
+        for (Baseline &baseline : m_baselines)
+            baseline.rebasing = true;
+    }
+
+    setRegistered(wanted);
+}
+
+void CounterHub::setRegistered(bool registered)
+{
+    m_registered = registered;
+
+    const QVector<Client> clients(m_clients);
+    for (const Client &client : clients) {
+        if (indexOf(client.counter) >= 0)
+            client.counter->setRegistered(registered);
+    }
+}
+
+void CounterHub::release()
+{
+    setRegistered(false);
+}
+
+void CounterHub::usage(const QString &servicePath, const QVariantMap &reported, bool roaming)
+{
+    const qint64 now = m_clock.elapsed();
+    const StreamKey key(servicePath, roaming);
+    const QVariantMap counters(rebase(key, reported));
+
+    QVariantMap &latest = m_latest[key];
+    for (QVariantMap::ConstIterator it = counters.constBegin(); it != counters.constEnd(); ++it)
+        latest.insert(it.key(), it.value());
+
+    QVector<Delivery> deliveries;
+    for (Client &client : m_clients) {
+        Stream &stream = client.streams[key];
+        for (QVariantMap::ConstIterator it = counters.constBegin(); it != counters.constEnd(); ++it)
+            stream.pending.insert(it.key(), it.value());
+
+        if (isDue(client, stream, now))
+            deliveries.append(take(client, key, stream, now));
+        else
+            scheduleFlush(stream.deliveredAt + qint64(client.interval) * 1000, now);
+    }
+
+    deliver(deliveries);
+}
+
+QVariantMap CounterHub::rebase(const StreamKey &key, const QVariantMap &counters)
+{
+    Baseline &baseline = m_baselines[key];
+
+    QVariantMap rebased;
+    for (QVariantMap::ConstIterator it = counters.constBegin(); it != counters.constEnd(); ++it) {
+        bool ok = false;
+        const quint64 value = it.value().toULongLong(&ok);
+        if (!ok) {
+            rebased.insert(it.key(), it.value());
+            continue;
+        }
+
+        // Went backwards on re-registration, continue from where it was
+        quint64 &offset = baseline.offsets[it.key()];
+        quint64 &previous = baseline.values[it.key()];
+        if (baseline.rebasing && value < previous)
+            offset += previous;
+        previous = value;
+
+        rebased.insert(it.key(), offset ? QVariant(value + offset) : it.value());
+    }
+    baseline.rebasing = false;
+
+    return rebased;
+}
+
+bool CounterHub::isDue(const Client &client, const Stream &stream, qint64 now) const
+{
+    if (stream.deliveredAt < 0 || now - stream.deliveredAt >= qint64(client.interval) * 1000)
+        return true;
+
+    const quint64 threshold = quint64(client.accuracy) * 1024;
+    const quint64 rx = stream.pending.value(RxBytesKey, stream.rx).toULongLong();
+    const quint64 tx = stream.pending.value(TxBytesKey, stream.tx).toULongLong();
+    return (rx > stream.rx ? rx - stream.rx : stream.rx - rx) >= threshold
+        || (tx > stream.tx ? tx - stream.tx : stream.tx - tx) >= threshold;
+}
+
+CounterHub::Delivery CounterHub::take(Client &client, const StreamKey &key, Stream &stream, qint64 now)
+{
+    Delivery delivery;
+    delivery.counter = client.counter;
+    delivery.servicePath = key.first;
+    delivery.counters = stream.pending;
+    delivery.roaming = key.second;
+
+    stream.rx = stream.pending.value(RxBytesKey, stream.rx).toULongLong();
+    stream.tx = stream.pending.value(TxBytesKey, stream.tx).toULongLong();
+    stream.deliveredAt = now;
+    stream.pending.clear();
+    return delivery;
+}
+
+void CounterHub::scheduleFlush(qint64 deadline, qint64 now)
+{
+    if (m_flushTimer.isActive() && m_flushDeadline <= deadline)
+        return;
+
+    m_flushDeadline = deadline;
+    m_flushTimer.start(int(qMax<qint64>(0, deadline - now)));
+}
+
+void CounterHub::flush()
+{
+    const qint64 now = m_clock.elapsed();
+
+    QVector<Delivery> deliveries;
+    for (Client &client : m_clients) {
+        for (QHash<StreamKey, Stream>::Iterator it = client.streams.begin(); it != client.streams.end(); ++it) {
+            if (it.value().pending.isEmpty())
+                continue;
+
+            const qint64 deadline = it.value().deliveredAt + qint64(client.interval) * 1000;
+            if (it.value().deliveredAt < 0 || deadline <= now)
+                deliveries.append(take(client, it.key(), it.value(), now));
+            else
+                scheduleFlush(deadline, now);
+        }
+    }
+
+    deliver(deliveries);
+}
+
+void CounterHub::deliver(const QVector<Delivery> &deliveries)
+{
+    // The counters may be stopped or deleted by the signal handlers
+    for (const Delivery &delivery : deliveries) {
+        if (indexOf(delivery.counter) >= 0)
+            delivery.counter->serviceUsage(delivery.servicePath, delivery.counters, delivery.roaming);
+    }
+}
+
+// ==========================================================================
+// CounterAdaptor
+// ==========================================================================
+
+/*
+ *This is the dbus adaptor to the connman interface
+ **/
+CounterAdaptor::CounterAdaptor(CounterHub *parent)
+  : QDBusAbstractAdaptor(parent),
+    m_hub(parent)
+{
+}
+
+CounterAdaptor::~CounterAdaptor()
+{
+}
+
+void CounterAdaptor::Release()
+{
+     m_hub->release();
+}
+
+void CounterAdaptor::Usage(const QDBusObjectPath &service_path,
+                           const QVariantMap &home,
+                           const QVariantMap &roaming)
+{
+    if (!home.isEmpty()) {
+        // home
+        m_hub->usage(service_path.path(), home, false);
+    }
+    if (!roaming.isEmpty()) {
+        //roaming
+        m_hub->usage(service_path.path(), roaming, true);
+    }
+}
+
+#include "counterhub.moc"
@@ -0,0 +1,119 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef COUNTERHUB_H
+#define COUNTERHUB_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QVariantMap>
+#include <QVector>
+
+class Counter;
+class NetworkManager;
+
+/*
+ * Shares one ConnMan counter between all running Counter instances of the
+ * process. The counter is registered with the smallest accuracy and
+ * interval any of them asked for, and re-registered only when that
+ * changes. Each Counter gets the usage reports at its own pace: a report
+ * is passed on once the bytes have moved by its accuracy or its interval
+ * has passed, the values in between are merged.
+ *
+ * Changes to the counters are applied together on the next turn of the
+ * event loop, with a single re-registration. Values that start over from
+ * zero after a re-registration are offset by where they were before, so
+ * the counters stay continuous.
+ */
+class CounterHub : public QObject
+{
+    Q_OBJECT
+
+public:
+    static QSharedPointer<CounterHub> sharedInstance();
+    ~CounterHub();
+
+    // Starts or updates the reports to the counter
+    void attach(Counter *counter, quint32 accuracy, quint32 interval);
+    void detach(Counter *counter);
+
+    bool isRegistered() const;
+
+    // Called by the D-Bus adaptor
+    void release();
+    void usage(const QString &servicePath, const QVariantMap &reported, bool roaming);
+
+private Q_SLOTS:
+    void updateRegistration();
+    void flush();
+
+private:
+    typedef QPair<QString, bool> StreamKey; // service path, roaming
+
+    struct Stream {
+        Stream() : deliveredAt(-1), rx(0), tx(0) {}
+
+        QVariantMap pending;
+        qint64 deliveredAt; // -1 until the first report
+        quint64 rx;         // as last delivered
+        quint64 tx;
+    };
+
+    struct Baseline {
+        Baseline() : rebasing(false) {}
+
+        QHash<QString, quint64> values;  // as reported
+        QHash<QString, quint64> offsets;
+        bool rebasing;                   // waiting for the full report
+    };
+
+    struct Client {
+        Counter *counter;
+        quint32 accuracy; // kB
+        quint32 interval; // s
+        QHash<StreamKey, Stream> streams;
+    };
+
+    struct Delivery {
+        Counter *counter;
+        QString servicePath;
+        QVariantMap counters;
+        bool roaming;
+    };
+
+    CounterHub();
+
+    void updateRegistrationLater();
+    QVariantMap rebase(const StreamKey &key, const QVariantMap &counters);
+    int indexOf(Counter *counter) const;
+    bool isDue(const Client &client, const Stream &stream, qint64 now) const;
+    Delivery take(Client &client, const StreamKey &key, Stream &stream, qint64 now);
+    void scheduleFlush(qint64 deadline, qint64 now);
+    void deliver(const QVector<Delivery> &deliveries);
+    void setRegistered(bool registered);
+
+private:
+    QSharedPointer<NetworkManager> m_manager;
+    QString m_path;
+    QVector<Client> m_clients;
+    QHash<StreamKey, QVariantMap> m_latest;
+    QHash<StreamKey, Baseline> m_baselines;
+    bool m_registered;
+    bool m_updatePending;
+    quint32 m_accuracy;
+    quint32 m_interval;
+    QElapsedTimer m_clock;
+    QTimer m_flushTimer;
+    qint64 m_flushDeadline;
+};
+
+#endif // COUNTERHUB_H
@@ -23,6 +23,17 @@ equals(HAVE_LIBDBUSACCESS, 1) {
     DEFINES     += HAVE_LIBDBUSACCESS=0
 }
 
+# CONFIG flag to disable proxy auto-config support, it needs QtQml
+# for the script engine
+nopac {
+    DEFINES     += HAVE_PAC=0
+} else {
+    QT          += qml
+    DEFINES     += HAVE_PAC=1
+    HEADERS     += connmanpacresolver.h
+    SOURCES     += connmanpacresolver.cpp
+}
+
 isEmpty(PREFIX) {
   PREFIX=/usr
 }
@@ -51,12 +62,18 @@ PUBLIC_HEADERS += \
     networkmanager.h \
     networktechnology.h \
     networkservice.h \
+    networkservicefilter.h \
+    networkservicerecord.h \
+    networksnapshot.h \
     connmannetworkproxyfactory.h \
     clockmodel.h \
     useragent.h \
     sessionagent.h \
     networksession.h \
+    sessionsettings.h \
     counter.h \
+    counterhistory.h \
+    counterhistorymodel.h \
     vpnconnection.h \
     vpnmanager.h \
     vpnmodel.h
@@ -66,6 +83,12 @@ HEADERS += \
     logging.h \
     marshalutils.h \
     commondbustypes.h \
+    counterhistoryfile.h \
+    counterhub.h \
+    connmanproxyexcludes.h \
+    networkservicedecoder.h \
+    networksnapshot_p.h \
+    sessionpool.h \
     vpnconnection_p.h \
     vpnmanager_p.h \
     vpnmodel_p.h \
@@ -77,13 +100,24 @@ SOURCES += \
     networkmanager.cpp \
     networktechnology.cpp \
     networkservice.cpp \
+    networkservicedecoder.cpp \
+    networkservicefilter.cpp \
+    networkservicerecord.cpp \
+    networksnapshot.cpp \
     clockmodel.cpp \
     commondbustypes.cpp \
     connmannetworkproxyfactory.cpp \
+    connmanproxyexcludes.cpp \
     useragent.cpp \
     sessionagent.cpp \
     networksession.cpp \
+    sessionpool.cpp \
+    sessionsettings.cpp \
     counter.cpp \
+    counterhub.cpp \
+    counterhistory.cpp \
+    counterhistoryfile.cpp \
+    counterhistorymodel.cpp \
     vpnconnection.cpp \
     vpnmanager.cpp \
     vpnmodel.cpp
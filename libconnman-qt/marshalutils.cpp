@@ -34,6 +34,7 @@
 #include <QDebug>
 #include <QDBusArgument> 
 #include <QDBusMetaType>
+#include <QHash>
 #include "vpnconnection.h"
 
 #include "marshalutils.h"
@@ -41,37 +42,103 @@
 // Empty namespace for local static functions
 namespace {
 
+struct StateName {
+    const char *name;
+    VpnConnection::ConnectionState state;
+};
+
+constexpr StateName stateNames[] = {
+    { "idle", VpnConnection::Idle },
+    { "failure", VpnConnection::Failure },
+    { "association", VpnConnection::Association },
+    { "configuration", VpnConnection::Configuration },
+    { "ready", VpnConnection::Ready },
+    { "disconnect", VpnConnection::Disconnect }
+};
+
+// D-Bus and QML names of the known properties, anything else gets its
+// initial changed case
+struct KeyName {
+    const char *dbus;
+    const char *qml;
+};
+
+constexpr KeyName keyNames[] = {
+    { "AutoConnect", "autoConnect" },
+    { "Domain", "domain" },
+    { "Host", "host" },
+    { "Immutable", "immutable" },
+    { "Index", "index" },
+    { "IPv4", "ipv4" },
+    { "IPv6", "ipv6" },
+    { "Name", "name" },
+    { "Nameservers", "nameservers" },
+    { "ServerRoutes", "serverRoutes" },
+    { "SplitRouting", "splitRouting" },
+    { "State", "state" },
+    { "StoreCredentials", "storeCredentials" },
+    { "Type", "type" },
+    { "UserRoutes", "userRoutes" }
+};
+
+struct KeyMaps {
+    KeyMaps()
+    {
+        for (const KeyName &key : keyNames) {
+            const QString dbus(QLatin1String(key.dbus));
+            const QString qml(QLatin1String(key.qml));
+            toQml.insert(dbus, qml);
+            toDBus.insert(qml, dbus);
+        }
+    }
+
+    QHash<QString, QString> toQml;
+    QHash<QString, QString> toDBus;
+};
+
+const KeyMaps &keyMaps()
+{
+    static const KeyMaps maps;
+    return maps;
+}
+
 QVariant convertState(const QString &key, const QVariant &value, bool toDBus)
 {
-    QList<QPair<QVariant, QVariant> > states;
-    states.push_back(qMakePair(QVariant::fromValue(QStringLiteral("idle")),
-                               QVariant::fromValue(static_cast<int>(VpnConnection::Idle))));
-    states.push_back(qMakePair(QVariant::fromValue(QStringLiteral("failure")),
-                               QVariant::fromValue(static_cast<int>(VpnConnection::Failure))));
-    states.push_back(qMakePair(QVariant::fromValue(QStringLiteral("association")),
-                               QVariant::fromValue(static_cast<int>(VpnConnection::Association))));
-    states.push_back(qMakePair(QVariant::fromValue(QStringLiteral("configuration")),
-                               QVariant::fromValue(static_cast<int>(VpnConnection::Configuration))));
-    states.push_back(qMakePair(QVariant::fromValue(QStringLiteral("ready")),
-                               QVariant::fromValue(static_cast<int>(VpnConnection::Ready))));
-    states.push_back(qMakePair(QVariant::fromValue(QStringLiteral("disconnect")),
-                               QVariant::fromValue(static_cast<int>(VpnConnection::Disconnect))));
-
-    auto lit = std::find_if(states.cbegin(), states.cend(),
-                            [value, toDBus](const QPair<QVariant, QVariant> &pair) {
-        return value == (toDBus ? pair.second : pair.first); });
-
-    if (lit != states.end()) {
-        return toDBus ? (*lit).first : (*lit).second;
+    if (toDBus) {
+        bool ok = false;
+        const int state = value.toInt(&ok);
+        if (ok) {
+            for (const StateName &entry : stateNames) {
+                if (entry.state == state)
+                    return QVariant::fromValue(QString(QLatin1String(entry.name)));
+            }
+        }
+    } else {
+        const QString name(value.toString());
+        for (const StateName &entry : stateNames) {
+            if (name == QLatin1String(entry.name))
+                return QVariant::fromValue(static_cast<int>(entry.state));
+        }
     }
+
     qDebug() << "No conversion found for" << (toDBus ? "QML" : "DBus") << "value:" << value << key;
     return value;
 }
 
+bool registerRouteTypes()
+{
+    qDBusRegisterMetaType<RouteStructure>();
+    qDBusRegisterMetaType<QList<RouteStructure>>();
+    return true;
+}
+
 QVariant convertRoutes(const QString &, const QVariant &value, bool toDBus) {
     // We use qDBusRegisterMetaType in VpnConnections to convert automatically
     // between QList<RouteStruture> and QDBusArgument, but we still need to
     // convert to/from suitable Javascript structures
+    static const bool registered = registerRouteTypes();
+    Q_UNUSED(registered)
+
     QVariant variant;
     if (toDBus) {
         QVariantList in = value.toList();
@@ -103,6 +170,18 @@ QVariant convertRoutes(const QString &, const QVariant &value, bool toDBus) {
     return variant;
 }
 
+struct Conversion {
+    const char *key;
+    MarshalUtils::conversionFunction function;
+};
+
+// Keys are matched case insensitively
+constexpr Conversion conversions[] = {
+    { "state", convertState },
+    { "userroutes", convertRoutes },
+    { "serverroutes", convertRoutes }
+};
+
 } // Empty namespace
 
 // Marshall the RouteStructure data into a D-Bus argument
@@ -162,32 +241,37 @@ inline QVariant extractArray(const QDBusArgument &arg)
 
 QVariantMap MarshalUtils::propertiesToQml(const QVariantMap &fromDBus)
 {
+    const QHash<QString, QString> &toQml(keyMaps().toQml);
     QVariantMap rv;
 
     QVariantMap providerProperties;
 
     for (QVariantMap::const_iterator it = fromDBus.cbegin(), end = fromDBus.cend(); it != end; ++it) {
-        QString key(it.key());
-        QVariant value(it.value());
+        const QString &dbusKey(it.key());
 
-        if (key.indexOf(QChar('.')) != -1) {
-            providerProperties.insert(key, value);
+        if (dbusKey.indexOf(QChar('.')) != -1) {
+            providerProperties.insert(dbusKey, it.value());
             continue;
         }
 
-        // QML properties must be lowercased
-        QChar &initial(*key.begin());
-        initial = initial.toLower();
+        QString key;
+        QHash<QString, QString>::const_iterator known = toQml.constFind(dbusKey);
+        if (known != toQml.constEnd()) {
+            key = known.value();
+        } else {
+            // QML properties must be lowercased
+            key = dbusKey;
+            QChar &initial(*key.begin());
+            initial = initial.toLower();
+        }
 
         // Some properties must be extracted manually
-        if (key == QStringLiteral("iPv4") ||
-            key == QStringLiteral("iPv6")) {
-            // iPv4 becomes ipv4 and iPv6 becomes ipv6
-            key = key.toLower();
-            value = extract<QVariantMap>(value.value<QDBusArgument>());
+        if (key == QLatin1String("ipv4") ||
+            key == QLatin1String("ipv6")) {
+            rv.insert(key, extract<QVariantMap>(it.value().value<QDBusArgument>()));
+        } else {
+            rv.insert(key, convertToQml(key, it.value()));
         }
-
-        rv.insert(key, convertToQml(key, value));
     }
 
     if (!providerProperties.isEmpty()) {
@@ -200,25 +284,19 @@ QVariantMap MarshalUtils::propertiesToQml(const QVariantMap &fromDBus)
 // Conversion to/from DBus/QML
 QHash<QString, MarshalUtils::conversionFunction> MarshalUtils::propertyConversions()
 {
-    qDBusRegisterMetaType<RouteStructure>();
-    qDBusRegisterMetaType<QList<RouteStructure>>();
-
     QHash<QString, conversionFunction> rv;
 
-    rv.insert(QStringLiteral("state"), convertState);
-    rv.insert(QStringLiteral("userroutes"), convertRoutes);
-    rv.insert(QStringLiteral("serverroutes"), convertRoutes);
+    for (const Conversion &conversion : conversions)
+        rv.insert(QLatin1String(conversion.key), conversion.function);
 
     return rv;
 }
 
 QVariant MarshalUtils::convertValue(const QString &key, const QVariant &value, bool toDBus)
 {
-    static const QHash<QString, conversionFunction> conversions(propertyConversions());
-
-    auto it = conversions.find(key.toLower());
-    if (it != conversions.end()) {
-        return it.value()(key, value, toDBus);
+    for (const Conversion &conversion : conversions) {
+        if (key.compare(QLatin1String(conversion.key), Qt::CaseInsensitive) == 0)
+            return conversion.function(key, value, toDBus);
     }
 
     return value;
@@ -236,14 +314,14 @@ QVariant MarshalUtils::convertToDBus(const QString &key, const QVariant &value)
 
 QVariantMap MarshalUtils::propertiesToDBus(const QVariantMap &fromQml)
 {
+    const QHash<QString, QString> &toDBus(keyMaps().toDBus);
     QVariantMap rv;
 
     for (QVariantMap::const_iterator it = fromQml.cbegin(), end = fromQml.cend(); it != end; ++it) {
-        QString key(it.key());
-        QVariant value(it.value());
+        const QString &qmlKey(it.key());
 
-        if (key == QStringLiteral("providerProperties")) {
-            const QVariantMap providerProperties(value.value<QVariantMap>());
+        if (qmlKey == QLatin1String("providerProperties")) {
+            const QVariantMap providerProperties(it.value().value<QVariantMap>());
             for (QVariantMap::const_iterator pit = providerProperties.cbegin(), pend = providerProperties.cend();
                  pit != pend; ++pit) {
                 rv.insert(pit.key(), pit.value());
@@ -251,17 +329,18 @@ QVariantMap MarshalUtils::propertiesToDBus(const QVariantMap &fromQml)
             continue;
         }
 
-        // The DBus properties are capitalized
-        QChar &initial(*key.begin());
-        initial = initial.toUpper();
-
-        if (key == QStringLiteral("Ipv4") ||
-            key == QStringLiteral("Ipv6")) {
-            // Ipv4 becomes IPv4 and Ipv6 becomes IPv6
-            key[1] = 'P';
+        QString key;
+        QHash<QString, QString>::const_iterator known = toDBus.constFind(qmlKey);
+        if (known != toDBus.constEnd()) {
+            key = known.value();
+        } else {
+            // The DBus properties are capitalized
+            key = qmlKey;
+            QChar &initial(*key.begin());
+            initial = initial.toUpper();
         }
 
-        rv.insert(key, convertToDBus(key, value));
+        rv.insert(key, convertToDBus(key, it.value()));
     }
 
     return rv;
@@ -9,11 +9,15 @@
  */
 
 #include "networkmanager.h"
+#include "networkservicerecord.h"
+#include "networkservicedecoder.h"
+#include "networksnapshot_p.h"
 #include "commondbustypes.h"
 #include "marshalutils.h"
 #include "logging.h"
 
 #include <QRegularExpression>
+#include <QThread>
 #include <QWeakPointer>
 
 static const uint DefaultInputRequestTimeout(300000);
@@ -29,6 +33,75 @@ static const QString DefaultServiceProperty("DefaultService");
 static const QString TetheringClientsProperty("TetheringClients");
 static const QString WiFiWpa3SupportProperty("WiFiWPA3Support");
 
+static const QString SavedProperty("Saved");
+static const QString AvailableProperty("Available");
+
+// Estimated heap use of a property value as held in a property cache.
+// Counts the payload of strings, lists and dictionaries, not the
+// allocator overhead.
+static qint64 propertyMemoryUsage(const QVariant &value)
+{
+    qint64 size = sizeof(QVariant);
+
+    QVariant plain(value);
+    if (value.userType() == qMetaTypeId<QDBusArgument>()) {
+        const QDBusArgument argument(value.value<QDBusArgument>());
+        if (argument.currentType() == QDBusArgument::MapType)
+            plain = qdbus_cast<QVariantMap>(argument);
+        else if (argument.currentType() == QDBusArgument::ArrayType)
+            plain = qdbus_cast<QVariantList>(argument);
+    }
+
+    switch (plain.userType()) {
+    case QMetaType::QString:
+        size += plain.toString().size() * sizeof(QChar);
+        break;
+    case QMetaType::QStringList: {
+        const QStringList list(plain.toStringList());
+        for (const QString &string : list)
+            size += sizeof(QString) + string.size() * sizeof(QChar);
+        break;
+    }
+    case QMetaType::QVariantList: {
+        const QVariantList list(plain.toList());
+        for (const QVariant &item : list)
+            size += propertyMemoryUsage(item);
+        break;
+    }
+    case QMetaType::QVariantMap: {
+        const QVariantMap map(plain.toMap());
+        for (QVariantMap::ConstIterator it = map.constBegin(); it != map.constEnd(); ++it)
+            size += sizeof(QString) + it.key().size() * sizeof(QChar) + propertyMemoryUsage(it.value());
+        break;
+    }
+    default:
+        break;
+    }
+    return size;
+}
+
+// Cost of a service object for the memory accounting on top of its
+// record: the object itself and the current values of the properties
+// that carry a payload. The D-Bus proxy and the connections are not
+// included.
+static qint64 serviceObjectMemoryUsage(const NetworkService *service)
+{
+    const QVariant values[] = {
+        service->name(), service->type(), service->state(), service->error(),
+        service->security(), service->ipv4(), service->ipv4Config(),
+        service->ipv6(), service->ipv6Config(), service->nameservers(),
+        service->nameserversConfig(), service->domains(), service->domainsConfig(),
+        service->timeservers(), service->timeserversConfig(), service->proxy(),
+        service->proxyConfig(), service->ethernet(), service->bssid(),
+        service->encryptionMode()
+    };
+
+    qint64 size = sizeof(NetworkService);
+    for (const QVariant &value : values)
+        size += propertyMemoryUsage(value);
+    return size;
+}
+
 // ==========================================================================
 // NetworkManagerFactory
 // ==========================================================================
@@ -94,6 +167,29 @@ public:
     QStringList m_servicesOrder;
     QStringList m_savedServicesOrder;
 
+    /* All services reported by ConnMan, including the filtered out ones */
+    QStringList m_listedServicesOrder;
+    QHash<QString, NetworkServiceRecord> m_serviceRecords;
+    NetworkServiceFilter::List m_serviceFilters;
+    bool m_filterCheckPending;
+
+    /* Listed services that only have a record, no object (yet) */
+    QSet<QString> m_demotedServices;
+
+    bool m_watchingServices;
+    bool m_watchingServiceList;
+
+    /* Optional decoding of the service updates on a worker thread */
+    bool m_backgroundDecoding;
+    QThread *m_decoderThread;
+    NetworkServiceDecoder *m_decoder;
+    uint m_decoderGeneration;
+
+    /* State published for other threads */
+    NetworkSnapshotPublisher m_snapshots;
+    quint64 m_snapshotSerial;
+    bool m_snapshotPending;
+
     /* This variable is used just to send signal if changed */
     NetworkService* m_defaultRoute;
 
@@ -106,9 +202,23 @@ public:
     bool m_available;
 
 public:
-    static bool selectSaved(NetworkService *service);
-    static bool selectAvailable(NetworkService *service);
-    static bool selectSavedOrAvailable(NetworkService *service);
+    static bool selectSaved(const Private *priv, const QString &path);
+    static bool selectAvailable(const Private *priv, const QString &path);
+    static bool selectSavedOrAvailable(const Private *priv, const QString &path);
+    bool acceptService(const NetworkServiceRecord &record) const;
+    QStringList acceptServices(const QVector<NetworkServiceRecord> &services) const;
+    QString serviceType(const QString &path) const;
+    bool needsObject(const QString &path) const;
+    qint64 serviceMemoryUsage(const QString &path) const;
+    qint64 serviceMemoryUsage() const;
+    NetworkService *service(const QString &path);
+    NetworkService *materialize(const QString &path);
+    void connectService(NetworkService *service);
+    void watchServices(bool watch);
+    void watchServiceList(bool watch);
+    void startDecoder();
+    void stopDecoder();
+    void refreshServices();
     bool updateWifiConnected(NetworkService *service);
     bool updateEthernetConnected(NetworkService *service);
     bool updateWifiConnecting(NetworkService *service);
@@ -117,8 +227,11 @@ public:
 
     void updateState(const QString &newState);
 
+    void updateServices(const QVector<NetworkServiceRecord> &changed, const QList<QDBusObjectPath> &removed);
+
 public slots:
-    void updateServices(const ConnmanObjectList &changed, const QList<QDBusObjectPath> &removed);
+    void onServicesChanged(const QDBusMessage &message);
+    void applyChanges(const NetworkServiceChanges::Ref &changes);
 
 public:
     Private(NetworkManager *parent)
@@ -131,6 +244,16 @@ public:
         , m_connectedEthernet(nullptr)
         , m_proxy(nullptr)
         , m_servicesCacheHasUpdates(false)
+        , m_serviceFilters(NetworkServiceFilter::defaultFilters())
+        , m_filterCheckPending(false)
+        , m_watchingServices(false)
+        , m_watchingServiceList(false)
+        , m_backgroundDecoding(false)
+        , m_decoderThread(nullptr)
+        , m_decoder(nullptr)
+        , m_decoderGeneration(0)
+        , m_snapshotSerial(0)
+        , m_snapshotPending(false)
         , m_defaultRoute(nullptr)
         , m_invalidDefaultRoute(new NetworkService("/", QVariantMap(), this))
         , m_defaultRouteIsVPN(false)
@@ -138,15 +261,26 @@ public:
     {
     }
 
+    ~Private()
+    {
+        stopDecoder();
+    }
+
     NetworkManager* manager()
         { return static_cast<NetworkManager*>(parent()); }
     void maybeCreateInterfaceProxyLater()
         { QMetaObject::invokeMethod(this, "maybeCreateInterfaceProxy"); }
+    void watchTechnology(NetworkTechnology *technology);
 
 public Q_SLOTS:
     void maybeCreateInterfaceProxy();
     void onConnectedChanged();
     void onWifiConnectingChanged();
+    void onServicePropertyChanged(const QString &name, const QDBusVariant &value, const QDBusMessage &message);
+    void checkFiltersLater();
+    void checkFilters();
+    void publishSnapshotLater();
+    void publishSnapshot();
 };
 
 class NetworkManager::Private::ListUpdate
@@ -184,19 +318,369 @@ public:
     int count;
 };
 
-bool NetworkManager::Private::selectSaved(NetworkService *service)
+bool NetworkManager::Private::selectSaved(const Private *priv, const QString &path)
+{
+    NetworkService *service = priv->m_servicesCache.value(path);
+    if (service)
+        return service->saved();
+    return priv->m_demotedServices.contains(path) && priv->m_serviceRecords.value(path).saved();
+}
+
+bool NetworkManager::Private::selectAvailable(const Private *priv, const QString &path)
+{
+    NetworkService *service = priv->m_servicesCache.value(path);
+    if (service)
+        return service->available();
+    return priv->m_demotedServices.contains(path) && priv->m_serviceRecords.value(path).available();
+}
+
+bool NetworkManager::Private::selectSavedOrAvailable(const Private *priv, const QString &path)
+{
+    return selectSaved(priv, path) || selectAvailable(priv, path);
+}
+
+QString NetworkManager::Private::serviceType(const QString &path) const
+{
+    NetworkService *service = m_servicesCache.value(path);
+    if (service)
+        return service->type();
+    if (m_demotedServices.contains(path))
+        return m_serviceRecords.value(path).type;
+    return QString();
+}
+
+bool NetworkManager::Private::needsObject(const QString &path) const
+{
+    // These are tracked through the NetworkService signals
+    if (path == m_propertiesCache.value(DefaultServiceProperty).toString())
+        return true;
+
+    const NetworkServiceRecord record(m_serviceRecords.value(path));
+    return record.connected() || record.connecting();
+}
+
+qint64 NetworkManager::Private::serviceMemoryUsage(const QString &path) const
+{
+    if (m_servicesCache.contains(path)) {
+        return serviceObjectMemoryUsage(m_servicesCache.value(path)) + m_serviceRecords.value(path).memoryUsage();
+    } else if (m_demotedServices.contains(path)) {
+        return m_serviceRecords.value(path).memoryUsage();
+    }
+    return 0;
+}
+
+qint64 NetworkManager::Private::serviceMemoryUsage() const
+{
+    qint64 size = 0;
+
+    for (QHash<QString, NetworkService *>::ConstIterator it = m_servicesCache.constBegin();
+            it != m_servicesCache.constEnd(); ++it) {
+        size += serviceMemoryUsage(it.key());
+    }
+    for (const QString &path : m_demotedServices)
+        size += serviceMemoryUsage(path);
+    return size;
+}
+
+NetworkService *NetworkManager::Private::service(const QString &path)
+{
+    NetworkService *service = m_servicesCache.value(path);
+
+    if (!service && m_demotedServices.contains(path)) {
+        // Created from the record, the object fetches the rest of the
+        // properties asynchronously and emits propertiesReady
+        qCDebug(lcConnman) << "Restoring demoted service" << path;
+        service = materialize(path);
+        connectService(service);
+    }
+    return service;
+}
+
+NetworkService *NetworkManager::Private::materialize(const QString &path)
+{
+    // The object fetches the rest of the properties by itself
+    const QVariantMap properties(m_serviceRecords.value(path).toMap());
+    NetworkService *service = new NetworkService(path, properties, this);
+
+    m_servicesCache.insert(path, service);
+    m_demotedServices.remove(path);
+    return service;
+}
+
+void NetworkManager::Private::connectService(NetworkService *service)
+{
+    if (service->type() == WifiType) {
+        // Some special treatment for WiFi services
+        updateWifiConnected(service);
+        connect(service, &NetworkService::connectingChanged,
+                this, &NetworkManager::Private::onWifiConnectingChanged);
+    } else if (service->type() == EthernetType) {
+        updateEthernetConnected(service);
+    }
+
+    connect(service, &NetworkService::connectedChanged,
+            this, &NetworkManager::Private::onConnectedChanged);
+}
+
+void NetworkManager::Private::watchServices(bool watch)
+{
+    if (m_watchingServices == watch)
+        return;
+
+    // Services without an object have no proxy of their own, a single
+    // subscription for all services keeps the records current
+    QDBusConnection bus(QDBusConnection::systemBus());
+    if (watch) {
+        m_watchingServices = bus.connect(CONNMAN_SERVICE, QString(), "net.connman.Service", "PropertyChanged",
+                this, SLOT(onServicePropertyChanged(QString,QDBusVariant,QDBusMessage)));
+    } else {
+        bus.disconnect(CONNMAN_SERVICE, QString(), "net.connman.Service", "PropertyChanged",
+                this, SLOT(onServicePropertyChanged(QString,QDBusVariant,QDBusMessage)));
+        m_watchingServices = false;
+    }
+}
+
+void NetworkManager::Private::watchServiceList(bool watch)
+{
+    if (m_watchingServiceList == watch)
+        return;
+
+    // Connected by hand to get the raw message for the record decoder
+    QDBusConnection bus(QDBusConnection::systemBus());
+    if (watch) {
+        m_watchingServiceList = bus.connect(CONNMAN_SERVICE, "/", "net.connman.Manager", "ServicesChanged",
+                this, SLOT(onServicesChanged(QDBusMessage)));
+    } else {
+        bus.disconnect(CONNMAN_SERVICE, "/", "net.connman.Manager", "ServicesChanged",
+                this, SLOT(onServicesChanged(QDBusMessage)));
+        m_watchingServiceList = false;
+    }
+}
+
+void NetworkManager::Private::startDecoder()
+{
+    if (!m_decoder) {
+        static const int changesType = qRegisterMetaType<NetworkServiceChanges::Ref>("NetworkServiceChanges::Ref");
+        Q_UNUSED(changesType)
+
+        // Change sets of an earlier decoder may still be queued, the
+        // generation tells them apart
+        m_decoderThread = new QThread(this);
+        m_decoder = new NetworkServiceDecoder(++m_decoderGeneration);
+        m_decoder->moveToThread(m_decoderThread);
+        connect(m_decoderThread, SIGNAL(finished()), m_decoder, SLOT(deleteLater()));
+        connect(m_decoder, SIGNAL(changesReady(NetworkServiceChanges::Ref)),
+                this, SLOT(applyChanges(NetworkServiceChanges::Ref)), Qt::QueuedConnection);
+        m_decoderThread->start();
+    }
+    QMetaObject::invokeMethod(m_decoder, "start", Qt::QueuedConnection);
+}
+
+void NetworkManager::Private::stopDecoder()
+{
+    if (m_decoder) {
+        // Unsubscribe before the thread goes away
+        QMetaObject::invokeMethod(m_decoder, "stop", Qt::BlockingQueuedConnection);
+        m_decoderThread->quit();
+        m_decoderThread->wait();
+        delete m_decoderThread;
+        m_decoderThread = nullptr;
+        m_decoder = nullptr;
+    }
+}
+
+void NetworkManager::Private::applyChanges(const NetworkServiceChanges::Ref &changes)
+{
+    if (changes->generation != m_decoderGeneration || !m_decoder)
+        return;
+
+    if (changes->listing) {
+        updateServices(changes->services, changes->removed);
+        return;
+    }
+
+    bool refresh = false;
+    bool updated = false;
+    for (const NetworkServiceRecord &record : changes->services) {
+        QHash<QString, NetworkServiceRecord>::Iterator it = m_serviceRecords.find(record.path);
+        if (it == m_serviceRecords.end())
+            continue;
+
+        // Same as onServicePropertyChanged(), objects take care of themselves
+        if (m_demotedServices.contains(record.path)
+                && (it->state != record.state || it->saved() != record.saved()
+                    || it->available() != record.available())) {
+            refresh = true;
+        }
+        it.value() = record;
+        updated = true;
+    }
+
+    if (refresh)
+        refreshServices();
+    else if (updated)
+        checkFiltersLater();
+    publishSnapshotLater();
+}
+
+void NetworkManager::Private::watchTechnology(NetworkTechnology *technology)
+{
+    connect(technology, SIGNAL(poweredChanged(bool)), this, SLOT(publishSnapshotLater()));
+    connect(technology, SIGNAL(connectedChanged(bool)), this, SLOT(publishSnapshotLater()));
+}
+
+void NetworkManager::Private::publishSnapshotLater()
+{
+    // Updates tend to come in groups, publish once they have been applied
+    if (!m_snapshotPending) {
+        m_snapshotPending = true;
+        QMetaObject::invokeMethod(this, "publishSnapshot", Qt::QueuedConnection);
+    }
+}
+
+void NetworkManager::Private::publishSnapshot()
+{
+    NetworkManager *manager = this->manager();
+    NetworkSnapshotData *data = new NetworkSnapshotData;
+
+    m_snapshotPending = false;
+    data->serial = ++m_snapshotSerial;
+    data->valid = manager->isValid();
+    data->state = manager->state();
+    data->offlineMode = manager->offlineMode();
+    data->connected = manager->connected();
+    if (m_defaultRoute && m_defaultRoute != m_invalidDefaultRoute)
+        data->defaultRoute = m_defaultRoute->path();
+
+    data->technologies.reserve(m_technologiesCache.count());
+    for (NetworkTechnology *technology : m_technologiesCache) {
+        NetworkSnapshot::Technology tech = {
+            technology->path(),
+            technology->name(),
+            technology->type(),
+            technology->powered(),
+            technology->connected()
+        };
+        data->technologies.append(tech);
+    }
+
+    data->services.reserve(m_servicesOrder.count());
+    data->serviceIndex.reserve(m_servicesOrder.count());
+    for (const QString &path : m_servicesOrder) {
+        data->serviceIndex.insert(path, data->services.count());
+        data->services.append(m_serviceRecords.value(path, NetworkServiceRecord(path)));
+    }
+
+    m_snapshots.publish(NetworkSnapshot(data));
+}
+
+void NetworkManager::Private::onServicePropertyChanged(const QString &name, const QDBusVariant &value,
+        const QDBusMessage &message)
+{
+    QHash<QString, NetworkServiceRecord>::Iterator it = m_serviceRecords.find(message.path());
+
+    if (it == m_serviceRecords.end() || !it->update(name, value.variant()))
+        return;
+
+    publishSnapshotLater();
+
+    // Objects take care of themselves, otherwise the service may need
+    // an object now or to be moved between the lists
+    if (m_demotedServices.contains(it->path)
+            && (name == StateProperty || name == SavedProperty || name == AvailableProperty)) {
+        refreshServices();
+    } else {
+        // The change may let a hidden service through the filters, or
+        // hide another one
+        checkFiltersLater();
+    }
+}
+
+void NetworkManager::Private::checkFiltersLater()
+{
+    // Strength changes come in bursts, check once they have been applied
+    if (!m_filterCheckPending) {
+        m_filterCheckPending = true;
+        QMetaObject::invokeMethod(this, "checkFilters", Qt::QueuedConnection);
+    }
+}
+
+void NetworkManager::Private::checkFilters()
 {
-    return service && service->saved();
+    m_filterCheckPending = false;
+
+    if (m_serviceFilters.isEmpty())
+        return;
+
+    QVector<NetworkServiceRecord> services;
+    services.reserve(m_listedServicesOrder.count());
+    for (const QString &path : m_listedServicesOrder)
+        services.append(m_serviceRecords.value(path, NetworkServiceRecord(path)));
+
+    // Only update the lists if the filters decide differently now
+    if (acceptServices(services) != m_servicesOrder) {
+        qCDebug(lcConnman) << "Service filter results changed";
+        updateServices(services, QList<QDBusObjectPath>());
+    }
 }
 
-bool NetworkManager::Private::selectAvailable(NetworkService *service)
+void NetworkManager::Private::refreshServices()
 {
-    return service && service->available();
+    QVector<NetworkServiceRecord> services;
+
+    services.reserve(m_listedServicesOrder.count());
+    for (const QString &path : m_listedServicesOrder)
+        services.append(m_serviceRecords.value(path, NetworkServiceRecord(path)));
+    updateServices(services, QList<QDBusObjectPath>());
 }
 
-bool NetworkManager::Private::selectSavedOrAvailable(NetworkService *service)
+void NetworkManager::Private::onServicesChanged(const QDBusMessage &message)
 {
-    return service && (service->saved() || service->available());
+    // Decode the changed services straight into records, starting from
+    // the ones we already have. Only new services come with properties.
+    const QList<QVariant> args(message.arguments());
+    if (args.count() < 2) {
+        qWarning() << "Invalid ServicesChanged signal";
+        return;
+    }
+
+    const QVector<NetworkServiceRecord> changed(NetworkServiceRecord::decodeList(
+            args.at(0).value<QDBusArgument>(), m_serviceRecords));
+    const QList<QDBusObjectPath> removed(qdbus_cast<QList<QDBusObjectPath> >(args.at(1)));
+
+    updateServices(changed, removed);
+}
+
+bool NetworkManager::Private::acceptService(const NetworkServiceRecord &record) const
+{
+    for (const NetworkServiceFilter::Ref &filter : m_serviceFilters) {
+        switch (filter->check(record)) {
+        case NetworkServiceFilter::Keep:
+            return true;
+        case NetworkServiceFilter::Drop:
+            return false;
+        case NetworkServiceFilter::Pass:
+            break;
+        }
+    }
+    return true;
+}
+
+// The paths of the services the pipeline lets through, in the given order
+QStringList NetworkManager::Private::acceptServices(const QVector<NetworkServiceRecord> &services) const
+{
+    for (const NetworkServiceFilter::Ref &filter : m_serviceFilters)
+        filter->prepare(services);
+
+    // Never filter out the default route
+    const QString defaultService(m_propertiesCache.value(DefaultServiceProperty).toString());
+
+    QStringList accepted;
+    for (const NetworkServiceRecord &record : services) {
+        if (record.path == defaultService || acceptService(record))
+            accepted.append(record.path);
+    }
+    return accepted;
 }
 
 void NetworkManager::Private::maybeCreateInterfaceProxy()
@@ -219,10 +703,11 @@ bool NetworkManager::Private::updateWifiConnected(NetworkService *service)
             return true;
         }
     } else if (m_connectedWifi == service) {
-        QVector<NetworkService*> availableWifi = manager()->getAvailableServices(WifiType);
+        // Connected services always have an object
         m_connectedWifi = NULL;
-        for (NetworkService *wifi: availableWifi) {
-            if (wifi->connected()) {
+        for (const QString &path : m_availableServicesOrder) {
+            NetworkService *wifi = m_servicesCache.value(path);
+            if (wifi && wifi->type() == WifiType && wifi->connected()) {
                 m_connectedWifi = wifi;
                 break;
             }
@@ -240,10 +725,10 @@ bool NetworkManager::Private::updateEthernetConnected(NetworkService *service)
             return true;
         }
     } else if (m_connectedEthernet == service) {
-        QVector<NetworkService*> availableEthernet = manager()->getAvailableServices(EthernetType);
         m_connectedEthernet = NULL;
-        for (NetworkService *ethernet: availableEthernet) {
-            if (ethernet->connected()) {
+        for (const QString &path : m_availableServicesOrder) {
+            NetworkService *ethernet = m_servicesCache.value(path);
+            if (ethernet && ethernet->type() == EthernetType && ethernet->connected()) {
                 m_connectedEthernet = ethernet;
                 break;
             }
@@ -336,7 +821,7 @@ void NetworkManager::Private::updateState(const QString &newState)
     manager()->updateDefaultRoute();
 }
 
-void NetworkManager::Private::updateServices(const ConnmanObjectList &changed, const QList<QDBusObjectPath> &removed)
+void NetworkManager::Private::updateServices(const QVector<NetworkServiceRecord> &changed, const QList<QDBusObjectPath> &removed)
 {
     ListUpdate services(&m_servicesOrder);
     ListUpdate savedServices(&m_savedServicesOrder);
@@ -350,63 +835,70 @@ void NetworkManager::Private::updateServices(const ConnmanObjectList &changed, c
     NetworkService* prevConnectedWifi = m_connectedWifi;
     NetworkService* prevConnectedEthernet = m_connectedEthernet;
 
-    for (const ConnmanObject &obj : changed) {
-        const QString path(obj.objpath.path());
+    // The records come already merged with what has been reported so far
+    // and are kept current by the PropertyChanged watch
+    QHash<QString, NetworkServiceRecord> records;
+    records.reserve(changed.count());
+    m_listedServicesOrder.clear();
+    if (!m_decoder)
+        watchServices(true);
 
-        // Ignore all WiFi with a zeroed/unknown BSSIDs to reduce list size
-        // in crowded areas. These are most likely weak and really unreachable
-        // but ConnMan maintains them if they come within reach and then they
-        // have a valid BSSID. WiFi services with an empty BSSID are saved ones
-        // that are not in the range.
-        if (obj.properties.value("Type").toString() == WifiType) {
-            const QString bssid = obj.properties.value("BSSID").toString();
+    for (const NetworkServiceRecord &record : changed) {
+        records.insert(record.path, record);
+        m_listedServicesOrder.append(record.path);
+    }
+    m_serviceRecords.swap(records);
 
-            if (bssid == QStringLiteral("00:00:00:00:00:00"))
-                continue;
-        }
+    const QStringList accepted(acceptServices(changed));
 
+    for (const QString &path : accepted) {
         NetworkService *service = m_servicesCache.value(path);
         if (service) {
             // We don't want to emit signals at this point. Those will
-            // be emitted later, after internal state is fully updated
+            // be emitted later, after internal state is fully updated.
+            // Existing objects follow their own PropertyChanged signals.
             disconnect(service, nullptr, this, nullptr);
-            service->updateProperties(obj.properties);
         } else {
-            service = new NetworkService(path, obj.properties, this);
-            m_servicesCache.insert(path, service);
-            addedServices.append(path);
+            // Objects are created on demand, except for the services
+            // whose state NetworkManager follows
+            const bool demoted = m_demotedServices.contains(path);
+
+            if (needsObject(path)) {
+                service = materialize(path);
+            } else if (!demoted) {
+                m_demotedServices.insert(path);
+            }
+            if (!demoted) {
+                addedServices.append(path);
+            }
         }
 
         // Full list
         services.add(path);
 
         // Saved services
-        if (selectSaved(service)) {
+        if (selectSaved(this, path)) {
             savedServices.add(path);
         }
 
         // Available services
-        if (selectAvailable(service)) {
+        if (selectAvailable(this, path)) {
             availableServices.add(path);
         }
 
         // Per-technology lists
-        const QString type(service->type());
+        const QString type(serviceType(path));
         if (type == WifiType) {
             wifiServices.add(path);
-            // Some special treatment for WiFi services
-            updateWifiConnected(service);
-            connect(service, &NetworkService::connectingChanged,
-                    this, &NetworkManager::Private::onWifiConnectingChanged);
         } else if (type == CellularType) {
             cellularServices.add(path);
         } else if (type == EthernetType) {
             ethernetServices.add(path);
-            updateEthernetConnected(service);
         }
 
-        connect(service, &NetworkService::connectedChanged,
-                this, &NetworkManager::Private::onConnectedChanged);
+        if (service) {
+            connectService(service);
+        }
     }
 
     // Cut the tails
@@ -430,25 +922,42 @@ void NetworkManager::Private::updateServices(const ConnmanObjectList &changed, c
             }
             service->deleteLater();
             removedServices.append(path);
+        } else if (m_demotedServices.remove(path)) {
+            removedServices.append(path);
         } else {
             // connman maintains a virtual "hidden" wifi network and removes it upon init
             qCDebug(lcConnman) << "attempted to remove non-existing service" << path;
         }
     }
 
-    // Make sure that m_servicesCache doesn't contain stale elements.
-    // Hopefully that won't happen too often (if at all)
-    if (m_servicesCache.count() > m_servicesOrder.count()) {
+    // Make sure that m_servicesCache doesn't contain stale elements
+    // or services that the filters no longer let through
+    for (QSet<QString>::Iterator it = m_demotedServices.begin(); it != m_demotedServices.end();) {
+        if (!m_servicesOrder.contains(*it)) {
+            removedServices.append(*it);
+            it = m_demotedServices.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (m_servicesCache.count() + m_demotedServices.count() > m_servicesOrder.count()) {
         QStringList keys = m_servicesCache.keys();
         for (const QString &path: keys) {
             if (!m_servicesOrder.contains(path)) {
                 NetworkService *service = m_servicesCache.take(path);
+                if (service == m_connectedWifi) {
+                    m_connectedWifi = nullptr;
+                }
+                if (service == m_connectedEthernet) {
+                    m_connectedEthernet = nullptr;
+                }
                 if (service == m_defaultRoute) {
                     m_defaultRoute = m_invalidDefaultRoute;
                 }
                 service->deleteLater();
                 removedServices.append(path);
-                if (m_servicesCache.count() == m_servicesOrder.count()) {
+                if (m_servicesCache.count() + m_demotedServices.count() == m_servicesOrder.count()) {
                     break;
                 }
             }
@@ -639,6 +1148,21 @@ NetworkManager::NetworkManager(QObject* parent)
     m_priv(new Private(this))
 {
     registerCommonDataTypes();
+
+    // Republish the snapshot whenever something it covers changes
+    const char *const snapshotSignals[] = {
+        SIGNAL(availabilityChanged(bool)),
+        SIGNAL(stateChanged(QString)),
+        SIGNAL(offlineModeChanged(bool)),
+        SIGNAL(technologiesChanged()),
+        SIGNAL(servicesChanged()),
+        SIGNAL(defaultRouteChanged(NetworkService*)),
+        SIGNAL(validChanged()),
+        SIGNAL(connectedChanged())
+    };
+    for (const char *signal : snapshotSignals)
+        connect(this, signal, m_priv, SLOT(publishSnapshotLater()));
+
     QDBusServiceWatcher* watcher = new QDBusServiceWatcher(CONNMAN_SERVICE, QDBusConnection::systemBus(),
             QDBusServiceWatcher::WatchForRegistration |
             QDBusServiceWatcher::WatchForUnregistration, this);
@@ -803,10 +1327,8 @@ void NetworkManager::disconnectServices()
         emitConnectedEthernetChanged = true;
     }
 
-    if (m_priv->m_proxy) {
-        disconnect(m_priv->m_proxy, SIGNAL(ServicesChanged(ConnmanObjectList,QList<QDBusObjectPath>)),
-                   m_priv, SLOT(updateServices(ConnmanObjectList,QList<QDBusObjectPath>)));
-    }
+    m_priv->watchServiceList(false);
+    m_priv->stopDecoder();
 
     for (NetworkService *service : m_priv->m_servicesCache) {
         service->deleteLater();
@@ -814,6 +1336,10 @@ void NetworkManager::disconnectServices()
 
     m_priv->m_servicesCache.clear();
     m_priv->m_servicesCacheHasUpdates = false;
+    m_priv->m_serviceRecords.clear();
+    m_priv->m_listedServicesOrder.clear();
+    m_priv->m_demotedServices.clear();
+    m_priv->watchServices(false);
 
     // Clear all lists before emitting the signals
 
@@ -906,9 +1432,10 @@ void NetworkManager::setupTechnologies()
 
 void NetworkManager::setupServices()
 {
-    if (m_priv->m_proxy) {
-        connect(m_priv->m_proxy, SIGNAL(ServicesChanged(ConnmanObjectList,QList<QDBusObjectPath>)),
-                m_priv, SLOT(updateServices(ConnmanObjectList,QList<QDBusObjectPath>)));
+    if (m_priv->m_proxy && m_priv->m_backgroundDecoding) {
+        m_priv->startDecoder();
+    } else if (m_priv->m_proxy) {
+        m_priv->watchServiceList(true);
 
         QDBusPendingCallWatcher *pendingCall
                 = new QDBusPendingCallWatcher(m_priv->m_proxy->GetServices(), m_priv->m_proxy);
@@ -972,7 +1499,7 @@ NetworkService* NetworkManager::selectDefaultRoute(const QString &path)
         }
     } else {
        if (m_priv->m_servicesOrder.contains(path)) {
-            newDefaultRoute = m_priv->m_servicesCache.value(path, nullptr);
+            newDefaultRoute = m_priv->service(path);
             if (newDefaultRoute && newDefaultRoute->connected()) {
                 qCDebug(lcConnman) << "Selected service" << newDefaultRoute->name() << "path" << path;
                 return newDefaultRoute;
@@ -1053,6 +1580,7 @@ void NetworkManager::technologyAdded(const QDBusObjectPath &technology,
 {
     NetworkTechnology *tech = new NetworkTechnology(technology.path(), properties, this);
 
+    m_priv->watchTechnology(tech);
     m_priv->m_technologiesCache.insert(tech->type(), tech);
     Q_EMIT technologiesChanged();
 }
@@ -1099,6 +1627,7 @@ void NetworkManager::getTechnologiesFinished(QDBusPendingCallWatcher *watcher)
     for (const ConnmanObject &object : reply.value()) {
         NetworkTechnology *tech = new NetworkTechnology(object.objpath.path(),
                                                         object.properties, this);
+        m_priv->watchTechnology(tech);
         m_priv->m_technologiesCache.insert(tech->type(), tech);
     }
 
@@ -1115,13 +1644,14 @@ void NetworkManager::getTechnologiesFinished(QDBusPendingCallWatcher *watcher)
 
 void NetworkManager::getServicesFinished(QDBusPendingCallWatcher *watcher)
 {
-    QDBusPendingReply<ConnmanObjectList> reply = *watcher;
-    ConnmanObjectList services;
+    QDBusPendingReply<> reply = *watcher;
+    QVector<NetworkServiceRecord> services;
     watcher->deleteLater();
     if (reply.isError()) {
         qWarning() << reply.error();
     } else {
-        services = reply.value();
+        services = NetworkServiceRecord::decodeList(reply.argumentAt(0).value<QDBusArgument>(),
+                                                    m_priv->m_serviceRecords);
     }
 
     qCDebug(lcConnman) << "Updating services as GetServices returns";
@@ -1208,9 +1738,8 @@ QVector<NetworkService*> NetworkManager::selectServices(const QStringList &list,
 {
     QVector<NetworkService *> services;
     for (const QString &path : list) {
-        NetworkService *service = m_priv->m_servicesCache.value(path);
-        if (selector(service)) {
-            services.append(m_priv->m_servicesCache.value(path));
+        if (selector(m_priv, path)) {
+            services.append(m_priv->service(path));
         }
     }
     return services;
@@ -1219,18 +1748,11 @@ QVector<NetworkService*> NetworkManager::selectServices(const QStringList &list,
 QVector<NetworkService*> NetworkManager::selectServices(const QStringList &list,
     const QString &tech) const
 {
+    const QStringList selected(selectServiceList(list, tech));
+
     QVector<NetworkService*> services;
-    if (tech.isEmpty()) {
-        for (const QString &path : list) {
-            services.append(m_priv->m_servicesCache.value(path));
-        }
-    } else {
-        for (const QString &path : list) {
-            NetworkService *service = m_priv->m_servicesCache.value(path);
-            if (service->type() == tech) {
-                services.append(service);
-            }
-        }
+    for (const QString &path : selected) {
+        services.append(m_priv->service(path));
     }
     return services;
 }
@@ -1240,7 +1762,7 @@ QStringList NetworkManager::selectServiceList(const QStringList &list,
 {
     QStringList services;
     for (const QString &path : list) {
-        if (selector(m_priv->m_servicesCache.value(path))) {
+        if (selector(m_priv, path)) {
             services.append(path);
         }
     }
@@ -1254,8 +1776,7 @@ QStringList NetworkManager::selectServiceList(const QStringList &list, const QSt
     } else {
         QStringList services;
         for (const QString &path : list) {
-            NetworkService *service = m_priv->m_servicesCache.value(path);
-            if (service->type() == tech) {
+            if (m_priv->serviceType(path) == tech) {
                 services.append(path);
             }
         }
@@ -1492,6 +2013,8 @@ void NetworkManager::propertyChanged(const QString &name, const QVariant &value)
         NetworkService* newDefaultRoute(NULL);
         QString path = value.toString();
 
+        m_priv->m_propertiesCache[name] = path;
+
         /* No change in default route */
         if (m_priv->m_defaultRoute && m_priv->m_defaultRoute->path() == path)
             return;
@@ -1640,11 +2163,11 @@ void NetworkManager::resetCountersForType(const QString &type)
 
 QString NetworkManager::technologyPathForService(const QString &servicePath)
 {
-    NetworkService *service = m_priv->m_servicesCache.value(servicePath, nullptr);
-    if (!service)
+    const QString type(m_priv->serviceType(servicePath));
+    if (type.isEmpty())
         return QString();
 
-    return technologyPathForType(service->type());
+    return technologyPathForType(type);
 }
 
 QString NetworkManager::technologyPathForType(const QString &techType)
@@ -1699,4 +2222,63 @@ QVariantList NetworkManager::getTetheringClients() const
     return QVariantList();
 }
 
+NetworkServiceFilter::List NetworkManager::serviceFilters() const
+{
+    return m_priv->m_serviceFilters;
+}
+
+void NetworkManager::setServiceFilters(const NetworkServiceFilter::List &filters)
+{
+    m_priv->m_serviceFilters = filters;
+
+    if (m_priv->m_servicesAvailable) {
+        // Re-run the pipeline on what ConnMan has reported so far
+        m_priv->refreshServices();
+    }
+}
+
+qint64 NetworkManager::serviceMemoryUsage(const QString &path) const
+{
+    return m_priv->serviceMemoryUsage(path);
+}
+
+qint64 NetworkManager::serviceMemoryUsage() const
+{
+    return m_priv->serviceMemoryUsage();
+}
+
+int NetworkManager::serviceObjectCount() const
+{
+    return m_priv->m_servicesCache.count();
+}
+
+NetworkSnapshot NetworkManager::snapshot() const
+{
+    return m_priv->m_snapshots.current();
+}
+
+bool NetworkManager::backgroundDecoding() const
+{
+    return m_priv->m_backgroundDecoding;
+}
+
+void NetworkManager::setBackgroundDecoding(bool enabled)
+{
+    if (m_priv->m_backgroundDecoding == enabled)
+        return;
+
+    m_priv->m_backgroundDecoding = enabled;
+
+    // Switch over and let the fresh listing reconcile the services
+    if (m_priv->m_proxy) {
+        if (enabled) {
+            m_priv->watchServiceList(false);
+            m_priv->watchServices(false);
+        } else {
+            m_priv->stopDecoder();
+        }
+        setupServices();
+    }
+}
+
 #include "networkmanager.moc"
@@ -13,6 +13,8 @@
 
 #include "networktechnology.h"
 #include "networkservice.h"
+#include "networkservicefilter.h"
+#include "networksnapshot.h"
 #include <QtDBus>
 #include <QSharedPointer>
 
@@ -98,6 +100,10 @@ public:
     // are no longer available.
     Q_INVOKABLE NetworkTechnology* getTechnology(const QString &type) const;
     QVector<NetworkTechnology *> getTechnologies() const;
+    // Service objects are created on demand by the get*Services() calls,
+    // the *List() calls below only consult the service records. A new
+    // object starts with the properties of the record and emits
+    // propertiesReady once it has fetched the rest.
     QVector<NetworkService*> getServices(const QString &tech = QString()) const;
     QVector<NetworkService*> getSavedServices(const QString &tech = QString()) const;
     QVector<NetworkService*> getAvailableServices(const QString &tech = QString()) const;
@@ -150,6 +156,32 @@ public:
 
     QVariantList getTetheringClients() const;
 
+    // Services rejected by the filters never get a NetworkService object
+    // and are left out of all service lists. Setting the filters re-applies
+    // them to the services already reported by ConnMan, and so does a
+    // change to the properties of a service, shortly after it.
+    NetworkServiceFilter::List serviceFilters() const;
+    void setServiceFilters(const NetworkServiceFilter::List &filters);
+
+    // Estimated memory used for tracking the services, in bytes. Services
+    // are listed with their records only and get a NetworkService object
+    // when they are handed out or connect. Objects stay until the service
+    // goes away, callers may keep the pointers.
+    qint64 serviceMemoryUsage(const QString &path) const;
+    qint64 serviceMemoryUsage() const;
+    int serviceObjectCount() const;
+
+    // Latest state published for other threads. May be called from any
+    // thread, the snapshot gets republished shortly after every change.
+    NetworkSnapshot snapshot() const;
+
+    // Decode the service updates (GetServices, ServicesChanged and the
+    // service PropertyChanged signals) on a worker thread and apply them
+    // here in batches. Off by default. NetworkService objects still
+    // decode their own properties on this thread.
+    bool backgroundDecoding() const;
+    void setBackgroundDecoding(bool enabled);
+
 public Q_SLOTS:
     void setOfflineMode(bool offlineMode);
     void registerAgent(const QString &path);
@@ -208,7 +240,11 @@ Q_SIGNALS:
     void connectingWifiChanged();
 
 private:
-    typedef bool (*ServiceSelector)(NetworkService*);
+    class Private;
+    friend class Private;
+    Private *m_priv;
+
+    typedef bool (*ServiceSelector)(const Private *priv, const QString &path);
     void propertyChanged(const QString &name, const QVariant &value);
     void setConnmanAvailable(bool available);
     bool connectToConnman();
@@ -221,11 +257,6 @@ private:
     void updateDefaultRoute();
     void updateTetheringClients();
 
-private:
-    class Private;
-    friend class Private;
-    Private *m_priv;
-
 private Q_SLOTS:
     void onConnmanRegistered();
     void onConnmanUnregistered();
@@ -0,0 +1,160 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "networkservicedecoder.h"
+#include "commondbustypes.h"
+#include "logging.h"
+
+#include <QDBusConnection>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+
+static const QString ManagerInterface("net.connman.Manager");
+static const QString ServiceInterface("net.connman.Service");
+
+// Property changes arrive in bursts during scans, they are collected for
+// this long and delivered as one change set
+static const int FlushDelay = 50; // ms
+
+NetworkServiceDecoder::NetworkServiceDecoder(uint generation)
+    : m_generation(generation)
+    , m_subscribed(false)
+    , m_flushTimer(this)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FlushDelay);
+    connect(&m_flushTimer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+void NetworkServiceDecoder::start()
+{
+    subscribe(true);
+
+    QDBusMessage message = QDBusMessage::createMethodCall(CONNMAN_SERVICE, "/", ManagerInterface,
+                                                          "GetServices");
+    QDBusPendingCallWatcher *watcher
+            = new QDBusPendingCallWatcher(QDBusConnection::systemBus().asyncCall(message), this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(onGetServicesFinished(QDBusPendingCallWatcher*)));
+}
+
+void NetworkServiceDecoder::stop()
+{
+    subscribe(false);
+    m_flushTimer.stop();
+    m_records.clear();
+    m_changed.clear();
+}
+
+void NetworkServiceDecoder::subscribe(bool subscribe)
+{
+    if (m_subscribed == subscribe)
+        return;
+
+    QDBusConnection bus(QDBusConnection::systemBus());
+    if (subscribe) {
+        bus.connect(CONNMAN_SERVICE, "/", ManagerInterface, "ServicesChanged",
+                    this, SLOT(onServicesChanged(QDBusMessage)));
+        bus.connect(CONNMAN_SERVICE, QString(), ServiceInterface, "PropertyChanged",
+                    this, SLOT(onPropertyChanged(QString,QDBusVariant,QDBusMessage)));
+    } else {
+        bus.disconnect(CONNMAN_SERVICE, "/", ManagerInterface, "ServicesChanged",
+                       this, SLOT(onServicesChanged(QDBusMessage)));
+        bus.disconnect(CONNMAN_SERVICE, QString(), ServiceInterface, "PropertyChanged",
+                       this, SLOT(onPropertyChanged(QString,QDBusVariant,QDBusMessage)));
+    }
+    m_subscribed = subscribe;
+}
+
+void NetworkServiceDecoder::onGetServicesFinished(QDBusPendingCallWatcher *watcher)
+{
+    QDBusPendingReply<> reply = *watcher;
+    watcher->deleteLater();
+
+    if (!m_subscribed)
+        return;
+
+    if (reply.isError()) {
+        qWarning() << reply.error();
+        postListing(QVector<NetworkServiceRecord>(), QList<QDBusObjectPath>());
+    } else {
+        postListing(NetworkServiceRecord::decodeList(reply.argumentAt(0).value<QDBusArgument>(), m_records),
+                    QList<QDBusObjectPath>());
+    }
+}
+
+void NetworkServiceDecoder::onServicesChanged(const QDBusMessage &message)
+{
+    const QList<QVariant> args(message.arguments());
+    if (args.count() < 2) {
+        qWarning() << "Invalid ServicesChanged signal";
+        return;
+    }
+
+    postListing(NetworkServiceRecord::decodeList(args.at(0).value<QDBusArgument>(), m_records),
+                qdbus_cast<QList<QDBusObjectPath> >(args.at(1)));
+}
+
+void NetworkServiceDecoder::onPropertyChanged(const QString &name, const QDBusVariant &value,
+                                              const QDBusMessage &message)
+{
+    const QString path(message.path());
+    QHash<QString, NetworkServiceRecord>::Iterator it = m_records.find(path);
+    if (it == m_records.end())
+        return;
+
+    NetworkServiceRecord record(it.value());
+    if (!record.update(name, value.variant()) || record == it.value())
+        return;
+
+    it.value() = record;
+    m_changed.insert(path);
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void NetworkServiceDecoder::flush()
+{
+    m_flushTimer.stop();
+    if (m_changed.isEmpty())
+        return;
+
+    NetworkServiceChanges *changes = new NetworkServiceChanges;
+    changes->generation = m_generation;
+    changes->services.reserve(m_changed.count());
+    for (const QString &path : m_changed) {
+        QHash<QString, NetworkServiceRecord>::ConstIterator it = m_records.constFind(path);
+        if (it != m_records.constEnd())
+            changes->services.append(it.value());
+    }
+    m_changed.clear();
+
+    emit changesReady(NetworkServiceChanges::Ref(changes));
+}
+
+void NetworkServiceDecoder::postListing(const QVector<NetworkServiceRecord> &services,
+                                        const QList<QDBusObjectPath> &removed)
+{
+    // Keep the order, the pending property changes go first
+    flush();
+
+    QHash<QString, NetworkServiceRecord> records;
+    records.reserve(services.count());
+    for (const NetworkServiceRecord &record : services)
+        records.insert(record.path, record);
+    m_records.swap(records);
+
+    NetworkServiceChanges *changes = new NetworkServiceChanges;
+    changes->generation = m_generation;
+    changes->listing = true;
+    changes->services = services;
+    changes->removed = removed;
+
+    qCDebug(lcConnman) << "Decoded" << services.count() << "services," << removed.count() << "removed";
+    emit changesReady(NetworkServiceChanges::Ref(changes));
+}
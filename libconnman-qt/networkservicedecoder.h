@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef NETWORKSERVICEDECODER_H
+#define NETWORKSERVICEDECODER_H
+
+#include "networkservicerecord.h"
+
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QTimer>
+
+class QDBusPendingCallWatcher;
+
+/*
+ * Immutable result of decoding a batch of service updates.
+ *
+ * A listing carries the records of all services in ConnMan order together
+ * with the removed paths, as reported by GetServices or ServicesChanged.
+ * Otherwise the records are the services whose properties changed since
+ * the previous change set, with only the latest values.
+ */
+struct NetworkServiceChanges
+{
+    typedef QSharedPointer<const NetworkServiceChanges> Ref;
+
+    NetworkServiceChanges() : generation(0), listing(false) {}
+
+    uint generation;
+    bool listing;
+    QVector<NetworkServiceRecord> services;
+    QList<QDBusObjectPath> removed;
+};
+
+Q_DECLARE_METATYPE(NetworkServiceChanges::Ref)
+
+/*
+ * Receives the service related D-Bus traffic of ConnMan on a worker thread
+ * and decodes it there. Keeps its own copy of the records to diff the
+ * property changes against, and delivers the results as change sets.
+ */
+class NetworkServiceDecoder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NetworkServiceDecoder(uint generation);
+
+public Q_SLOTS:
+    // Subscribes to the signals and fetches the current services
+    void start();
+    void stop();
+
+Q_SIGNALS:
+    void changesReady(const NetworkServiceChanges::Ref &changes);
+
+private Q_SLOTS:
+    void onServicesChanged(const QDBusMessage &message);
+    void onPropertyChanged(const QString &name, const QDBusVariant &value, const QDBusMessage &message);
+    void onGetServicesFinished(QDBusPendingCallWatcher *watcher);
+    void flush();
+
+private:
+    void subscribe(bool subscribe);
+    void postListing(const QVector<NetworkServiceRecord> &services, const QList<QDBusObjectPath> &removed);
+
+private:
+    uint m_generation;
+    bool m_subscribed;
+    QTimer m_flushTimer;
+    QHash<QString, NetworkServiceRecord> m_records;
+    QSet<QString> m_changed;
+};
+
+#endif // NETWORKSERVICEDECODER_H
@@ -0,0 +1,189 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "networkservicefilter.h"
+
+#include <QHash>
+#include <algorithm>
+#include <functional>
+
+static const QString WifiType("wifi");
+
+// ==========================================================================
+// Built-in filters
+// ==========================================================================
+
+namespace {
+
+class UnreachableWifiFilter : public NetworkServiceFilter
+{
+public:
+    Result check(const NetworkServiceRecord &service) override
+    {
+        // Ignore all WiFi with a zeroed/unknown BSSIDs to reduce list size
+        // in crowded areas. These are most likely weak and really unreachable
+        // but ConnMan maintains them if they come within reach and then they
+        // have a valid BSSID. WiFi services with an empty BSSID are saved ones
+        // that are not in the range.
+        if (service.type == WifiType && service.bssid == QLatin1String("00:00:00:00:00:00"))
+            return Drop;
+        return Pass;
+    }
+};
+
+class MinimumStrengthFilter : public NetworkServiceFilter
+{
+public:
+    MinimumStrengthFilter(uint strength) : m_strength(strength) {}
+
+    Result check(const NetworkServiceRecord &service) override
+    {
+        // Services without signal strength (ethernet, vpn...) are not affected
+        if (service.hasStrength() && service.strength < m_strength)
+            return Drop;
+        return Pass;
+    }
+
+private:
+    uint m_strength;
+};
+
+class StrongestPerTechnologyFilter : public NetworkServiceFilter
+{
+public:
+    StrongestPerTechnologyFilter(int count) : m_count(qMax(count, 0)) {}
+
+    void prepare(const QVector<NetworkServiceRecord> &services) override
+    {
+        QHash<QString, QVector<uint> > strengths;
+        for (const NetworkServiceRecord &service : services) {
+            if (service.hasStrength())
+                strengths[service.type].append(service.strength);
+        }
+
+        m_limits.clear();
+        for (QHash<QString, QVector<uint> >::Iterator it = strengths.begin(); it != strengths.end(); ++it) {
+            QVector<uint> &values = it.value();
+            if (values.count() <= m_count)
+                continue;
+
+            // Everything stronger than the threshold passes, services at the
+            // threshold pass until the tie allowance runs out
+            std::nth_element(values.begin(), values.begin() + m_count, values.end(), std::greater<uint>());
+            const uint threshold = values.at(m_count);
+            int above = 0;
+            for (uint value : values) {
+                if (value > threshold)
+                    above++;
+            }
+            m_limits.insert(it.key(), Limit{ threshold, m_count - above });
+        }
+    }
+
+    Result check(const NetworkServiceRecord &service) override
+    {
+        if (!service.hasStrength())
+            return Pass;
+
+        QHash<QString, Limit>::Iterator limit = m_limits.find(service.type);
+        if (limit == m_limits.end())
+            return Pass;
+
+        if (service.strength > limit->threshold)
+            return Pass;
+        if (service.strength == limit->threshold && limit->ties > 0) {
+            limit->ties--;
+            return Pass;
+        }
+        return Drop;
+    }
+
+private:
+    struct Limit {
+        uint threshold;
+        int ties;
+    };
+
+    int m_count;
+    QHash<QString, Limit> m_limits;
+};
+
+class ExcludeSecurityFilter : public NetworkServiceFilter
+{
+public:
+    ExcludeSecurityFilter(const QStringList &security)
+    {
+        // Compile the names into the record's security bits
+        NetworkServiceRecord record;
+        record.update(QStringLiteral("Security"), security);
+        m_security = record.security;
+    }
+
+    Result check(const NetworkServiceRecord &service) override
+    {
+        return (service.security & m_security) ? Drop : Pass;
+    }
+
+private:
+    quint8 m_security;
+};
+
+class KeepSavedOrConnectedFilter : public NetworkServiceFilter
+{
+public:
+    Result check(const NetworkServiceRecord &service) override
+    {
+        if (service.saved() || service.favorite() || service.connected())
+            return Keep;
+        return Pass;
+    }
+};
+
+} // namespace
+
+// ==========================================================================
+// NetworkServiceFilter
+// ==========================================================================
+
+NetworkServiceFilter::~NetworkServiceFilter()
+{
+}
+
+void NetworkServiceFilter::prepare(const QVector<NetworkServiceRecord> &)
+{
+}
+
+NetworkServiceFilter::Ref NetworkServiceFilter::unreachableWifi()
+{
+    return Ref(new UnreachableWifiFilter);
+}
+
+NetworkServiceFilter::Ref NetworkServiceFilter::minimumStrength(uint strength)
+{
+    return Ref(new MinimumStrengthFilter(strength));
+}
+
+NetworkServiceFilter::Ref NetworkServiceFilter::strongestPerTechnology(int count)
+{
+    return Ref(new StrongestPerTechnologyFilter(count));
+}
+
+NetworkServiceFilter::Ref NetworkServiceFilter::excludeSecurity(const QStringList &security)
+{
+    return Ref(new ExcludeSecurityFilter(security));
+}
+
+NetworkServiceFilter::Ref NetworkServiceFilter::keepSavedOrConnected()
+{
+    return Ref(new KeepSavedOrConnectedFilter);
+}
+
+NetworkServiceFilter::List NetworkServiceFilter::defaultFilters()
+{
+    return List() << unreachableWifi();
+}
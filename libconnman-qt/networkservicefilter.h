@@ -0,0 +1,63 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef NETWORKSERVICEFILTER_H
+#define NETWORKSERVICEFILTER_H
+
+#include "networkservicerecord.h"
+
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+/*
+ * A stage of the service filter pipeline of NetworkManager.
+ *
+ * Filters are evaluated on the records of the services reported by ConnMan
+ * (GetServices and ServicesChanged) before NetworkService objects are
+ * created for them. Services rejected by the pipeline are not exposed
+ * through NetworkManager until a later update lets them through.
+ *
+ * For each service the filters are consulted in order. The first filter
+ * returning Keep or Drop decides, a service that passes all filters is
+ * accepted. The current default route is never dropped.
+ */
+class NetworkServiceFilter
+{
+public:
+    typedef QSharedPointer<NetworkServiceFilter> Ref;
+    typedef QList<Ref> List;
+
+    enum Result {
+        Pass,   // No decision, continue with the next filter
+        Keep,   // Accept the service, skip the remaining filters
+        Drop    // Reject the service, skip the remaining filters
+    };
+
+    virtual ~NetworkServiceFilter();
+
+    // Called once per update with the records of all listed services,
+    // in the order reported by ConnMan, before check() gets called for them
+    virtual void prepare(const QVector<NetworkServiceRecord> &services);
+    virtual Result check(const NetworkServiceRecord &service) = 0;
+
+    // Drops WiFi services with a zeroed BSSID (the default pipeline)
+    static Ref unreachableWifi();
+    // Drops services whose signal strength is below the given value
+    static Ref minimumStrength(uint strength);
+    // Drops all but the given number of strongest services per technology
+    static Ref strongestPerTechnology(int count);
+    // Drops services using any of the given security types ("none", "wep"...)
+    static Ref excludeSecurity(const QStringList &security);
+    // Keeps saved and connected services regardless of the following filters
+    static Ref keepSavedOrConnected();
+
+    static List defaultFilters();
+};
+
+#endif // NETWORKSERVICEFILTER_H
@@ -0,0 +1,195 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "networkservicerecord.h"
+
+#include <QDBusObjectPath>
+#include <QDBusVariant>
+
+#define COUNT(a) ((uint)(sizeof(a)/sizeof(a[0])))
+
+static const QString NameProperty("Name");
+static const QString TypeProperty("Type");
+static const QString StateProperty("State");
+static const QString StrengthProperty("Strength");
+static const QString SecurityProperty("Security");
+static const QString BSSIDProperty("BSSID");
+static const QString SavedProperty("Saved");
+static const QString AvailableProperty("Available");
+static const QString FavoriteProperty("Favorite");
+static const QString HiddenProperty("Hidden");
+
+// The order must match NetworkService::ServiceState
+static const char *const StateName[] = {
+    "", "idle", "failure", "association", "configuration", "ready", "disconnect", "online"
+};
+
+// The order must match the Security bits
+static const char *const SecurityName[] = {
+    "none", "wep", "psk", "ieee8021x", "psksae", "sae", "wps", "wps_advertising"
+};
+
+NetworkServiceRecord::NetworkServiceRecord()
+    : state(NetworkService::UnknownState)
+    , strength(0)
+    , security(0)
+    , flags(Available)
+{
+}
+
+NetworkServiceRecord::NetworkServiceRecord(const QString &path)
+    : path(path)
+    , state(NetworkService::UnknownState)
+    , strength(0)
+    , security(0)
+    , flags(Available)
+{
+}
+
+static inline void setFlag(quint8 *flags, quint8 flag, bool on)
+{
+    if (on) {
+        *flags |= flag;
+    } else {
+        *flags &= ~flag;
+    }
+}
+
+bool NetworkServiceRecord::update(const QString &name, const QVariant &value)
+{
+    if (name == StateProperty) {
+        const QString str(value.toString());
+        state = NetworkService::UnknownState;
+        for (uint i = 1; i < COUNT(StateName); i++) {
+            if (str == QLatin1String(StateName[i])) {
+                state = i;
+                break;
+            }
+        }
+    } else if (name == StrengthProperty) {
+        strength = value.toUInt();
+        flags |= HasStrength;
+    } else if (name == NameProperty) {
+        this->name = value.toString();
+    } else if (name == TypeProperty) {
+        type = value.toString();
+    } else if (name == SecurityProperty) {
+        const QStringList list(value.toStringList());
+        security = 0;
+        for (uint i = 0; i < COUNT(SecurityName); i++) {
+            if (list.contains(QLatin1String(SecurityName[i])))
+                security |= (1 << i);
+        }
+    } else if (name == BSSIDProperty) {
+        bssid = value.toString();
+    } else if (name == SavedProperty) {
+        setFlag(&flags, Saved, value.toBool());
+    } else if (name == AvailableProperty) {
+        setFlag(&flags, Available, value.toBool());
+    } else if (name == FavoriteProperty) {
+        setFlag(&flags, Favorite, value.toBool());
+    } else if (name == HiddenProperty) {
+        setFlag(&flags, Hidden, value.toBool());
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void NetworkServiceRecord::update(const QVariantMap &properties)
+{
+    for (QVariantMap::ConstIterator it = properties.constBegin(); it != properties.constEnd(); ++it)
+        update(it.key(), it.value());
+}
+
+bool NetworkServiceRecord::operator==(const NetworkServiceRecord &other) const
+{
+    return state == other.state
+            && strength == other.strength
+            && security == other.security
+            && flags == other.flags
+            && path == other.path
+            && name == other.name
+            && type == other.type
+            && bssid == other.bssid;
+}
+
+QStringList NetworkServiceRecord::securityList() const
+{
+    QStringList list;
+    for (uint i = 0; i < COUNT(SecurityName); i++) {
+        if (security & (1 << i))
+            list.append(QLatin1String(SecurityName[i]));
+    }
+    return list;
+}
+
+QVariantMap NetworkServiceRecord::toMap() const
+{
+    QVariantMap map;
+
+    if (!name.isEmpty())
+        map.insert(NameProperty, name);
+    if (!type.isEmpty())
+        map.insert(TypeProperty, type);
+    if (!bssid.isEmpty())
+        map.insert(BSSIDProperty, bssid);
+    if (state != NetworkService::UnknownState)
+        map.insert(StateProperty, QString(QLatin1String(StateName[state])));
+    if (flags & HasStrength)
+        map.insert(StrengthProperty, (uint)strength);
+    map.insert(SecurityProperty, securityList());
+    map.insert(SavedProperty, saved());
+    map.insert(AvailableProperty, available());
+    map.insert(FavoriteProperty, favorite());
+    map.insert(HiddenProperty, (bool)(flags & Hidden));
+    return map;
+}
+
+qint64 NetworkServiceRecord::memoryUsage() const
+{
+    return sizeof(NetworkServiceRecord)
+            + (path.size() + name.size() + type.size() + bssid.size()) * sizeof(QChar);
+}
+
+QVector<NetworkServiceRecord> NetworkServiceRecord::decodeList(const QDBusArgument &argument,
+        const QHash<QString, NetworkServiceRecord> &current)
+{
+    QVector<NetworkServiceRecord> records;
+
+    argument.beginArray();
+    while (!argument.atEnd()) {
+        QDBusObjectPath objectPath;
+
+        argument.beginStructure();
+        argument >> objectPath;
+
+        const QString path(objectPath.path());
+        QHash<QString, NetworkServiceRecord>::ConstIterator it = current.constFind(path);
+        records.append(it != current.constEnd() ? it.value() : NetworkServiceRecord(path));
+        NetworkServiceRecord &record = records.last();
+
+        // Values of the skipped properties stay unparsed, dictionaries
+        // like IPv4 or Proxy are never walked
+        argument.beginMap();
+        while (!argument.atEnd()) {
+            QString name;
+            QDBusVariant value;
+
+            argument.beginMapEntry();
+            argument >> name >> value;
+            argument.endMapEntry();
+            record.update(name, value.variant());
+        }
+        argument.endMap();
+        argument.endStructure();
+    }
+    argument.endArray();
+
+    return records;
+}
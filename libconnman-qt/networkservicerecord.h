@@ -0,0 +1,93 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef NETWORKSERVICERECORD_H
+#define NETWORKSERVICERECORD_H
+
+#include "networkservice.h"
+
+#include <QDBusArgument>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <QVector>
+
+/*
+ * Compact copy of the service properties NetworkManager needs for listing,
+ * filtering and selecting services. NetworkManager keeps one of these for
+ * every service reported by ConnMan and creates NetworkService objects only
+ * when they are asked for.
+ */
+struct NetworkServiceRecord
+{
+    enum Flag {
+        Saved       = 0x01,
+        Available   = 0x02,
+        Favorite    = 0x04,
+        Hidden      = 0x08,
+        HasStrength = 0x10
+    };
+
+    enum Security {
+        SecurityNone            = 0x01,
+        SecurityWEP             = 0x02,
+        SecurityPSK             = 0x04,
+        SecurityIEEE8021x       = 0x08,
+        SecurityPSKSAE          = 0x10,
+        SecuritySAE             = 0x20,
+        SecurityWPS             = 0x40,
+        SecurityWPSAdvertising  = 0x80
+    };
+
+    NetworkServiceRecord();
+    explicit NetworkServiceRecord(const QString &path);
+
+    // Returns false for properties not kept in the record
+    bool update(const QString &name, const QVariant &value);
+    void update(const QVariantMap &properties);
+
+    bool operator==(const NetworkServiceRecord &other) const;
+    bool operator!=(const NetworkServiceRecord &other) const
+        { return !(*this == other); }
+
+    QVariantMap toMap() const;
+    qint64 memoryUsage() const;
+
+    // Decodes a list of services, a(oa{sv}) as in the GetServices reply
+    // and ServicesChanged, in a single pass over the argument. Each record
+    // starts from the one in current (if any) and gets the reported
+    // properties applied, properties not kept in the record are skipped.
+    static QVector<NetworkServiceRecord> decodeList(const QDBusArgument &argument,
+            const QHash<QString, NetworkServiceRecord> &current = QHash<QString, NetworkServiceRecord>());
+
+    NetworkService::ServiceState serviceState() const
+        { return (NetworkService::ServiceState)state; }
+    bool connected() const
+        { return state == NetworkService::ReadyState || state == NetworkService::OnlineState; }
+    bool connecting() const
+        { return state == NetworkService::AssociationState || state == NetworkService::ConfigurationState; }
+    bool saved() const { return flags & Saved; }
+    bool available() const { return flags & Available; }
+    bool favorite() const { return flags & Favorite; }
+    bool hasStrength() const { return flags & HasStrength; }
+    QStringList securityList() const;
+
+    QString path;
+    QString name;
+    QString type;
+    QString bssid;
+    quint8 state;
+    quint8 strength;
+    quint8 security;
+    quint8 flags;
+};
+
+Q_DECLARE_TYPEINFO(NetworkServiceRecord, Q_MOVABLE_TYPE);
+
+#endif // NETWORKSERVICERECORD_H
@@ -9,20 +9,43 @@
 
 #include "networksession.h"
 #include "sessionagent.h"
+#include "sessionpool.h"
+
+// Reported by ConnMan for the session, not requested by the user
+static const struct {
+    SessionSettings::Field field;
+    const char *key;
+    bool map;
+} ReportedFields[] = {
+    { SessionSettings::State, "State", false },
+    { SessionSettings::Name, "Name", false },
+    { SessionSettings::Bearer, "Bearer", false },
+    { SessionSettings::Interface, "Interface", false },
+    { SessionSettings::IPv4, "IPv4", true },
+    { SessionSettings::IPv6, "IPv6", true },
+};
 
 class NetworkSessionPrivate
 {
 public:
     NetworkSessionPrivate();
 
+    QSharedPointer<SessionPool> m_pool;
     SessionAgent *m_sessionAgent;
-    QVariantMap settingsMap;
+    SessionSettings settings;
+    // The settings asked for with the setters
+    QVariantMap requestedSettings;
     QString m_path;
+    bool m_connectRequested;
+    bool m_changePending;
 };
 
 NetworkSessionPrivate::NetworkSessionPrivate()
-    : m_sessionAgent(0)
+    : m_pool(SessionPool::sharedInstance())
+    , m_sessionAgent(0)
     , m_path("/ConnmanQmlSessionAgent")
+    , m_connectRequested(false)
+    , m_changePending(false)
 {
 }
 
@@ -35,110 +58,213 @@ NetworkSession::NetworkSession(QObject *parent)
 
 NetworkSession::~NetworkSession()
 {
+    if (d_ptr->m_sessionAgent) {
+        if (d_ptr->m_connectRequested)
+            d_ptr->m_pool->requestDisconnect(d_ptr->m_sessionAgent);
+        d_ptr->m_pool->release(d_ptr->m_sessionAgent);
+    }
+
+    delete d_ptr;
+    d_ptr = nullptr;
 }
 
+/*
+ * Sessions come from the pool, shared with the other NetworkSession
+ * instances of the same path and settings.
+ */
 void NetworkSession::createSession()
 {
     if (d_ptr->m_path.isEmpty())
         return;
 
-    delete d_ptr->m_sessionAgent;
-    d_ptr->m_sessionAgent = new SessionAgent(d_ptr->m_path, this);
-    connect(d_ptr->m_sessionAgent, SIGNAL(settingsUpdated(QVariantMap)),
-            this, SLOT(sessionSettingsUpdated(QVariantMap)));
+    // A new session starts from the defaults of ConnMan, unconnected
+    if (d_ptr->m_sessionAgent && d_ptr->m_connectRequested)
+        d_ptr->m_pool->requestDisconnect(d_ptr->m_sessionAgent);
+    d_ptr->m_connectRequested = false;
+    d_ptr->requestedSettings.clear();
+    d_ptr->settings.clear();
+
+    setSessionAgent(d_ptr->m_pool->acquire(d_ptr->m_path, QVariantMap()));
+}
+
+void NetworkSession::setSessionAgent(SessionAgent *agent)
+{
+    SessionAgent *previous = d_ptr->m_sessionAgent;
+    if (agent == previous)
+        return;
+
+    d_ptr->m_sessionAgent = agent;
+    connect(agent, &SessionAgent::settingsDecoded, this, &NetworkSession::applySettings);
+
+    if (previous) {
+        previous->disconnect(this);
+        if (d_ptr->m_connectRequested) {
+            d_ptr->m_pool->requestConnect(agent);
+            d_ptr->m_pool->requestDisconnect(previous);
+        }
+        d_ptr->m_pool->release(previous);
+    }
+
+    // A shared session doesn't send its settings again. What the previous
+    // session reported and the new one hasn't yet doesn't apply any more.
+    SessionSettings settings(agent->settings());
+    for (const auto &reported : ReportedFields) {
+        if (d_ptr->settings.fields.testFlag(reported.field) && !settings.fields.testFlag(reported.field)) {
+            settings.fields |= reported.field;
+            settings.values.insert(QString::fromLatin1(reported.key),
+                                   reported.map ? QVariant(QVariantMap()) : QVariant(QString()));
+        }
+    }
+    if (settings.fields)
+        applySettings(settings);
+}
+
+// Setting the bearers and the connection type together moves sessions once
+void NetworkSession::changeSettingsLater()
+{
+    if (!d_ptr->m_changePending) {
+        d_ptr->m_changePending = true;
+        QMetaObject::invokeMethod(this, "changeSettings", Qt::QueuedConnection);
+    }
+}
+
+void NetworkSession::changeSettings()
+{
+    if (!d_ptr->m_changePending || !d_ptr->m_sessionAgent)
+        return;
+
+    d_ptr->m_changePending = false;
+    setSessionAgent(d_ptr->m_pool->change(d_ptr->m_sessionAgent, d_ptr->m_path,
+                                          d_ptr->requestedSettings));
 }
 
 QString NetworkSession::state() const
 {
-    return d_ptr->settingsMap.value("State").toString();
+    return d_ptr->settings.state;
 }
 
 QString NetworkSession::name() const
 {
-    return d_ptr->settingsMap.value("Name").toString();
+    return d_ptr->settings.name;
 }
 
 QString NetworkSession::bearer() const
 {
-    return d_ptr->settingsMap.value("Bearer").toString();
+    return d_ptr->settings.bearer;
 }
 
 QString NetworkSession::sessionInterface() const
 {
-    return d_ptr->settingsMap.value("Interface").toString();
+    return d_ptr->settings.sessionInterface;
 }
 
 QVariantMap NetworkSession::ipv4() const
 {
-    return qdbus_cast<QVariantMap>(d_ptr->settingsMap.value("IPv4"));
+    return d_ptr->settings.ipv4;
 }
 
 QVariantMap NetworkSession::ipv6() const
 {
-    return qdbus_cast<QVariantMap>(d_ptr->settingsMap.value("IPv6"));
+    return d_ptr->settings.ipv6;
 }
 
 QStringList NetworkSession::allowedBearers() const
 {
-    return d_ptr->settingsMap.value("AllowedBearers").toStringList();
+    return d_ptr->settings.allowedBearers;
 }
 
 QString NetworkSession::connectionType() const
 {
-    return d_ptr->settingsMap.value("ConnectionType").toString();
+    return d_ptr->settings.connectionType;
 }
 
 void NetworkSession::setAllowedBearers(const QStringList &bearers)
 {
-    d_ptr->settingsMap.insert("AllowedBearers", QVariant::fromValue(bearers));
-    d_ptr->m_sessionAgent->setAllowedBearers(bearers);
+    d_ptr->requestedSettings.insert("AllowedBearers", QVariant::fromValue(bearers));
+    changeSettingsLater();
+
+    SessionSettings update;
+    update.fields = SessionSettings::AllowedBearers;
+    update.allowedBearers = bearers;
+    update.values.insert("AllowedBearers", QVariant::fromValue(bearers));
+    applySettings(update);
 }
 
 void NetworkSession::setConnectionType(const QString &type)
 {
-    d_ptr->settingsMap.insert("ConnectionType", QVariant::fromValue(type));
-    d_ptr->m_sessionAgent->setConnectionType(type);
+    d_ptr->requestedSettings.insert("ConnectionType", QVariant::fromValue(type));
+    changeSettingsLater();
+
+    SessionSettings update;
+    update.fields = SessionSettings::ConnectionType;
+    update.connectionType = type;
+    update.values.insert("ConnectionType", QVariant::fromValue(type));
+    applySettings(update);
 }
 
 void NetworkSession::requestDestroy()
 {
-    d_ptr->m_sessionAgent->requestDestroy();
+    d_ptr->m_pool->requestDestroy(d_ptr->m_sessionAgent);
 }
 
 void NetworkSession::requestConnect()
 {
-    d_ptr->m_sessionAgent->requestConnect();
+    // Connect with the settings just set
+    changeSettings();
+
+    if (d_ptr->m_connectRequested) {
+        d_ptr->m_sessionAgent->requestConnect();
+    } else {
+        d_ptr->m_connectRequested = true;
+        d_ptr->m_pool->requestConnect(d_ptr->m_sessionAgent);
+    }
 }
 
 void NetworkSession::requestDisconnect()
 {
-    d_ptr->m_sessionAgent->requestDisconnect();
+    if (d_ptr->m_connectRequested) {
+        d_ptr->m_connectRequested = false;
+        d_ptr->m_pool->requestDisconnect(d_ptr->m_sessionAgent);
+    } else if (d_ptr->m_pool->refCount(d_ptr->m_sessionAgent) <= 1) {
+        d_ptr->m_sessionAgent->requestDisconnect();
+    }
 }
 
 void NetworkSession::sessionSettingsUpdated(const QVariantMap &settings)
 {
-    for (const QString &name : settings.keys()) {
-        d_ptr->settingsMap.insert(name, settings[name]);
-
-        if (name == QLatin1String("State")) {
-            Q_EMIT stateChanged(settings[name].toString());
-        } else if (name == QLatin1String("Name")) {
-            Q_EMIT nameChanged(settings[name].toString());
-        } else if (name == QLatin1String("Bearer")) {
-            Q_EMIT bearerChanged(settings[name].toString());
-        } else if (name == QLatin1String("Interface")) {
-            Q_EMIT sessionInterfaceChanged(settings[name].toString());
-        } else if (name == QLatin1String("IPv4")) {
-            Q_EMIT ipv4Changed(ipv4());
-        } else if (name == QLatin1String("IPv6")) {
-            Q_EMIT ipv6Changed(ipv6());
-        } else if (name == QLatin1String("AllowedBearers")) {
-            Q_EMIT allowedBearersChanged(allowedBearers());
-        } else if (name == QLatin1String("ConnectionType")) {
-            Q_EMIT connectionTypeChanged(settings[name].toString());
-        }
-    }
-    Q_EMIT settingsChanged(settings);
+    applySettings(SessionSettings::decode(settings));
+}
+
+// Only what really changed is signaled
+void NetworkSession::applySettings(const SessionSettings &update)
+{
+    const SessionSettings::Fields changed = d_ptr->settings.merge(update);
+    if (!changed)
+        return;
+
+    const SessionSettings &settings = d_ptr->settings;
+    if (changed.testFlag(SessionSettings::State))
+        Q_EMIT stateChanged(settings.state);
+    if (changed.testFlag(SessionSettings::Name))
+        Q_EMIT nameChanged(settings.name);
+    if (changed.testFlag(SessionSettings::Bearer))
+        Q_EMIT bearerChanged(settings.bearer);
+    if (changed.testFlag(SessionSettings::Interface))
+        Q_EMIT sessionInterfaceChanged(settings.sessionInterface);
+    if (changed.testFlag(SessionSettings::IPv4))
+        Q_EMIT ipv4Changed(settings.ipv4);
+    if (changed.testFlag(SessionSettings::IPv6))
+        Q_EMIT ipv6Changed(settings.ipv6);
+    if (changed.testFlag(SessionSettings::AllowedBearers))
+        Q_EMIT allowedBearersChanged(settings.allowedBearers);
+    if (changed.testFlag(SessionSettings::ConnectionType))
+        Q_EMIT connectionTypeChanged(settings.connectionType);
+    Q_EMIT settingsChanged(update.values);
+}
+
+SessionAgent *NetworkSession::sessionAgent() const
+{
+    return d_ptr->m_sessionAgent;
 }
 
 QString NetworkSession::path() const
@@ -19,6 +19,7 @@ namespace Tests {
 }
 
 class SessionAgent;
+struct SessionSettings;
 
 class NetworkSessionPrivate;
 
@@ -77,8 +78,15 @@ public Q_SLOTS:
     void sessionSettingsUpdated(const QVariantMap &settings);
     void setPath(const QString &path);
 
+private Q_SLOTS:
+    void changeSettings();
+
 private:
     void createSession();
+    void setSessionAgent(SessionAgent *agent);
+    void applySettings(const SessionSettings &update);
+    void changeSettingsLater();
+    SessionAgent *sessionAgent() const;
 
     NetworkSessionPrivate *d_ptr;
 };
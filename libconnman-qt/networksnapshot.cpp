@@ -0,0 +1,120 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "networksnapshot.h"
+#include "networksnapshot_p.h"
+
+#include <QThread>
+
+// ==========================================================================
+// NetworkSnapshot
+// ==========================================================================
+
+NetworkSnapshot::NetworkSnapshot()
+    : d(new NetworkSnapshotData)
+{
+}
+
+NetworkSnapshot::NetworkSnapshot(NetworkSnapshotData *data)
+    : d(data)
+{
+}
+
+NetworkSnapshot::NetworkSnapshot(const NetworkSnapshot &other)
+    : d(other.d)
+{
+}
+
+NetworkSnapshot::~NetworkSnapshot()
+{
+}
+
+NetworkSnapshot &NetworkSnapshot::operator=(const NetworkSnapshot &other)
+{
+    d = other.d;
+    return *this;
+}
+
+quint64 NetworkSnapshot::serial() const
+{
+    return d->serial;
+}
+
+bool NetworkSnapshot::isValid() const
+{
+    return d->valid;
+}
+
+QString NetworkSnapshot::state() const
+{
+    return d->state;
+}
+
+bool NetworkSnapshot::offlineMode() const
+{
+    return d->offlineMode;
+}
+
+bool NetworkSnapshot::connected() const
+{
+    return d->connected;
+}
+
+QString NetworkSnapshot::defaultRoute() const
+{
+    return d->defaultRoute;
+}
+
+QVector<NetworkSnapshot::Technology> NetworkSnapshot::technologies() const
+{
+    return d->technologies;
+}
+
+QVector<NetworkServiceRecord> NetworkSnapshot::services() const
+{
+    return d->services;
+}
+
+NetworkServiceRecord NetworkSnapshot::service(const QString &path) const
+{
+    const int index = d->serviceIndex.value(path, -1);
+    return (index >= 0) ? d->services.at(index) : NetworkServiceRecord();
+}
+
+// ==========================================================================
+// NetworkSnapshotPublisher
+// ==========================================================================
+
+NetworkSnapshot NetworkSnapshotPublisher::current() const
+{
+    for (;;) {
+        const int index = m_current.loadAcquire();
+
+        m_readers[index].ref();
+        if (m_current.loadAcquire() == index) {
+            const NetworkSnapshot snapshot(m_slots[index]);
+            m_readers[index].deref();
+            return snapshot;
+        }
+
+        // Published meanwhile, the slot may be getting reused
+        m_readers[index].deref();
+    }
+}
+
+void NetworkSnapshotPublisher::publish(const NetworkSnapshot &snapshot)
+{
+    const int next = 1 - m_current.loadAcquire();
+
+    // Readers only stay for the time it takes to copy a pointer
+    while (m_readers[next].loadAcquire() != 0)
+        QThread::yieldCurrentThread();
+
+    m_slots[next] = snapshot;
+    m_current.fetchAndStoreOrdered(next);
+}
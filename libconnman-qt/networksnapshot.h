@@ -0,0 +1,66 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef NETWORKSNAPSHOT_H
+#define NETWORKSNAPSHOT_H
+
+#include "networkservicerecord.h"
+
+#include <QSharedDataPointer>
+#include <QString>
+#include <QVector>
+
+class NetworkSnapshotData;
+
+/*
+ * Immutable copy of the NetworkManager state, see NetworkManager::snapshot().
+ *
+ * The data is implicitly shared and never modified once published, so
+ * snapshots can be copied and read on any thread without locking. The
+ * services are the ones NetworkManager lists, in the same order.
+ */
+class NetworkSnapshot
+{
+public:
+    struct Technology {
+        QString path;
+        QString name;
+        QString type;
+        bool powered;
+        bool connected;
+    };
+
+    NetworkSnapshot();
+    // Used by NetworkManager, takes ownership of the data
+    explicit NetworkSnapshot(NetworkSnapshotData *data);
+    NetworkSnapshot(const NetworkSnapshot &other);
+    ~NetworkSnapshot();
+    NetworkSnapshot &operator=(const NetworkSnapshot &other);
+
+    // Increases with every published snapshot, zero before the first one
+    quint64 serial() const;
+
+    bool isValid() const;
+    QString state() const;
+    bool offlineMode() const;
+    bool connected() const;
+    // Path of the default route service, empty if there is none
+    QString defaultRoute() const;
+
+    QVector<Technology> technologies() const;
+    QVector<NetworkServiceRecord> services() const;
+    // Returns a record with an empty path for unknown services
+    NetworkServiceRecord service(const QString &path) const;
+
+private:
+    QSharedDataPointer<NetworkSnapshotData> d;
+};
+
+Q_DECLARE_TYPEINFO(NetworkSnapshot::Technology, Q_MOVABLE_TYPE);
+
+#endif // NETWORKSNAPSHOT_H
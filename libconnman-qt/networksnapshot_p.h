@@ -0,0 +1,55 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef NETWORKSNAPSHOT_P_H
+#define NETWORKSNAPSHOT_P_H
+
+#include "networksnapshot.h"
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QSharedData>
+
+class NetworkSnapshotData : public QSharedData
+{
+public:
+    NetworkSnapshotData()
+        : serial(0), valid(false), offlineMode(false), connected(false) {}
+
+    quint64 serial;
+    bool valid;
+    bool offlineMode;
+    bool connected;
+    QString state;
+    QString defaultRoute;
+    QVector<NetworkSnapshot::Technology> technologies;
+    QVector<NetworkServiceRecord> services;
+    QHash<QString, int> serviceIndex;
+};
+
+/*
+ * Hands out the latest snapshot to any thread without locks. There are
+ * two slots, readers announce themselves on the slot they copy from and
+ * the (single) publisher waits for them to leave before reusing a slot.
+ * A reader that races with a publish simply tries again.
+ */
+class NetworkSnapshotPublisher
+{
+public:
+    NetworkSnapshotPublisher() : m_current(0) {}
+
+    NetworkSnapshot current() const;
+    void publish(const NetworkSnapshot &snapshot);
+
+private:
+    NetworkSnapshot m_slots[2];
+    mutable QAtomicInt m_readers[2];
+    QAtomicInt m_current;
+};
+
+#endif // NETWORKSNAPSHOT_P_H
@@ -42,16 +42,18 @@ private:
 class SessionAgentPrivate
 {
 public:
-    SessionAgentPrivate(const QString &path);
+    SessionAgentPrivate(const QString &path, const QVariantMap &settings);
 
     QString agentPath;
-    QVariantMap sessionSettings;
+    QVariantMap createSettings;
+    SessionSettings sessionSettings;
     QSharedPointer<NetworkManager> m_manager;
     NetConnmanSessionInterface *m_session;
 };
 
-SessionAgentPrivate::SessionAgentPrivate(const QString &path)
+SessionAgentPrivate::SessionAgentPrivate(const QString &path, const QVariantMap &settings)
     : agentPath(path)
+    , createSettings(settings)
     , m_manager(NetworkManager::sharedInstance())
     , m_session(nullptr)
 {
@@ -59,7 +61,14 @@ SessionAgentPrivate::SessionAgentPrivate(const QString &path)
 
 SessionAgent::SessionAgent(const QString &path, QObject *parent)
     : QObject(parent)
-    , d_ptr(new SessionAgentPrivate(path))
+    , d_ptr(new SessionAgentPrivate(path, QVariantMap()))
+{
+    createSession();
+}
+
+SessionAgent::SessionAgent(const QString &path, const QVariantMap &settings, QObject *parent)
+    : QObject(parent)
+    , d_ptr(new SessionAgentPrivate(path, settings))
 {
     createSession();
 }
@@ -72,6 +81,16 @@ SessionAgent::~SessionAgent()
     d_ptr = nullptr;
 }
 
+QString SessionAgent::path() const
+{
+    return d_ptr->agentPath;
+}
+
+SessionSettings SessionAgent::settings() const
+{
+    return d_ptr->sessionSettings;
+}
+
 void SessionAgent::setAllowedBearers(const QStringList &bearers)
 {
     if (!d_ptr->m_session)
@@ -97,10 +116,19 @@ void SessionAgent::setConnectionType(const QString &type)
     d_ptr->m_session->Change("ConnectionType", QDBusVariant(type));
 }
 
+void SessionAgent::change(const QVariantMap &settings)
+{
+    if (!d_ptr->m_session)
+        return;
+
+    for (QVariantMap::ConstIterator it = settings.constBegin(); it != settings.constEnd(); ++it)
+        d_ptr->m_session->Change(it.key(), QDBusVariant(it.value()));
+}
+
 void SessionAgent::createSession()
 {
     if (d_ptr->m_manager->isAvailable()) {
-        QDBusObjectPath objectPath = d_ptr->m_manager->createSession(QVariantMap(), d_ptr->agentPath);
+        QDBusObjectPath objectPath = d_ptr->m_manager->createSession(d_ptr->createSettings, d_ptr->agentPath);
 
         if (!objectPath.path().isEmpty()) {
             d_ptr->m_session = new NetConnmanSessionInterface("net.connman", objectPath.path(),
@@ -147,7 +175,10 @@ void SessionAgent::release()
 
 void SessionAgent::update(const QVariantMap &settings)
 {
+    const SessionSettings update(SessionSettings::decode(settings));
+    d_ptr->sessionSettings.merge(update);
     Q_EMIT settingsUpdated(settings);
+    Q_EMIT settingsDecoded(update);
 }
 
 void SessionAgent::onConnectFinished(QDBusPendingCallWatcher *call)
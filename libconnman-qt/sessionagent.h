@@ -11,6 +11,7 @@
 #define SESSIONAGENT_H
 
 #include "networkmanager.h"
+#include "sessionsettings.h"
 
 class NetConnmanSessionInterface;
 class SessionAgentPrivate;
@@ -21,10 +22,18 @@ class SessionAgent : public QObject
 
 public:
     explicit SessionAgent(const QString &path, QObject *parent = 0);
+    // The session is created with the settings, as one call
+    SessionAgent(const QString &path, const QVariantMap &settings, QObject *parent = 0);
     virtual ~SessionAgent();
 
+    QString path() const;
+    // The settings ConnMan has sent so far
+    SessionSettings settings() const;
+
     void setAllowedBearers(const QStringList &bearers);
     void setConnectionType(const QString &type);
+    // Changes the settings without waiting for the replies
+    void change(const QVariantMap &settings);
     void requestConnect();
     void requestDisconnect();
     void requestDestroy();
@@ -36,6 +45,8 @@ public Q_SLOTS:
 
 Q_SIGNALS:
     void settingsUpdated(const QVariantMap &settings);
+    // The same update, decoded once for all the users of the session
+    void settingsDecoded(const SessionSettings &update);
     void released();
 
 private Q_SLOTS:
@@ -0,0 +1,278 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "sessionpool.h"
+#include "sessionagent.h"
+#include "logging.h"
+
+#include <QCoreApplication>
+#include <QStringList>
+
+static const int IdleGracePeriod = 10 * 1000;
+
+// The reference of the process, next to those of the sessions
+static QSharedPointer<SessionPool> &processPool()
+{
+    static QSharedPointer<SessionPool> pool;
+    return pool;
+}
+
+static void releaseProcessPool()
+{
+    processPool().clear();
+}
+
+/*
+ * One pool for the process. While the application exists it holds the
+ * pool, so that idle sessions outlive the last NetworkSession for the
+ * grace period. The sessions still using the pool after that keep it.
+ */
+QSharedPointer<SessionPool> SessionPool::sharedInstance()
+{
+    static QWeakPointer<SessionPool> sharedPool;
+
+    QSharedPointer<SessionPool> pool = sharedPool.toStrongRef();
+
+    if (!pool) {
+        pool = QSharedPointer<SessionPool>(new SessionPool);
+        sharedPool = pool;
+
+        if (QCoreApplication::instance() && !processPool()) {
+            processPool() = pool;
+            qAddPostRoutine(releaseProcessPool);
+        }
+    }
+
+    return pool;
+}
+
+SessionPool::SessionPool()
+    : m_idleGracePeriod(IdleGracePeriod)
+{
+    m_expiryTimer.setSingleShot(true);
+    connect(&m_expiryTimer, &QTimer::timeout, this, &SessionPool::expire);
+
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+                this, &SessionPool::clearIdle);
+    }
+}
+
+SessionPool::~SessionPool()
+{
+    // The agents are children of the pool
+}
+
+QString SessionPool::key(const QString &path, const QVariantMap &settings)
+{
+    QString key(path);
+    for (QVariantMap::ConstIterator it = settings.constBegin(); it != settings.constEnd(); ++it) {
+        const QVariant &value = it.value();
+        key += QLatin1Char('\n') + it.key() + QLatin1Char('=');
+        if (value.canConvert<QStringList>() && value.userType() != QMetaType::QString)
+            key += value.toStringList().join(QLatin1Char(','));
+        else
+            key += value.toString();
+    }
+    return key;
+}
+
+int SessionPool::indexOf(SessionAgent *agent) const
+{
+    for (int i = 0; i < m_entries.count(); ++i) {
+        if (m_entries.at(i).agent == agent)
+            return i;
+    }
+    return -1;
+}
+
+int SessionPool::indexOf(const QString &key) const
+{
+    for (int i = 0; i < m_entries.count(); ++i) {
+        if (!m_entries.at(i).released && m_entries.at(i).key == key)
+            return i;
+    }
+    return -1;
+}
+
+// One agent object per D-Bus path
+QString SessionPool::uniquePath(const QString &path) const
+{
+    QString unique(path);
+    for (int suffix = 1; ; ++suffix) {
+        bool used = false;
+        for (const Entry &entry : m_entries)
+            used = used || entry.agent->path() == unique;
+        if (!used)
+            return unique;
+        unique = path + QLatin1Char('_') + QString::number(suffix);
+    }
+}
+
+SessionAgent *SessionPool::acquire(const QString &path, const QVariantMap &settings)
+{
+    const QString sessionKey(key(path, settings));
+
+    const int index = indexOf(sessionKey);
+    if (index >= 0) {
+        Entry &entry = m_entries[index];
+        if (entry.refs++ == 0)
+            scheduleExpiry();
+        qCDebug(lcConnman) << "Sharing session" << entry.agent->path() << "with" << entry.refs << "users";
+        return entry.agent;
+    }
+
+    Entry entry;
+    entry.agent = new SessionAgent(uniquePath(path), settings, this);
+    entry.path = path;
+    entry.key = sessionKey;
+    entry.refs = 1;
+    entry.connects = 0;
+    entry.released = false;
+    connect(entry.agent, &SessionAgent::released, this, &SessionPool::onReleased);
+    m_entries.append(entry);
+
+    return entry.agent;
+}
+
+void SessionPool::release(SessionAgent *agent)
+{
+    const int index = indexOf(agent);
+    if (index < 0)
+        return;
+
+    Entry &entry = m_entries[index];
+    if (--entry.refs > 0)
+        return;
+
+    if (entry.released) {
+        remove(index);
+        return;
+    }
+
+    entry.idleSince.start();
+    scheduleExpiry();
+}
+
+SessionAgent *SessionPool::change(SessionAgent *agent, const QString &path, const QVariantMap &settings)
+{
+    const int index = indexOf(agent);
+    if (index < 0)
+        return acquire(path, settings);
+
+    const QString sessionKey(key(path, settings));
+    Entry &entry = m_entries[index];
+    if (entry.key == sessionKey)
+        return agent;
+
+    if (entry.refs == 1 && !entry.released && entry.path == path && indexOf(sessionKey) < 0) {
+        entry.key = sessionKey;
+        entry.agent->change(settings);
+        return agent;
+    }
+
+    return acquire(path, settings);
+}
+
+void SessionPool::requestConnect(SessionAgent *agent)
+{
+    const int index = indexOf(agent);
+    if (index >= 0)
+        m_entries[index].connects++;
+    agent->requestConnect();
+}
+
+void SessionPool::requestDisconnect(SessionAgent *agent)
+{
+    const int index = indexOf(agent);
+    if (index >= 0 && m_entries.at(index).connects > 0 && --m_entries[index].connects > 0)
+        return;
+    agent->requestDisconnect();
+}
+
+void SessionPool::requestDestroy(SessionAgent *agent)
+{
+    if (refCount(agent) > 1) {
+        qCDebug(lcConnman) << "Not destroying shared session" << agent->path();
+        return;
+    }
+    agent->requestDestroy();
+}
+
+int SessionPool::refCount(SessionAgent *agent) const
+{
+    const int index = indexOf(agent);
+    return index >= 0 ? m_entries.at(index).refs : 0;
+}
+
+int SessionPool::idleGracePeriod() const
+{
+    return m_idleGracePeriod;
+}
+
+void SessionPool::setIdleGracePeriod(int period)
+{
+    m_idleGracePeriod = qMax(0, period);
+    scheduleExpiry();
+}
+
+// ConnMan is done with the session, it can't be shared any more
+void SessionPool::onReleased()
+{
+    const int index = indexOf(qobject_cast<SessionAgent *>(sender()));
+    if (index < 0)
+        return;
+
+    m_entries[index].released = true;
+    if (m_entries.at(index).refs == 0)
+        remove(index);
+}
+
+void SessionPool::remove(int index)
+{
+    const Entry entry = m_entries.takeAt(index);
+    entry.agent->disconnect(this);
+    entry.agent->deleteLater();
+    scheduleExpiry();
+}
+
+void SessionPool::expire()
+{
+    for (int i = m_entries.count() - 1; i >= 0; --i) {
+        const Entry &entry = m_entries.at(i);
+        if (entry.refs == 0 && entry.idleSince.elapsed() >= m_idleGracePeriod) {
+            qCDebug(lcConnman) << "Destroying idle session" << entry.agent->path();
+            remove(i);
+        }
+    }
+    scheduleExpiry();
+}
+
+void SessionPool::clearIdle()
+{
+    for (int i = m_entries.count() - 1; i >= 0; --i) {
+        if (m_entries.at(i).refs == 0)
+            remove(i);
+    }
+}
+
+void SessionPool::scheduleExpiry()
+{
+    qint64 next = -1;
+    for (const Entry &entry : m_entries) {
+        if (entry.refs == 0) {
+            const qint64 remaining = qMax<qint64>(m_idleGracePeriod - entry.idleSince.elapsed(), 0);
+            next = next < 0 ? remaining : qMin(next, remaining);
+        }
+    }
+
+    if (next < 0)
+        m_expiryTimer.stop();
+    else
+        m_expiryTimer.start(int(next));
+}
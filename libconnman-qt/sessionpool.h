@@ -0,0 +1,92 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef SESSIONPOOL_H
+#define SESSIONPOOL_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QVariantMap>
+
+class SessionAgent;
+
+/*
+ * Shares ConnMan sessions between the NetworkSession instances of the
+ * process. Sessions with the same agent path and the same requested
+ * settings (AllowedBearers, ConnectionType) are the same session, held
+ * with a reference count.
+ *
+ * An unused session is kept for a grace period before it's destroyed, so
+ * that sessions opened and closed in quick succession don't each cost a
+ * CreateSession and DestroySession. The pool is held by the application
+ * for that, the idle sessions are destroyed when it quits.
+ */
+class SessionPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    static QSharedPointer<SessionPool> sharedInstance();
+    ~SessionPool();
+
+    // The agent has the settings of the session once ConnMan has sent them
+    SessionAgent *acquire(const QString &path, const QVariantMap &settings);
+    void release(SessionAgent *agent);
+
+    // Changes the session in place if nobody else uses it, otherwise
+    // acquires a matching one and the caller releases the old one
+    SessionAgent *change(SessionAgent *agent, const QString &path, const QVariantMap &settings);
+
+    // Connect requests are counted, the session is disconnected when the
+    // last one is withdrawn. A user withdraws its connect before release.
+    void requestConnect(SessionAgent *agent);
+    void requestDisconnect(SessionAgent *agent);
+    // Only destroys a session that nobody else uses
+    void requestDestroy(SessionAgent *agent);
+
+    int refCount(SessionAgent *agent) const;
+
+    // How long an unused session is kept, in ms
+    int idleGracePeriod() const;
+    void setIdleGracePeriod(int period);
+
+private Q_SLOTS:
+    void onReleased();
+    void expire();
+    void clearIdle();
+
+private:
+    struct Entry {
+        SessionAgent *agent;
+        QString path;  // as requested
+        QString key;
+        int refs;
+        int connects;
+        bool released;
+        QElapsedTimer idleSince;
+    };
+
+    SessionPool();
+
+    static QString key(const QString &path, const QVariantMap &settings);
+    int indexOf(SessionAgent *agent) const;
+    int indexOf(const QString &key) const;
+    QString uniquePath(const QString &path) const;
+    void remove(int index);
+    void scheduleExpiry();
+
+private:
+    QList<Entry> m_entries;
+    QTimer m_expiryTimer;
+    int m_idleGracePeriod;
+};
+
+#endif // SESSIONPOOL_H
@@ -0,0 +1,95 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "sessionsettings.h"
+
+#include <QDBusArgument>
+
+// Nested dictionaries arrive still marshalled over D-Bus
+static QVariantMap toMap(const QVariant &value)
+{
+    if (value.userType() == qMetaTypeId<QDBusArgument>())
+        return qdbus_cast<QVariantMap>(value);
+    return value.toMap();
+}
+
+SessionSettings SessionSettings::decode(const QVariantMap &settings)
+{
+    SessionSettings decoded;
+    decoded.values = settings;
+
+    for (QVariantMap::ConstIterator it = settings.constBegin(); it != settings.constEnd(); ++it) {
+        const QString &key = it.key();
+        if (key == QLatin1String("State")) {
+            decoded.state = it.value().toString();
+            decoded.fields |= State;
+        } else if (key == QLatin1String("Name")) {
+            decoded.name = it.value().toString();
+            decoded.fields |= Name;
+        } else if (key == QLatin1String("Bearer")) {
+            decoded.bearer = it.value().toString();
+            decoded.fields |= Bearer;
+        } else if (key == QLatin1String("Interface")) {
+            decoded.sessionInterface = it.value().toString();
+            decoded.fields |= Interface;
+        } else if (key == QLatin1String("IPv4")) {
+            decoded.ipv4 = toMap(it.value());
+            decoded.values.insert(key, decoded.ipv4);
+            decoded.fields |= IPv4;
+        } else if (key == QLatin1String("IPv6")) {
+            decoded.ipv6 = toMap(it.value());
+            decoded.values.insert(key, decoded.ipv6);
+            decoded.fields |= IPv6;
+        } else if (key == QLatin1String("AllowedBearers")) {
+            decoded.allowedBearers = it.value().toStringList();
+            decoded.fields |= AllowedBearers;
+        } else if (key == QLatin1String("ConnectionType")) {
+            decoded.connectionType = it.value().toString();
+            decoded.fields |= ConnectionType;
+        }
+    }
+
+    return decoded;
+}
+
+template <typename T>
+static void mergeField(SessionSettings::Field field, SessionSettings::Fields present,
+                       SessionSettings::Fields updated, T *value, const T &update,
+                       SessionSettings::Fields *changed)
+{
+    if (updated.testFlag(field) && (!present.testFlag(field) || *value != update)) {
+        *value = update;
+        *changed |= field;
+    }
+}
+
+SessionSettings::Fields SessionSettings::merge(const SessionSettings &update)
+{
+    const Fields updated = update.fields;
+    Fields changed;
+
+    mergeField(State, fields, updated, &state, update.state, &changed);
+    mergeField(Name, fields, updated, &name, update.name, &changed);
+    mergeField(Bearer, fields, updated, &bearer, update.bearer, &changed);
+    mergeField(Interface, fields, updated, &sessionInterface, update.sessionInterface, &changed);
+    mergeField(IPv4, fields, updated, &ipv4, update.ipv4, &changed);
+    mergeField(IPv6, fields, updated, &ipv6, update.ipv6, &changed);
+    mergeField(AllowedBearers, fields, updated, &allowedBearers, update.allowedBearers, &changed);
+    mergeField(ConnectionType, fields, updated, &connectionType, update.connectionType, &changed);
+
+    fields |= updated;
+    for (QVariantMap::ConstIterator it = update.values.constBegin(); it != update.values.constEnd(); ++it)
+        values.insert(it.key(), it.value());
+
+    return changed;
+}
+
+void SessionSettings::clear()
+{
+    *this = SessionSettings();
+}
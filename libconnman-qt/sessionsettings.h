@@ -0,0 +1,61 @@
+/*
+ * Copyright © 2026 Jolla Mobile Ltd
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0. The full text of the Apache License
+ * is at http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef SESSIONSETTINGS_H
+#define SESSIONSETTINGS_H
+
+#include <QMetaType>
+#include <QStringList>
+#include <QVariantMap>
+
+/*
+ * The settings of a ConnMan session, decoded from the dictionary of the
+ * Update notification. An update has only the fields that it carries,
+ * merging it into the full settings tells which of them changed.
+ */
+struct SessionSettings
+{
+    enum Field {
+        State = 0x01,
+        Name = 0x02,
+        Bearer = 0x04,
+        Interface = 0x08,
+        IPv4 = 0x10,
+        IPv6 = 0x20,
+        AllowedBearers = 0x40,
+        ConnectionType = 0x80
+    };
+    Q_DECLARE_FLAGS(Fields, Field)
+
+    SessionSettings() {}
+
+    static SessionSettings decode(const QVariantMap &settings);
+
+    // Takes the fields of the update, returns the ones that changed
+    Fields merge(const SessionSettings &update);
+
+    void clear();
+
+    Fields fields; // the ones present
+    QString state;
+    QString name;
+    QString bearer;
+    QString sessionInterface;
+    QVariantMap ipv4;
+    QVariantMap ipv6;
+    QStringList allowedBearers;
+    QString connectionType;
+
+    // All the values as sent, including the ones not decoded
+    QVariantMap values;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(SessionSettings::Fields)
+Q_DECLARE_METATYPE(SessionSettings)
+
+#endif // SESSIONSETTINGS_H
@@ -9,8 +9,16 @@
 
 #include "useragent.h"
 #include "networkmanager.h"
+#include "logging.h"
+
+#include <QDBusArgument>
 
 static const char AGENT_PATH[] = "/ConnectivityUserAgent";
+static const char CANCELED_ERROR[] = "net.connman.Agent.Error.Canceled";
+
+// The defaults of ConnMan for the input and browser requests
+static const int INPUT_TIMEOUT = 120 * 1000;
+static const int BROWSER_TIMEOUT = 300 * 1000;
 
 class AgentAdaptor : public QDBusAbstractAdaptor
 {
@@ -47,9 +55,37 @@ public:
         TYPE_CLEAR
     };
 
+    enum RequestType {
+        INPUT_REQUEST = 0,
+        BROWSER_REQUEST
+    };
+
+    /*
+     * An outstanding request with a delayed reply. There is at most one
+     * of each type per service, a newer one supersedes it.
+     */
+    struct Request {
+        RequestType type;
+        QString servicePath;
+        QDBusMessage message;
+        qint64 received;
+        qint64 deadline;
+    };
+
     UserAgentPrivate();
 
-    ServiceRequestData *m_req_data;
+    int find(RequestType type, const QString &servicePath) const;
+    bool take(RequestType type, const QString &servicePath, Request *request);
+    bool provideCredentials(const QString &servicePath, const QVector<UserAgentField> &fields,
+                            const QDBusMessage &message);
+    void scheduleDeadline();
+
+    static void sendCanceled(const QDBusMessage &message, const QString &reason);
+
+    QList<Request> requests; // oldest first
+    QElapsedTimer clock;
+    QTimer deadlineTimer;
+    UserAgentCredentialProvider *credentialProvider;
     QSharedPointer<NetworkManager> m_manager;
     QDBusMessage currentDbusMessage;
     ConnectionRequestType requestType;
@@ -59,16 +95,127 @@ public:
 };
 
 UserAgentPrivate::UserAgentPrivate()
-    : m_req_data(nullptr)
+    : credentialProvider(nullptr)
     , m_manager(NetworkManager::sharedInstance())
     , requestType(TYPE_DEFAULT)
 {
+    clock.start();
+    deadlineTimer.setSingleShot(true);
+}
+
+// The latest request of the type if the service path is empty
+int UserAgentPrivate::find(RequestType type, const QString &servicePath) const
+{
+    for (int i = requests.count() - 1; i >= 0; --i) {
+        const Request &request = requests.at(i);
+        if (request.type == type && (servicePath.isEmpty() || request.servicePath == servicePath))
+            return i;
+    }
+    return -1;
+}
+
+bool UserAgentPrivate::take(RequestType type, const QString &servicePath, Request *request)
+{
+    const int index = find(type, servicePath);
+    if (index < 0)
+        return false;
+
+    *request = requests.takeAt(index);
+    scheduleDeadline();
+    return true;
+}
+
+/*
+ * Answers the request right away if the provider has all the mandatory
+ * fields, otherwise it's left to the user.
+ */
+bool UserAgentPrivate::provideCredentials(const QString &servicePath,
+                                          const QVector<UserAgentField> &fields,
+                                          const QDBusMessage &message)
+{
+    if (!credentialProvider)
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const QVariantMap input(credentialProvider->credentials(servicePath, fields));
+    if (input.isEmpty())
+        return false;
+
+    for (const UserAgentField &field : fields) {
+        if (field.isMandatory() && !input.contains(field.name)) {
+            qCDebug(lcConnman) << "Credential provider lacks" << field.name << "for" << servicePath;
+            return false;
+        }
+    }
+
+    QDBusMessage reply = message.createReply();
+    reply << input;
+    QDBusConnection::systemBus().send(reply);
+    qCDebug(lcConnman) << "Credentials for" << servicePath << "provided in"
+                       << timer.nsecsElapsed() / 1000 << "us";
+    return true;
+}
+
+/*
+ * The field is a variant holding a dictionary. Over D-Bus it arrives
+ * still marshalled and is read in one go.
+ */
+static UserAgentField decodeField(const QString &name, const QVariant &value)
+{
+    UserAgentField field;
+    field.name = name;
+
+    if (value.userType() == qMetaTypeId<QDBusArgument>()) {
+        const QDBusArgument argument = value.value<QDBusArgument>();
+        argument.beginMap();
+        while (!argument.atEnd()) {
+            QString key;
+            QDBusVariant property;
+            argument.beginMapEntry();
+            argument >> key >> property;
+            argument.endMapEntry();
+            field.properties.insert(key, property.variant());
+        }
+        argument.endMap();
+    } else {
+        field.properties = value.toMap();
+    }
+
+    field.type = field.properties.value(QStringLiteral("Type")).toString();
+    field.requirement = field.properties.value(QStringLiteral("Requirement")).toString();
+    field.alternates = field.properties.value(QStringLiteral("Alternates")).toStringList();
+    return field;
+}
+
+void UserAgentPrivate::scheduleDeadline()
+{
+    if (requests.isEmpty()) {
+        deadlineTimer.stop();
+        return;
+    }
+
+    qint64 deadline = requests.first().deadline;
+    for (const Request &request : requests)
+        deadline = qMin(deadline, request.deadline);
+    deadlineTimer.start(int(qMax<qint64>(deadline - clock.elapsed(), 0)));
+}
+
+void UserAgentPrivate::sendCanceled(const QDBusMessage &message, const QString &reason)
+{
+    QDBusMessage error = message.createErrorReply(QString(CANCELED_ERROR), reason);
+    QDBusConnection::systemBus().send(error);
 }
 
 UserAgent::UserAgent(QObject* parent)
     : QObject(parent)
     , d_ptr(new UserAgentPrivate)
 {
+    // For queued connections to userInputFieldsRequested()
+    qRegisterMetaType<UserAgentField>("UserAgentField");
+    qRegisterMetaType<QVector<UserAgentField> >("QVector<UserAgentField>");
+
     QString agentpath = QLatin1String("/ConnectivityUserAgent");
     setAgentPath(agentpath);
     connect(d_ptr->m_manager.data(), &NetworkManager::availabilityChanged,
@@ -77,30 +224,99 @@ UserAgent::UserAgent(QObject* parent)
     d_ptr->requestTimer.setSingleShot(true);
     connect(&d_ptr->requestTimer, &QTimer::timeout,
             this, &UserAgent::requestTimeout);
+    connect(&d_ptr->deadlineTimer, &QTimer::timeout,
+            this, &UserAgent::expireRequests);
 }
 
 UserAgent::~UserAgent()
 {
     d_ptr->m_manager->unregisterAgent(QString(d_ptr->agentPath));
 
-    delete d_ptr->m_req_data;
-    d_ptr->m_req_data = nullptr;
+    // Don't leave ConnMan waiting for the timeout
+    for (const UserAgentPrivate::Request &request : d_ptr->requests)
+        UserAgentPrivate::sendCanceled(request.message, QStringLiteral("agent gone"));
 
     delete d_ptr;
     d_ptr = nullptr;
 }
 
-void UserAgent::requestUserInput(ServiceRequestData* data)
+void UserAgent::queueRequest(int type, const QString &servicePath, const QDBusMessage &message)
+{
+    const UserAgentPrivate::RequestType requestType = UserAgentPrivate::RequestType(type);
+
+    UserAgentPrivate::Request superseded;
+    if (d_ptr->take(requestType, servicePath, &superseded)) {
+        qCDebug(lcConnman) << "Request for" << servicePath << "superseded";
+        UserAgentPrivate::sendCanceled(superseded.message, QStringLiteral("superseded"));
+        Q_EMIT requestCanceled(servicePath);
+    }
+
+    UserAgentPrivate::Request request;
+    request.type = requestType;
+    request.servicePath = servicePath;
+    request.message = message;
+    request.received = d_ptr->clock.elapsed();
+    request.deadline = request.received
+            + (requestType == UserAgentPrivate::BROWSER_REQUEST ? BROWSER_TIMEOUT : INPUT_TIMEOUT);
+    d_ptr->requests.append(request);
+    d_ptr->scheduleDeadline();
+}
+
+void UserAgent::expireRequests()
 {
-    delete d_ptr->m_req_data;
-    d_ptr->m_req_data = data;
-    Q_EMIT userInputRequested(data->objectPath, data->fields);
+    const qint64 now = d_ptr->clock.elapsed();
+
+    QStringList expired;
+    for (int i = 0; i < d_ptr->requests.count(); ) {
+        const UserAgentPrivate::Request &request = d_ptr->requests.at(i);
+        if (request.deadline <= now) {
+            UserAgentPrivate::sendCanceled(request.message, QStringLiteral("timed out"));
+            expired.append(request.servicePath);
+            d_ptr->requests.removeAt(i);
+        } else {
+            ++i;
+        }
+    }
+    d_ptr->scheduleDeadline();
+
+    for (const QString &servicePath : expired)
+        Q_EMIT requestCanceled(servicePath);
+    if (!expired.isEmpty() && d_ptr->find(UserAgentPrivate::INPUT_REQUEST, QString()) < 0)
+        Q_EMIT userInputCanceled();
+}
+
+void UserAgent::requestUserInput(const QString &servicePath, const QVector<UserAgentField> &fields,
+                                 const QDBusMessage &message)
+{
+    if (d_ptr->provideCredentials(servicePath, fields, message)) {
+        // Whatever the user was asked for this service is no longer needed
+        UserAgentPrivate::Request superseded;
+        if (d_ptr->take(UserAgentPrivate::INPUT_REQUEST, servicePath, &superseded)) {
+            UserAgentPrivate::sendCanceled(superseded.message, QStringLiteral("superseded"));
+            Q_EMIT requestCanceled(servicePath);
+        }
+        return;
+    }
+
+    queueRequest(UserAgentPrivate::INPUT_REQUEST, servicePath, message);
+
+    QVariantMap fieldMap;
+    for (const UserAgentField &field : fields)
+        fieldMap.insert(field.name, field.properties);
+
+    Q_EMIT userInputFieldsRequested(servicePath, fields);
+    Q_EMIT userInputRequested(servicePath, fieldMap);
 }
 
+// ConnMan has given up on its requests, they need no reply
 void UserAgent::cancelUserInput()
 {
-    delete d_ptr->m_req_data;
-    d_ptr->m_req_data = nullptr;
+    const QList<UserAgentPrivate::Request> requests(d_ptr->requests);
+    d_ptr->requests.clear();
+    d_ptr->scheduleDeadline();
+
+    for (const UserAgentPrivate::Request &request : requests)
+        Q_EMIT requestCanceled(request.servicePath);
     Q_EMIT userInputCanceled();
 }
 
@@ -111,23 +327,41 @@ void UserAgent::reportError(const QString &servicePath, const QString &error)
 
 void UserAgent::sendUserReply(const QVariantMap &input)
 {
-    if (d_ptr->m_req_data == nullptr) {
-        qWarning() << "Got reply for non-existing request";
+    sendUserReply(QString(), input);
+}
+
+void UserAgent::sendUserReply(const QString &servicePath, const QVariantMap &input)
+{
+    UserAgentPrivate::Request request;
+    if (!d_ptr->take(UserAgentPrivate::INPUT_REQUEST, servicePath, &request)) {
+        qWarning() << "Got reply for non-existing request" << servicePath;
         return;
     }
 
+    qCDebug(lcConnman) << "User input for" << request.servicePath << "took"
+                       << d_ptr->clock.elapsed() - request.received << "ms";
+
     if (!input.isEmpty()) {
-        QDBusMessage &reply = d_ptr->m_req_data->reply;
+        QDBusMessage reply = request.message.createReply();
         reply << input;
         QDBusConnection::systemBus().send(reply);
     } else {
-        QDBusMessage error = d_ptr->m_req_data->msg.createErrorReply(
-            QString("net.connman.Agent.Error.Canceled"),
-            QString("canceled by user"));
-        QDBusConnection::systemBus().send(error);
+        UserAgentPrivate::sendCanceled(request.message, QStringLiteral("canceled by user"));
+    }
+}
+
+void UserAgent::sendBrowserReply(const QString &servicePath, bool canceled)
+{
+    UserAgentPrivate::Request request;
+    if (!d_ptr->take(UserAgentPrivate::BROWSER_REQUEST, servicePath, &request)) {
+        qWarning() << "Got browser reply for non-existing request" << servicePath;
+        return;
     }
-    delete d_ptr->m_req_data;
-    d_ptr->m_req_data = nullptr;
+
+    if (!canceled)
+        QDBusConnection::systemBus().send(request.message.createReply());
+    else
+        UserAgentPrivate::sendCanceled(request.message, QStringLiteral("canceled by user"));
 }
 
 void UserAgent::requestTimeout()
@@ -201,6 +435,16 @@ void UserAgent::requestConnect(const QDBusMessage &msg)
     setConnectionRequestType("Suppress");
 }
 
+void UserAgent::setCredentialProvider(UserAgentCredentialProvider *provider)
+{
+    d_ptr->credentialProvider = provider;
+}
+
+UserAgentCredentialProvider *UserAgent::credentialProvider() const
+{
+    return d_ptr->credentialProvider;
+}
+
 QString UserAgent::path() const
 {
     return d_ptr->agentPath;
@@ -224,6 +468,7 @@ void UserAgent::requestBrowser(const QString &servicePath, const QString &url,
                                const QDBusMessage &message)
 {
     qDebug() << message.arguments();
+    queueRequest(UserAgentPrivate::BROWSER_REQUEST, servicePath, message);
     Q_EMIT browserRequested(servicePath, url);
 }
 
@@ -260,21 +505,13 @@ void AgentAdaptor::RequestInput(const QDBusObjectPath &service_path,
                                 const QVariantMap &fields,
                                 const QDBusMessage &message)
 {
-    QVariantMap json;
-    for (const QString &key : fields.keys()){
-        QVariantMap payload = qdbus_cast<QVariantMap>(fields[key]);
-        json.insert(key, payload);
-    }
+    QVector<UserAgentField> decoded;
+    decoded.reserve(fields.size());
+    for (QVariantMap::ConstIterator it = fields.constBegin(); it != fields.constEnd(); ++it)
+        decoded.append(decodeField(it.key(), it.value()));
 
     message.setDelayedReply(true);
-
-    ServiceRequestData *reqdata = new ServiceRequestData;
-    reqdata->objectPath = service_path.path();
-    reqdata->fields = json;
-    reqdata->reply = message.createReply();
-    reqdata->msg = message;
-
-    m_userAgent->requestUserInput(reqdata);
+    m_userAgent->requestUserInput(service_path.path(), decoded, message);
 }
 
 void AgentAdaptor::Cancel()
@@ -15,10 +15,31 @@
 #include <QDBusAbstractAdaptor>
 #include <QTimer>
 #include <QElapsedTimer>
+#include <QVector>
 
 #include "networkmanager.h"
 
-struct ServiceRequestData
+/*
+ * A field of an input request, decoded from the RequestInput arguments.
+ * The properties have all the values ConnMan sent for the field, the
+ * common ones are also picked out.
+ */
+struct UserAgentField
+{
+    QString name;
+    QString type;         // e.g. "psk", "passphrase", "wpspin"
+    QString requirement;  // "mandatory", "optional", "alternate" or "informational"
+    QStringList alternates;
+    QVariantMap properties;
+
+    bool isMandatory() const { return requirement == QLatin1String("mandatory"); }
+};
+
+Q_DECLARE_TYPEINFO(UserAgentField, Q_MOVABLE_TYPE);
+Q_DECLARE_METATYPE(UserAgentField)
+
+// Not used by UserAgent any more, see UserAgentField
+struct Q_DECL_DEPRECATED ServiceRequestData
 {
     QString objectPath;
     QVariantMap fields;
@@ -26,6 +47,21 @@ struct ServiceRequestData
     QDBusMessage msg;
 };
 
+/*
+ * Answers input requests without asking the user, e.g. from provisioned
+ * configuration. It's called synchronously in the D-Bus handler, so it
+ * must not block.
+ */
+class UserAgentCredentialProvider
+{
+public:
+    virtual ~UserAgentCredentialProvider() {}
+
+    // The values of the requested fields, or an empty map to ask the user
+    virtual QVariantMap credentials(const QString &servicePath,
+                                    const QVector<UserAgentField> &fields) = 0;
+};
+
 class UserAgentPrivate;
 
 class UserAgent : public QObject
@@ -42,8 +78,15 @@ public:
     QString connectionRequestType() const;
     QString path() const;
 
+    // Not owned, consulted before userInputRequested() is emitted
+    void setCredentialProvider(UserAgentCredentialProvider *provider);
+    UserAgentCredentialProvider *credentialProvider() const;
+
 public Q_SLOTS:
+    // Replies to the latest input request, an empty input cancels it
     void sendUserReply(const QVariantMap &input);
+    void sendUserReply(const QString &servicePath, const QVariantMap &input);
+    void sendBrowserReply(const QString &servicePath, bool canceled = false);
 
     void sendConnectReply(const QString &replyMessage, int timeout = 120);
     void setConnectionRequestType(const QString &type);
@@ -51,7 +94,11 @@ public Q_SLOTS:
 
 Q_SIGNALS:
     void userInputRequested(const QString &servicePath, const QVariantMap &fields);
+    // The same request with the fields decoded
+    void userInputFieldsRequested(const QString &servicePath, const QVector<UserAgentField> &fields);
     void userInputCanceled();
+    // A request was superseded, timed out or canceled by ConnMan
+    void requestCanceled(const QString &servicePath);
     void errorReported(const QString &servicePath, const QString &error);
     void browserRequested(const QString &servicePath, const QString &url);
 
@@ -61,14 +108,17 @@ Q_SIGNALS:
 private Q_SLOTS:
     void updateMgrAvailability(bool);
     void requestTimeout();
+    void expireRequests();
 
 private:
-    void requestUserInput(ServiceRequestData* data);
+    void requestUserInput(const QString &servicePath, const QVector<UserAgentField> &fields,
+                          const QDBusMessage &message);
     void cancelUserInput();
     void reportError(const QString &servicePath, const QString &error);
     void requestConnect(const QDBusMessage &msg);
     void requestBrowser(const QString &servicePath, const QString &url,
                         const QDBusMessage &message);
+    void queueRequest(int type, const QString &servicePath, const QDBusMessage &message);
 
     UserAgentPrivate *d_ptr;
 
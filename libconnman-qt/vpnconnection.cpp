@@ -64,6 +64,103 @@ QString vpnServicePath(const QString &connectionPath)
 
 } // Empty namespace
 
+// ==========================================================================
+// VpnConnectionRouter
+// ==========================================================================
+
+/*
+ * Delivers PropertyChanged signals to the VPN connections. A single
+ * subscription per bus name covers all connections instead of two match
+ * rules per connection, the proxies of the connections are only used for
+ * method calls.
+ */
+class VpnConnectionRouter : public QObject
+{
+    Q_OBJECT
+
+public:
+    static VpnConnectionRouter *instance();
+
+    void add(VpnConnectionPrivate *connection);
+    void remove(VpnConnectionPrivate *connection);
+
+private Q_SLOTS:
+    void onConnectionPropertyChanged(const QString &name, const QDBusVariant &value, const QDBusMessage &message);
+    void onServicePropertyChanged(const QString &name, const QDBusVariant &value, const QDBusMessage &message);
+
+private:
+    void subscribe(bool subscribe);
+
+    // More than one object may exist for the same path
+    QMultiHash<QString, VpnConnectionPrivate*> m_connections;
+    QMultiHash<QString, VpnConnectionPrivate*> m_services;
+};
+
+Q_GLOBAL_STATIC(VpnConnectionRouter, vpnConnectionRouter)
+
+VpnConnectionRouter *VpnConnectionRouter::instance()
+{
+    return vpnConnectionRouter();
+}
+
+void VpnConnectionRouter::add(VpnConnectionPrivate *connection)
+{
+    if (m_connections.isEmpty())
+        subscribe(true);
+
+    m_connections.insert(connection->m_path, connection);
+    m_services.insert(vpnServicePath(connection->m_path), connection);
+}
+
+void VpnConnectionRouter::remove(VpnConnectionPrivate *connection)
+{
+    m_connections.remove(connection->m_path, connection);
+    m_services.remove(vpnServicePath(connection->m_path), connection);
+
+    if (m_connections.isEmpty())
+        subscribe(false);
+}
+
+void VpnConnectionRouter::subscribe(bool subscribe)
+{
+    QDBusConnection bus(QDBusConnection::systemBus());
+    const QString connectionInterface(NetConnmanVpnConnectionInterface::staticInterfaceName());
+    const QString serviceInterface(NetConnmanServiceInterface::staticInterfaceName());
+
+    if (subscribe) {
+        bus.connect(connmanVpnService, QString(), connectionInterface, "PropertyChanged",
+                    this, SLOT(onConnectionPropertyChanged(QString,QDBusVariant,QDBusMessage)));
+        // Only AutoConnect is of interest, let the bus filter the rest
+        bus.connect(connmanService, QString(), serviceInterface, "PropertyChanged",
+                    QStringList() << autoConnectKey, QString(),
+                    this, SLOT(onServicePropertyChanged(QString,QDBusVariant,QDBusMessage)));
+    } else {
+        bus.disconnect(connmanVpnService, QString(), connectionInterface, "PropertyChanged",
+                       this, SLOT(onConnectionPropertyChanged(QString,QDBusVariant,QDBusMessage)));
+        bus.disconnect(connmanService, QString(), serviceInterface, "PropertyChanged",
+                       QStringList() << autoConnectKey, QString(),
+                       this, SLOT(onServicePropertyChanged(QString,QDBusVariant,QDBusMessage)));
+    }
+}
+
+void VpnConnectionRouter::onConnectionPropertyChanged(const QString &name, const QDBusVariant &value, const QDBusMessage &message)
+{
+    const QList<VpnConnectionPrivate*> connections(m_connections.values(message.path()));
+    for (VpnConnectionPrivate *connection : connections)
+        connection->connectionPropertyChanged(name, value.variant());
+}
+
+void VpnConnectionRouter::onServicePropertyChanged(const QString &name, const QDBusVariant &value, const QDBusMessage &message)
+{
+    const QList<VpnConnectionPrivate*> connections(m_services.values(message.path()));
+    for (VpnConnectionPrivate *connection : connections)
+        connection->servicePropertyChanged(name, value.variant());
+}
+
+// ==========================================================================
+// VpnConnectionPrivate
+// ==========================================================================
+
 VpnConnectionPrivate::VpnConnectionPrivate(VpnConnection &qq, const QString &path)
     : m_connectionProxy(connmanVpnService, path, QDBusConnection::systemBus(), nullptr)
     , m_serviceProxy(connmanService, vpnServicePath(path), QDBusConnection::systemBus(), nullptr)
@@ -71,34 +168,66 @@ VpnConnectionPrivate::VpnConnectionPrivate(VpnConnection &qq, const QString &pat
     , m_autoConnect(false)
     , m_splitRouting(false)
     , m_state(VpnConnection::Idle)
+    , m_autoConnectKnown(false)
+    , m_fetchPending(false)
+    , m_autoConnectSerial(0)
     , q_ptr(&qq)
     , m_retryTimer(0)
 {
 }
 
 void VpnConnectionPrivate::init()
+{
+    init(QVariantMap());
+}
+
+void VpnConnectionPrivate::init(const QVariantMap &properties)
 {
     Q_Q(VpnConnection);
 
     m_properties.insert("path", m_path);
 
-    getProperties();
+    if (!properties.isEmpty()) {
+        q->update(properties);
+        m_autoConnectKnown = properties.contains(QStringLiteral("autoConnect"));
+    }
 
-    VpnConnection::connect(&m_connectionProxy, &NetConnmanVpnConnectionInterface::PropertyChanged, q, [q](const QString &name, const QDBusVariant &value) {
-        QVariantMap properties;
-        qDebug() << "VPN connection property changed:" << name << value.variant() << q->path() << q->name();
-        properties.insert(name, value.variant());
-        q->update(MarshalUtils::propertiesToQml(properties));
-    });
+    if (!m_path.isEmpty()) {
+        VpnConnectionRouter::instance()->add(this);
+        // Not in the connection payloads. VpnManager reads it for all the
+        // connections it seeds with one call, others read their own.
+        if (properties.isEmpty())
+            fetchAutoConnect();
+    }
+}
 
-    VpnConnection::connect(&m_serviceProxy, &NetConnmanServiceInterface::PropertyChanged, q, [q](const QString &name, const QDBusVariant &value) {
-        qDebug() << "VPN service property changed:" << name << value.variant() << q->path() << q->name();
-        if (name == autoConnectKey) {
-            QVariantMap properties;
-            properties.insert(name, value.variant());
-            q->update(MarshalUtils::propertiesToQml(properties));
-        }
-    });
+VpnConnectionPrivate::~VpnConnectionPrivate()
+{
+    // The router may already be gone at exit
+    VpnConnectionRouter *router = VpnConnectionRouter::instance();
+    if (router && !m_path.isEmpty())
+        router->remove(this);
+}
+
+void VpnConnectionPrivate::connectionPropertyChanged(const QString &name, const QVariant &value)
+{
+    Q_Q(VpnConnection);
+
+    qCDebug(lcConnman) << "VPN connection property changed:" << name << value << m_path << q->name();
+    updateProperty(name, value);
+}
+
+void VpnConnectionPrivate::servicePropertyChanged(const QString &name, const QVariant &value)
+{
+    Q_Q(VpnConnection);
+
+    qCDebug(lcConnman) << "VPN service property changed:" << name << value << m_path << q->name();
+    if (name == autoConnectKey) {
+        // Newer than any fetch in progress
+        ++m_autoConnectSerial;
+        m_autoConnectKnown = true;
+        updateProperty(name, value);
+    }
 }
 
 void VpnConnectionPrivate::getPropertiesErrorHandler(QDBusError::ErrorType error)
@@ -123,29 +252,68 @@ void VpnConnectionPrivate::getPropertiesErrorHandler(QDBusError::ErrorType error
         });
         break;
     default:
+        // AutoConnect stays unknown until it changes or gets refreshed
         qCDebug(lcConnman) << "getProperties() error" << error;
         break;
     }
 }
 
+void VpnConnectionPrivate::fetchAutoConnect()
+{
+    if (!m_fetchPending)
+        getProperties();
+}
+
+void VpnConnectionPrivate::seedAutoConnect(bool autoConnect, uint serial)
+{
+    Q_Q(VpnConnection);
+
+    if (serial != m_autoConnectSerial) {
+        // Set locally or changed since the caller read it
+        qCDebug(lcConnman) << "Dropping stale AutoConnect of" << m_path;
+        if (!m_autoConnectKnown)
+            fetchAutoConnect();
+        return;
+    }
+
+    QVariantMap properties;
+    properties.insert(autoConnectKey, autoConnect);
+    m_autoConnectKnown = true;
+    q->update(MarshalUtils::propertiesToQml(properties));
+}
+
 void VpnConnectionPrivate::getProperties()
 {
     Q_Q(VpnConnection);
 
+    m_fetchPending = true;
+    const uint serial = m_autoConnectSerial;
     QDBusPendingCall servicePropertiesCall = m_serviceProxy.GetProperties();
     QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(servicePropertiesCall, q);
-    VpnConnection::connect(watcher, &QDBusPendingCallWatcher::finished, q, [q, this](QDBusPendingCallWatcher *watcher) {
+    VpnConnection::connect(watcher, &QDBusPendingCallWatcher::finished, q, [q, this, serial](QDBusPendingCallWatcher *watcher) {
         QDBusPendingReply<> reply = *watcher;
         if (reply.isFinished() && reply.isValid()) {
-            QDBusMessage message = reply.reply();
-            QVariantMap properties = MarshalUtils::demarshallArgument<QVariantMap>(message.arguments().value(0));
-            bool autoConnect = properties.value(autoConnectKey).toBool();
-            properties.clear();
-            properties.insert(autoConnectKey, autoConnect);
-            q->update(MarshalUtils::propertiesToQml(properties));
+            m_fetchPending = false;
+            if (serial != m_autoConnectSerial) {
+                // Set locally or changed meanwhile, the reply is stale
+                qCDebug(lcConnman) << "Dropping stale AutoConnect of" << m_path;
+                // A failed set needs the actual value
+                if (!m_autoConnectKnown)
+                    fetchAutoConnect();
+            } else {
+                QDBusMessage message = reply.reply();
+                QVariantMap properties = MarshalUtils::demarshallArgument<QVariantMap>(message.arguments().value(0));
+                bool autoConnect = properties.value(autoConnectKey).toBool();
+                properties.clear();
+                properties.insert(autoConnectKey, autoConnect);
+                m_autoConnectKnown = true;
+                q->update(MarshalUtils::propertiesToQml(properties));
+            }
             getPropertiesErrorHandler(QDBusError::NoError);
         } else {
             qCDebug(lcConnman) << "Error :" << m_path << " type :" << reply.error().type() << " : " << reply.error().message();
+            // Still pending while retrying
+            m_fetchPending = (reply.error().type() == QDBusError::UnknownObject);
             getPropertiesErrorHandler(reply.error().type());
         }
 
@@ -169,6 +337,14 @@ VpnConnection::VpnConnection(const QString &path, QObject *parent)
     d->init();
 }
 
+VpnConnection::VpnConnection(const QString &path, const QVariantMap &properties, QObject *parent)
+    : QObject(parent)
+    , d_ptr(new VpnConnectionPrivate(*this, path))
+{
+    Q_D(VpnConnection);
+    d->init(properties);
+}
+
 VpnConnection::VpnConnection(VpnConnectionPrivate &dd, QObject *parent)
     : QObject(parent)
     , d_ptr(&dd)
@@ -296,11 +472,31 @@ void VpnConnection::setAutoConnect(bool autoConnect)
 {
     Q_D(VpnConnection);
 
-    if (d->m_autoConnect != autoConnect) {
+    if (d->m_autoConnect != autoConnect || !d->m_autoConnectKnown) {
+        const bool changed = (d->m_autoConnect != autoConnect);
         d->m_autoConnect = autoConnect;
+        d->m_autoConnectKnown = true;
+        ++d->m_autoConnectSerial;
         qDebug() << "VPN autoconnect changed:" << d->m_properties.value("name").toString() << autoConnect;
-        d->m_serviceProxy.SetProperty(autoConnectKey, QDBusVariant(autoConnect));
-        emit autoConnectChanged();
+
+        QDBusPendingCall call = d->m_serviceProxy.SetProperty(autoConnectKey, QDBusVariant(autoConnect));
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *watcher) {
+            Q_D(VpnConnection);
+
+            QDBusPendingReply<> reply = *watcher;
+            watcher->deleteLater();
+            if (reply.isError()) {
+                // Re-read the actual value
+                qCDebug(lcConnman) << "Unable to set AutoConnect:" << d->m_path << reply.error().message();
+                d->m_autoConnectKnown = false;
+                ++d->m_autoConnectSerial;
+                d->fetchAutoConnect();
+            }
+        });
+
+        if (changed)
+            emit autoConnectChanged();
     }
 }
 
@@ -390,6 +586,116 @@ inline void VpnConnectionPrivate::updateVariable(QVariantMap &properties, QQueue
     }
 }
 
+// Single property updates from PropertyChanged, keyed by the D-Bus name
+QHash<QString, VpnConnectionPrivate::PropertyHandler> VpnConnectionPrivate::propertyHandlers()
+{
+    QHash<QString, PropertyHandler> rv;
+
+    rv.insert(QStringLiteral("Name"), { QStringLiteral("name"), &VpnConnectionPrivate::setValue, &VpnConnection::nameChanged });
+    rv.insert(QStringLiteral("Host"), { QStringLiteral("host"), &VpnConnectionPrivate::setValue, &VpnConnection::hostChanged });
+    rv.insert(QStringLiteral("Domain"), { QStringLiteral("domain"), &VpnConnectionPrivate::setValue, &VpnConnection::domainChanged });
+    rv.insert(QStringLiteral("StoreCredentials"), { QStringLiteral("storeCredentials"), &VpnConnectionPrivate::setValue, &VpnConnection::storeCredentialsChanged });
+    rv.insert(QStringLiteral("Type"), { QStringLiteral("type"), &VpnConnectionPrivate::setValue, &VpnConnection::typeChanged });
+    rv.insert(QStringLiteral("Immutable"), { QStringLiteral("immutable"), &VpnConnectionPrivate::setValue, &VpnConnection::immutableChanged });
+    rv.insert(QStringLiteral("Index"), { QStringLiteral("index"), &VpnConnectionPrivate::setValue, &VpnConnection::indexChanged });
+    rv.insert(QStringLiteral("IPv4"), { QStringLiteral("ipv4"), &VpnConnectionPrivate::setMap, &VpnConnection::ipv4Changed });
+    rv.insert(QStringLiteral("IPv6"), { QStringLiteral("ipv6"), &VpnConnectionPrivate::setMap, &VpnConnection::ipv6Changed });
+    rv.insert(QStringLiteral("Nameservers"), { QStringLiteral("nameservers"), &VpnConnectionPrivate::setValue, &VpnConnection::nameserversChanged });
+    rv.insert(QStringLiteral("UserRoutes"), { QStringLiteral("userRoutes"), &VpnConnectionPrivate::setConverted, &VpnConnection::userRoutesChanged });
+    rv.insert(QStringLiteral("ServerRoutes"), { QStringLiteral("serverRoutes"), &VpnConnectionPrivate::setConverted, &VpnConnection::serverRoutesChanged });
+    rv.insert(QStringLiteral("State"), { QStringLiteral("state"), &VpnConnectionPrivate::setState, &VpnConnection::stateChanged });
+    rv.insert(QStringLiteral("SplitRouting"), { QStringLiteral("splitRouting"), &VpnConnectionPrivate::setSplitRoutingValue, &VpnConnection::splitRoutingChanged });
+    rv.insert(autoConnectKey, { QStringLiteral("autoConnect"), &VpnConnectionPrivate::setAutoConnectValue, &VpnConnection::autoConnectChanged });
+
+    return rv;
+}
+
+void VpnConnectionPrivate::updateProperty(const QString &name, const QVariant &value)
+{
+    Q_Q(VpnConnection);
+
+    static const QHash<QString, PropertyHandler> handlers(propertyHandlers());
+
+    QHash<QString, PropertyHandler>::const_iterator it = handlers.constFind(name);
+    if (it == handlers.constEnd()) {
+        // Provider properties and anything else take the generic path
+        QVariantMap properties;
+        properties.insert(name, value);
+        q->update(MarshalUtils::propertiesToQml(properties));
+        return;
+    }
+
+    const VpnConnection::ConnectionState oldState(m_state);
+    if ((this->*(it->setter))(it->key, value)) {
+        emit (q->*(it->changedSignal))();
+        emit q->propertiesChanged();
+
+        if ((m_state == VpnConnection::Ready) != (oldState == VpnConnection::Ready)) {
+            emit q->connectedChanged();
+        }
+    }
+}
+
+bool VpnConnectionPrivate::setValue(const QString &key, const QVariant &value)
+{
+    QVariantMap::iterator it = m_properties.find(key);
+    if (it == m_properties.end()) {
+        m_properties.insert(key, value);
+        return true;
+    } else if (it.value() != value) {
+        it.value() = value;
+        return true;
+    }
+    return false;
+}
+
+bool VpnConnectionPrivate::setConverted(const QString &key, const QVariant &value)
+{
+    return setValue(key, MarshalUtils::convertToQml(key, value));
+}
+
+bool VpnConnectionPrivate::setMap(const QString &key, const QVariant &value)
+{
+    return setValue(key, MarshalUtils::demarshallArgument<QVariantMap>(value));
+}
+
+bool VpnConnectionPrivate::setState(const QString &key, const QVariant &value)
+{
+    const QVariant converted(MarshalUtils::convertToQml(key, value));
+    const VpnConnection::ConnectionState state(qvariant_cast<VpnConnection::ConnectionState>(converted));
+
+    m_properties.insert(key, converted);
+    if (m_state != state) {
+        m_state = state;
+        return true;
+    }
+    return false;
+}
+
+bool VpnConnectionPrivate::setAutoConnectValue(const QString &key, const QVariant &value)
+{
+    const bool autoConnect = value.toBool();
+
+    m_properties.insert(key, autoConnect);
+    if (m_autoConnect != autoConnect) {
+        m_autoConnect = autoConnect;
+        return true;
+    }
+    return false;
+}
+
+bool VpnConnectionPrivate::setSplitRoutingValue(const QString &key, const QVariant &value)
+{
+    const bool splitRouting = value.toBool();
+
+    m_properties.insert(key, splitRouting);
+    if (m_splitRouting != splitRouting) {
+        m_splitRouting = splitRouting;
+        return true;
+    }
+    return false;
+}
+
 void VpnConnectionPrivate::setProperty(const QString &key, const QVariant &value, void(VpnConnection::*changedSignal)())
 {
     Q_Q(VpnConnection);
@@ -402,3 +708,4 @@ void VpnConnectionPrivate::setProperty(const QString &key, const QVariant &value
     }
 }
 
+#include "vpnconnection.moc"
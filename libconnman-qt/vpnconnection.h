@@ -90,6 +90,9 @@ public:
 
     explicit VpnConnection(QObject *parent = nullptr);
     explicit VpnConnection(const QString &path, QObject *parent = nullptr);
+    // Creates a connection from a complete property map (in the form
+    // returned by MarshalUtils::propertiesToQml) without fetching it again
+    VpnConnection(const QString &path, const QVariantMap &properties, QObject *parent = nullptr);
     explicit VpnConnection(VpnConnectionPrivate &dd, QObject *parent);
     virtual ~VpnConnection();
 
@@ -33,6 +33,8 @@
 #ifndef VPNCONNECTION_P_H
 #define VPNCONNECTION_P_H
 
+#include <QHash>
+
 #include "connman_vpn_connection_interface.h"
 #include "connman_service_interface.h"
 
@@ -44,12 +46,38 @@ class VpnConnectionPrivate
 
 public:
     VpnConnectionPrivate(VpnConnection &qq, const QString &path);
+    ~VpnConnectionPrivate();
     void init();
+    void init(const QVariantMap &properties);
+    void fetchAutoConnect();
+    void seedAutoConnect(bool autoConnect, uint serial);
+    QString servicePath() const { return m_serviceProxy.path(); }
     void setProperty(const QString &key, const QVariant &value, void(VpnConnection::*changedSignal)());
     void checkChanged(QVariantMap &properties, QQueue<void(VpnConnection::*)()> &emissions, const QString &name, void(VpnConnection::*changedSignal)());
     template<typename T>
     void updateVariable(QVariantMap &properties, QQueue<void(VpnConnection::*)()> &emissions, const QString &name, T *property, void(VpnConnection::*changedSignal)());
 
+    void connectionPropertyChanged(const QString &name, const QVariant &value);
+    void servicePropertyChanged(const QString &name, const QVariant &value);
+    void updateProperty(const QString &name, const QVariant &value);
+
+    static VpnConnectionPrivate *get(VpnConnection *connection) { return connection->d_func(); }
+
+    typedef bool (VpnConnectionPrivate::*PropertySetter)(const QString &key, const QVariant &value);
+    struct PropertyHandler {
+        QString key;
+        PropertySetter setter;
+        void (VpnConnection::*changedSignal)();
+    };
+    static QHash<QString, PropertyHandler> propertyHandlers();
+
+    bool setValue(const QString &key, const QVariant &value);
+    bool setConverted(const QString &key, const QVariant &value);
+    bool setMap(const QString &key, const QVariant &value);
+    bool setState(const QString &key, const QVariant &value);
+    bool setAutoConnectValue(const QString &key, const QVariant &value);
+    bool setSplitRoutingValue(const QString &key, const QVariant &value);
+
 public:
     NetConnmanVpnConnectionInterface m_connectionProxy;
     NetConnmanServiceInterface m_serviceProxy;
@@ -58,6 +86,13 @@ public:
     bool m_splitRouting;
     VpnConnection::ConnectionState m_state;
     QVariantMap m_properties;
+    // AutoConnect lives in the ConnMan service and is not part of the
+    // connection payloads. VpnManager seeds it for the connections it
+    // creates, standalone connections fetch it at construction.
+    bool m_autoConnectKnown;
+    bool m_fetchPending;
+    // Bumped by local sets and change signals, older fetches are dropped
+    uint m_autoConnectSerial;
 
     VpnConnection *q_ptr;
 private:
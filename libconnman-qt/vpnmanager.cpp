@@ -30,8 +30,11 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
  */
 
+#include "commondbustypes.h"
 #include "marshalutils.h"
+#include "logging.h"
 #include "vpnconnection.h"
+#include "vpnconnection_p.h"
 
 #include "vpnmanager.h"
 #include "vpnmanager_p.h"
@@ -68,13 +71,16 @@ VpnManager* VpnManagerFactory::instance()
 
 namespace  {
 
+const QString connmanService = QStringLiteral("net.connman");
 const QString connmanVpnService = QStringLiteral("net.connman.vpn");
+const QString autoConnectKey = QStringLiteral("AutoConnect");
 
 } // Empty namespace
 
 VpnManagerPrivate::VpnManagerPrivate(VpnManager &qq)
     : m_connmanVpn(connmanVpnService, "/", QDBusConnection::systemBus(), nullptr)
     , m_populated(false)
+    , m_autoConnectQueued(false)
     , q_ptr(&qq)
 {
 }
@@ -85,21 +91,22 @@ void VpnManagerPrivate::init()
 
     qDBusRegisterMetaType<PathProperties>();
     qDBusRegisterMetaType<PathPropertiesArray>();
+    registerCommonDataTypes();
 
     VpnManager::connect(&m_connmanVpn, &NetConnmanVpnManagerInterface::ConnectionAdded,
                         q, [this](const QDBusObjectPath &objectPath, const QVariantMap &properties) {
         Q_Q(VpnManager);
 
         const QString path(objectPath.path());
+        QVariantMap qmlProperties(MarshalUtils::propertiesToQml(properties));
         VpnConnection *conn = q->connection(path);
         if (!conn) {
             qDebug() << "Adding connection:" << path;
-            conn = new VpnConnection(path);
-            m_items.append(conn);
+            appendConnection(new VpnConnection(path, qmlProperties));
+            fetchAutoConnectLater(path);
+        } else {
+            conn->update(qmlProperties);
         }
-
-        QVariantMap qmlProperties(MarshalUtils::propertiesToQml(properties));
-        conn->update(qmlProperties);
         emit q->connectionAdded(path);
         emit q->connectionsChanged();
     });
@@ -111,7 +118,7 @@ void VpnManagerPrivate::init()
         const QString path(objectPath.path());
         if (VpnConnection *conn = q->connection(path)) {
             qDebug() << "Removing obsolete connection:" << path;
-            m_items.removeOne(conn);
+            removeConnection(conn);
             conn->deleteLater();
         } else {
             qDebug() << "Unable to remove unknown connection:" << path;
@@ -125,22 +132,20 @@ void VpnManagerPrivate::init()
         }
     });
 
-    // If connman-vpn restarts, we need to discard and re-read the state
+    // If connman-vpn restarts, the connections are kept until the daemon
+    // comes back and the state is re-read. fetchVpnList() then reconciles
+    // the existing objects with the new list. Meanwhile they are idle, a
+    // connection can't be up without the daemon.
     QDBusServiceWatcher *watcher
             = new QDBusServiceWatcher(connmanVpnService, QDBusConnection::systemBus(),
                                       QDBusServiceWatcher::WatchForRegistration
                                       | QDBusServiceWatcher::WatchForUnregistration,
                                       q);
     VpnManager::connect(watcher, &QDBusServiceWatcher::serviceUnregistered, q, [this](const QString &) {
-        Q_Q(VpnManager);
-
-        emit beginConnectionsReset();
-        qDeleteAll(m_items);
-        m_items.clear();
-        emit endConnectionsReset();
+        const QVector<VpnConnection*> items(m_items);
+        for (VpnConnection *conn : items)
+            VpnConnectionPrivate::get(conn)->updateProperty(QStringLiteral("State"), QStringLiteral("idle"));
         setPopulated(false);
-
-        emit q->connectionsCleared();
     });
     VpnManager::connect(watcher, &QDBusServiceWatcher::serviceRegistered, q, [this](const QString &) {
         fetchVpnList();
@@ -288,27 +293,14 @@ VpnConnection *VpnManager::connection(const QString &path) const
 {
     Q_D(const VpnManager);
 
-    for (VpnConnection *connection : d->m_items) {
-        if (connection->path() == path) {
-            return connection;
-        }
-    }
-
-    return nullptr;
+    return d->m_itemsByPath.value(path, nullptr);
 }
 
 int VpnManager::indexOf(const QString &path) const
 {
     Q_D(const VpnManager);
 
-    int i = 0;
-    while (i < d->m_items.size()) {
-        if (d->m_items.at(i)->path() == path) {
-            return i;
-        }
-    }
-
-    return -1;
+    return d->m_itemIndex.value(path, -1);
 }
 
 QVector<VpnConnection*> VpnManager::connections() const
@@ -347,25 +339,159 @@ void VpnManagerPrivate::fetchVpnList()
             qDebug() << "Unable to fetch Connman VPN connections:" << reply.error().message();
         } else {
             const PathPropertiesArray &connections(reply.value());
-
+            const bool hadConnections = !m_items.isEmpty();
+            // Signals may have been missed while connman-vpn was away
+            const bool restarted = hadConnections && !m_populated;
+            QSet<QString> fetched;
+            QStringList added;
+            QStringList removed;
+
+            // Existing connections are updated in place, only the ones that
+            // are new or gone get created or deleted
             for (const PathProperties &connection : connections) {
                 const QString &path(connection.first.path());
                 const QVariantMap &properties(connection.second);
 
                 QVariantMap qmlProperties(MarshalUtils::propertiesToQml(properties));
 
-                VpnConnection *conn = new VpnConnection(path);
-                m_items.append(conn);
-                conn->update(qmlProperties);
+                VpnConnection *conn = q->connection(path);
+                if (!conn) {
+                    appendConnection(new VpnConnection(path, qmlProperties));
+                    fetchAutoConnectLater(path);
+                    added.append(path);
+                } else {
+                    conn->update(qmlProperties);
+                    if (restarted)
+                        fetchAutoConnectLater(path);
+                }
+                fetched.insert(path);
+            }
+
+            const QVector<VpnConnection*> items(m_items);
+            for (VpnConnection *conn : items) {
+                if (!fetched.contains(conn->path())) {
+                    qDebug() << "Removing obsolete connection:" << conn->path();
+                    removed.append(conn->path());
+                    removeConnection(conn);
+                    conn->deleteLater();
+                }
+            }
+
+            if (hadConnections) {
+                for (const QString &path : added)
+                    emit q->connectionAdded(path);
+                for (const QString &path : removed)
+                    emit q->connectionRemoved(path);
             }
             emit q->connectionsChanged();
             emit q->connectionsRefreshed();
+
+            if (hadConnections && m_items.isEmpty()) {
+                emit q->connectionsCleared();
+            }
         }
 
         setPopulated(true);
     });
 }
 
+void VpnManagerPrivate::fetchAutoConnectLater(const QString &path)
+{
+    // Connections tend to be added in groups, read them all at once
+    m_autoConnectPending.insert(path);
+    if (!m_autoConnectQueued) {
+        m_autoConnectQueued = true;
+        QMetaObject::invokeMethod(this, "fetchAutoConnect", Qt::QueuedConnection);
+    }
+}
+
+void VpnManagerPrivate::fetchAutoConnect()
+{
+    Q_Q(VpnManager);
+
+    m_autoConnectQueued = false;
+
+    // Replies older than a local set or a change signal are dropped
+    QHash<QString, uint> serials;
+    for (const QString &path : m_autoConnectPending) {
+        if (VpnConnection *conn = q->connection(path))
+            serials.insert(path, VpnConnectionPrivate::get(conn)->m_autoConnectSerial);
+    }
+    m_autoConnectPending.clear();
+    if (serials.isEmpty())
+        return;
+
+    // AutoConnect lives in the ConnMan services of the connections, one
+    // GetServices covers all of them
+    QDBusMessage message(QDBusMessage::createMethodCall(connmanService, "/",
+            "net.connman.Manager", "GetServices"));
+    QDBusPendingCall call = QDBusConnection::systemBus().asyncCall(message);
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, q);
+    q->connect(watcher, &QDBusPendingCallWatcher::finished,
+               q, [this, serials](QDBusPendingCallWatcher *watcher) {
+        Q_Q(VpnManager);
+
+        QDBusPendingReply<ConnmanObjectList> reply = *watcher;
+        watcher->deleteLater();
+
+        QHash<QString, bool> autoConnect;
+        if (reply.isError()) {
+            qCDebug(lcConnman) << "Unable to fetch the VPN services:" << reply.error().message();
+        } else {
+            const ConnmanObjectList services(reply.value());
+            for (const ConnmanObject &service : services) {
+                if (service.objpath.path().contains(QLatin1String("/vpn_")))
+                    autoConnect.insert(service.objpath.path(), service.properties.value(autoConnectKey).toBool());
+            }
+        }
+
+        for (QHash<QString, uint>::ConstIterator it = serials.constBegin(); it != serials.constEnd(); ++it) {
+            VpnConnection *conn = q->connection(it.key());
+            if (!conn)
+                continue;
+
+            VpnConnectionPrivate *connection = VpnConnectionPrivate::get(conn);
+            QHash<QString, bool>::ConstIterator service = autoConnect.constFind(connection->servicePath());
+            if (service != autoConnect.constEnd()) {
+                connection->seedAutoConnect(service.value(), it.value());
+            } else {
+                // The service may not be there yet, the connection retries
+                // on its own
+                connection->fetchAutoConnect();
+            }
+        }
+    });
+}
+
+void VpnManagerPrivate::appendConnection(VpnConnection *connection)
+{
+    const QString path(connection->path());
+
+    m_itemIndex.insert(path, m_items.size());
+    m_itemsByPath.insert(path, connection);
+    m_items.append(connection);
+}
+
+bool VpnManagerPrivate::removeConnection(VpnConnection *connection)
+{
+    const QString path(connection->path());
+    const int index = m_itemIndex.value(path, -1);
+
+    if (index < 0 || m_items.at(index) != connection)
+        return false;
+
+    m_items.remove(index);
+    m_itemsByPath.remove(path);
+    m_itemIndex.remove(path);
+
+    // Shift the positions of the connections that followed
+    for (int i = index; i < m_items.size(); ++i)
+        m_itemIndex.insert(m_items.at(i)->path(), i);
+
+    return true;
+}
+
 void VpnManagerPrivate::setPopulated(bool populated)
 {
     Q_Q(VpnManager);
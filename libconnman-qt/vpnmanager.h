@@ -90,6 +90,9 @@ signals:
     void connectionAdded(const QString &path);
     void connectionRemoved(const QString &path);
     void connectionsRefreshed();
+    // When the last connection has been removed. The connections are kept
+    // while connman-vpn is away, they turn idle and populated goes false
+    // until the list has been fetched again.
     void connectionsCleared();
     void populatedChanged();
 
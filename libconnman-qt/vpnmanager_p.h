@@ -33,6 +33,9 @@
 #ifndef VPNMANAGER_P_H
 #define VPNMANAGER_P_H
 
+#include <QHash>
+#include <QSet>
+
 #include "connman_vpn_manager_interface.h"
 
 #include "vpnmanager.h"
@@ -46,19 +49,28 @@ public:
     VpnManagerPrivate(VpnManager &qq);
     void init();
     void fetchVpnList();
+    void fetchAutoConnectLater(const QString &path);
     void setPopulated(bool populated);
 
+    void appendConnection(VpnConnection *connection);
+    bool removeConnection(VpnConnection *connection);
+
     static VpnManagerPrivate *get(VpnManager *manager) { return manager->d_func(); }
     static const VpnManagerPrivate *get(const VpnManager *manager) { return manager->d_func(); }
 
-Q_SIGNALS:
-    void beginConnectionsReset();
-    void endConnectionsReset();
+public Q_SLOTS:
+    void fetchAutoConnect();
 
 public:
     NetConnmanVpnManagerInterface m_connmanVpn;
     QVector<VpnConnection*> m_items;
+    // Path lookups, kept in sync with m_items
+    QHash<QString, VpnConnection*> m_itemsByPath;
+    QHash<QString, int> m_itemIndex;
     bool m_populated;
+    // Connections waiting for their AutoConnect, read in one batch
+    QSet<QString> m_autoConnectPending;
+    bool m_autoConnectQueued;
 
     VpnManager *q_ptr;
 };
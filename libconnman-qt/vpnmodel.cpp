@@ -37,8 +37,6 @@
 #include "vpnmodel.h"
 #include "vpnmodel_p.h"
 
-#include "vpnmanager_p.h"
-
 const QHash<int, QByteArray> VpnModelPrivate::m_roles({{VpnModel::VpnRole, "vpnService"}});
 
 // ==========================================================================
@@ -62,17 +60,6 @@ void VpnModelPrivate::init()
     VpnModel::connect(m_manager.data(), &VpnManager::connectionsChanged, q, &VpnModel::connectionsChanged);
     VpnModel::connect(m_manager.data(), &VpnManager::populatedChanged, q, &VpnModel::populatedChanged);
 
-    VpnModel::connect(VpnManagerPrivate::get(m_manager.data()), &VpnManagerPrivate::beginConnectionsReset,
-                      q, [q, this]() {
-        q->beginResetModel();
-        m_connections.clear();
-    });
-
-    VpnModel::connect(VpnManagerPrivate::get(m_manager.data()), &VpnManagerPrivate::endConnectionsReset,
-                      q, [q]() {
-        q->endResetModel();
-    });
-
     q->connectionsChanged();
 }
 
@@ -22,6 +22,8 @@
 #include "useragent.h"
 #include "networksession.h"
 #include "counter.h"
+#include "counterhistory.h"
+#include "counterhistorymodel.h"
 #include "vpnmanager.h"
 #include "vpnconnection.h"
 #include "vpnmodel.h"
@@ -81,6 +83,8 @@ void ConnmanPlugin::registerTypes(const char *uri)
     qmlRegisterType<DeclarativeNetworkManagerFactory>(uri, 0, 2, "NetworkManagerFactory");
     qmlRegisterType<NetworkTechnology>(uri, 0, 2, "NetworkTechnology");
     qmlRegisterType<Counter>(uri, 0, 2, "NetworkCounter");
+    qmlRegisterType<CounterHistory>(uri, 0, 2, "NetworkCounterHistory");
+    qmlRegisterType<CounterHistoryModel>(uri, 0, 2, "NetworkCounterHistoryModel");
     qmlRegisterSingletonType<VpnManager>(uri, 0, 2, "VpnManager", singleton_api_factory<VpnManager>);
     qmlRegisterType<VpnConnection>(uri, 0, 2, "VpnConnection");
     qmlRegisterSingletonType<VpnModel>(uri, 0, 2, "VpnModel", singleton_api_factory<VpnModel>);
@@ -4,11 +4,19 @@ TEMPLATE = subdirs
 SUBDIRS = \
     ut_agent.pro \
     ut_clock.pro \
+    ut_counter.pro \
+    ut_counterhistory.pro \
     ut_manager.pro \
+    ut_proxyexcludes.pro \
     ut_service.pro \
+    ut_servicedecoder.pro \
+    ut_servicerecord.pro \
     ut_session.pro \
     ut_technology.pro \
 
+# PAC support is left out with CONFIG+=nopac
+!nopac: SUBDIRS += ut_pac.pro
+
 runtest_sh.path = $${INSTALL_TESTDIR}
 runtest_sh.files = runtest.sh
 INSTALLS += runtest_sh
@@ -25,6 +25,8 @@ private slots:
     void testProperties();
     void testRequestInput();
     void testRequestInputCanceledByUser();
+    void testRequestInputSuperseded();
+    void testCredentialProvider();
     void testCancel();
     void testReportError();
     void testConnectionRequestType();
@@ -57,6 +59,8 @@ public:
             const QDBusObjectPath &service, const QVariantMap &fields, const QDBusMessage &message);
     Q_SCRIPTABLE QVariantMap mock_requestInputExpectCancel(const QDBusObjectPath &agentPath,
             const QDBusObjectPath &service, const QVariantMap &fields, const QDBusMessage &message);
+    Q_SCRIPTABLE QVariantMap mock_requestInputTwice(const QDBusObjectPath &agentPath,
+            const QDBusObjectPath &service, const QVariantMap &fields, const QDBusMessage &message);
     Q_SCRIPTABLE void mock_cancel(const QDBusObjectPath &agentPath,
             const QDBusObjectPath &service, const QVariantMap &fields, const QDBusMessage &message);
     Q_SCRIPTABLE void mock_reportError(const QDBusObjectPath &agentPath,
@@ -181,6 +185,100 @@ void UtAgent::testRequestInputCanceledByUser()
     QCOMPARE(reply.error().name(), QString("net.connman.Agent.Error.Canceled"));
 }
 
+void UtAgent::testRequestInputSuperseded()
+{
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+
+    SignalSpy userInputRequestedSpy(m_userAgent, SIGNAL(userInputRequested(QString,QVariantMap)));
+    SignalSpy requestCanceledSpy(m_userAgent, SIGNAL(requestCanceled(QString)));
+
+    const QDBusObjectPath injectedService = QDBusObjectPath("/foo");
+    QVariantMap injectedFields;
+    injectedFields["passphrase"] = QVariantMap();
+
+    QDBusPendingReply<QVariantMap> reply = manager.asyncCall("mock_requestInputTwice",
+            QVariant::fromValue(QDBusObjectPath(m_userAgent->path())),
+            QVariant::fromValue(injectedService), injectedFields);
+
+    while (userInputRequestedSpy.count() < 2)
+        QVERIFY(waitForSignal(&userInputRequestedSpy));
+
+    QCOMPARE(requestCanceledSpy.count(), 1);
+    QCOMPARE(requestCanceledSpy.at(0).at(0).toString(), QString("/foo"));
+
+    QVariantMap sentFields;
+    sentFields["passphrase"] = "myPassphrase";
+
+    m_userAgent->sendUserReply("/foo", sentFields);
+
+    reply.waitForFinished();
+    QVERIFY(reply.isValid());
+    QCOMPARE(reply.value(), sentFields);
+}
+
+namespace {
+
+class TestCredentialProvider : public UserAgentCredentialProvider
+{
+public:
+    QVariantMap credentials(const QString &servicePath,
+                            const QVector<UserAgentField> &fields) override
+    {
+        QVariantMap input;
+        for (const UserAgentField &field : fields) {
+            if (servicePath == "/foo" && field.name == "Passphrase" && field.type == "psk")
+                input[field.name] = "provisioned";
+        }
+        return input;
+    }
+};
+
+} // namespace
+
+void UtAgent::testCredentialProvider()
+{
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+
+    SignalSpy userInputRequestedSpy(m_userAgent, SIGNAL(userInputRequested(QString,QVariantMap)));
+
+    TestCredentialProvider provider;
+    m_userAgent->setCredentialProvider(&provider);
+
+    QVariantMap mandatory;
+    mandatory["Type"] = "psk";
+    mandatory["Requirement"] = "mandatory";
+    QVariantMap injectedFields;
+    injectedFields["Passphrase"] = mandatory;
+
+    QDBusPendingReply<QVariantMap> reply = manager.asyncCall("mock_requestInput",
+            QVariant::fromValue(QDBusObjectPath(m_userAgent->path())),
+            QVariant::fromValue(QDBusObjectPath("/foo")), injectedFields);
+
+    QDBusPendingCallWatcher watcher(reply);
+    QVERIFY(waitForSignal(&watcher, SIGNAL(finished(QDBusPendingCallWatcher*))));
+    QVERIFY(reply.isValid());
+    QCOMPARE(reply.value().value("Passphrase").toString(), QString("provisioned"));
+    QCOMPARE(userInputRequestedSpy.count(), 0);
+
+    // Nothing provisioned, falls back to the user
+    reply = manager.asyncCall("mock_requestInput",
+            QVariant::fromValue(QDBusObjectPath(m_userAgent->path())),
+            QVariant::fromValue(QDBusObjectPath("/bar")), injectedFields);
+
+    QVERIFY(waitForSignal(&userInputRequestedSpy));
+    QCOMPARE(userInputRequestedSpy.at(0).at(0).toString(), QString("/bar"));
+
+    QVariantMap sentFields;
+    sentFields["Passphrase"] = "typed";
+    m_userAgent->sendUserReply("/bar", sentFields);
+
+    reply.waitForFinished();
+    QVERIFY(reply.isValid());
+    QCOMPARE(reply.value(), sentFields);
+
+    m_userAgent->setCredentialProvider(nullptr);
+}
+
 void UtAgent::testCancel()
 {
     QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
@@ -405,6 +503,35 @@ QVariantMap UtAgent::ManagerMock::mock_requestInputExpectCancel(const QDBusObjec
     return reply.value();
 }
 
+QVariantMap UtAgent::ManagerMock::mock_requestInputTwice(const QDBusObjectPath &agentPath,
+        const QDBusObjectPath &service, const QVariantMap &fields, const QDBusMessage &message)
+{
+    QDBusInterface agent(message.service(), agentPath.path(), "net.connman.Agent", bus());
+    QDBusPendingReply<QVariantMap> first = agent.asyncCall("RequestInput",
+            QVariant::fromValue(service), fields);
+    QDBusPendingReply<QVariantMap> second = agent.asyncCall("RequestInput",
+            QVariant::fromValue(service), fields);
+
+    first.waitForFinished();
+    if (first.isValid() || first.error().name() != "net.connman.Agent.Error.Canceled") {
+        const QString err = QString("The superseded RequestInput() was not canceled");
+        qWarning("%s: %s", Q_FUNC_INFO, qPrintable(err));
+        bus().send(message.createErrorReply(QDBusError::Failed, err));
+        return QVariantMap();
+    }
+
+    second.waitForFinished();
+    if (!second.isValid()) {
+        const QString err = QString("Error calling RequestInput() on agent: %1")
+            .arg(second.error().message());
+        qWarning("%s: %s", Q_FUNC_INFO, qPrintable(err));
+        bus().send(message.createErrorReply(QDBusError::Failed, err));
+        return QVariantMap();
+    }
+
+    return second.value();
+}
+
 void UtAgent::ManagerMock::mock_cancel(const QDBusObjectPath &agentPath,
         const QDBusObjectPath &service, const QVariantMap &fields, const QDBusMessage &message)
 {
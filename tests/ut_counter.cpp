@@ -0,0 +1,413 @@
+#include <QtCore/QElapsedTimer>
+
+#include "../libconnman-qt/counter.h"
+#include "testbase.h"
+
+namespace Tests {
+
+class UtCounter : public TestBase
+{
+    Q_OBJECT
+
+    enum {
+        QUOTA = 10000000,
+    };
+
+public:
+    class ManagerMock;
+
+private slots:
+    void initTestCase();
+
+    void testSharedRegistration();
+    void testCoalescedUpdate();
+    void testContinuousValues();
+    void testHysteresis();
+    void testPerService();
+    void testQuota();
+
+private:
+    static void start(Counter *counter, quint32 accuracy, quint32 interval);
+    static void startAdaptive(Counter *counter, quint32 maximumInterval);
+    static bool report(Counter *counter, const QString &servicePath, quint64 rxBytes, quint64 txBytes = 0);
+    static quint64 rxBytes(const QSignalSpy &spy);
+    static quint32 registeredInterval();
+    static quint32 mockValue(const QString &method);
+    static void resetRegistrations();
+};
+
+class UtCounter::ManagerMock : public MainObjectMock
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "net.connman.Manager")
+
+public:
+    ManagerMock();
+
+public:
+    Q_SCRIPTABLE QVariantMap GetProperties() const;
+    Q_SCRIPTABLE ConnmanObjectList GetTechnologies() const;
+    Q_SCRIPTABLE ConnmanObjectList GetServices() const;
+    Q_SCRIPTABLE void RegisterCounter(const QDBusObjectPath &path, quint32 accuracy, quint32 period,
+            const QDBusMessage &message);
+    Q_SCRIPTABLE void UnregisterCounter(const QDBusObjectPath &path);
+
+    // mock API
+    Q_SCRIPTABLE quint32 mock_counterAccuracy() const;
+    Q_SCRIPTABLE quint32 mock_counterPeriod() const;
+    Q_SCRIPTABLE quint32 mock_registerCount() const;
+    Q_SCRIPTABLE quint32 mock_unregisterCount() const;
+    Q_SCRIPTABLE void mock_resetCounts();
+    Q_SCRIPTABLE void mock_usage(const QString &servicePath, qulonglong rxBytes, qulonglong txBytes);
+
+signals:
+    Q_SCRIPTABLE void PropertyChanged(const QString &name, const QDBusVariant &value);
+
+private:
+    QString m_counterService;
+    QString m_counterPath;
+    quint32 m_counterAccuracy;
+    quint32 m_counterPeriod;
+    quint32 m_registerCount;
+    quint32 m_unregisterCount;
+};
+
+} // namespace Tests
+
+using namespace Tests;
+
+/*
+ * \class Tests::UtCounter
+ */
+
+void UtCounter::initTestCase()
+{
+    QVERIFY(waitForService("net.connman", "/", "net.connman.Manager"));
+}
+
+void UtCounter::testSharedRegistration()
+{
+    resetRegistrations();
+
+    // One registration for both, with the smallest values
+    Counter slow;
+    slow.setAccuracy(10); // kB
+    slow.setInterval(3);
+    slow.setRunning(true);
+    Counter fast;
+    start(&fast, 1, 1);
+    QTRY_VERIFY(slow.running());
+
+    QCOMPARE(mockValue("mock_registerCount"), 1u);
+    QCOMPARE(mockValue("mock_counterAccuracy"), 1u);
+    QCOMPARE(mockValue("mock_counterPeriod"), 1u);
+
+    // Each gets the reports at its own rate. The first report goes to
+    // both, then the slow one only gets the merged values once its
+    // interval has passed, the bytes stay below its accuracy.
+    const QString service("/service/shared");
+    QSignalSpy slowSpy(&slow, SIGNAL(counterChanged(QString,QVariantMap,bool)));
+    QSignalSpy fastSpy(&fast, SIGNAL(counterChanged(QString,QVariantMap,bool)));
+    QVERIFY(report(&fast, service, 0));
+    QTRY_COMPARE(slowSpy.count(), 1);
+    QVERIFY(report(&fast, service, 2048));
+    QVERIFY(report(&fast, service, 4096));
+    QVERIFY(report(&fast, service, 6144));
+    QCOMPARE(fastSpy.count(), 4);
+    QCOMPARE(slowSpy.count(), 1);
+
+    QTRY_COMPARE(slowSpy.count(), 2);
+    QCOMPARE(rxBytes(slowSpy), quint64(6144));
+    QCOMPARE(fastSpy.count(), 4);
+    QCOMPARE(mockValue("mock_registerCount"), 1u);
+}
+
+void UtCounter::testCoalescedUpdate()
+{
+    Counter counter;
+    start(&counter, 1, 1);
+    resetRegistrations();
+
+    // Changed one after another, registered again once
+    counter.setAccuracy(2);
+    counter.setInterval(2);
+    QTRY_COMPARE(mockValue("mock_registerCount"), 1u);
+    QTest::qWait(200);
+
+    QCOMPARE(mockValue("mock_unregisterCount"), 1u);
+    QCOMPARE(mockValue("mock_registerCount"), 1u);
+    QCOMPARE(mockValue("mock_counterAccuracy"), 2u);
+    QCOMPARE(mockValue("mock_counterPeriod"), 2u);
+    QVERIFY(counter.running());
+}
+
+void UtCounter::testContinuousValues()
+{
+    Counter counter;
+    start(&counter, 1, 1);
+
+    const QString service("/service/continuous");
+    QSignalSpy spy(&counter, SIGNAL(counterChanged(QString,QVariantMap,bool)));
+    QVERIFY(report(&counter, service, 100000));
+    QCOMPARE(rxBytes(spy), quint64(100000));
+
+    // ConnMan starts over from zero after the re-registration, the
+    // values continue from where they were
+    counter.setInterval(2);
+    QTRY_COMPARE(registeredInterval(), 2u);
+
+    QVERIFY(report(&counter, service, 5000));
+    QCOMPARE(rxBytes(spy), quint64(105000));
+    QVERIFY(report(&counter, service, 8000));
+    QCOMPARE(rxBytes(spy), quint64(108000));
+    QCOMPARE(counter.bytesReceived(), quint64(108000));
+}
+
+void UtCounter::testHysteresis()
+{
+    Counter counter;
+    startAdaptive(&counter, 8);
+
+    const QString service("/service/hysteresis");
+    QVERIFY(report(&counter, service, 0));
+
+    // Doubled only after three idle reports in a row
+    QVERIFY(report(&counter, service, 100));
+    QVERIFY(report(&counter, service, 200));
+    QCOMPARE(counter.effectiveInterval(), 1u);
+    QVERIFY(report(&counter, service, 300));
+    QCOMPARE(counter.effectiveInterval(), 2u);
+    QTRY_COMPARE(registeredInterval(), 2u);
+
+    // Halved only after two busy reports in a row
+    QVERIFY(report(&counter, service, 300 + 2048));
+    QCOMPARE(counter.effectiveInterval(), 2u);
+    QVERIFY(report(&counter, service, 300 + 2048 + 512)); // neither
+    QVERIFY(report(&counter, service, 300 + 2048 + 512 + 2048));
+    QCOMPARE(counter.effectiveInterval(), 2u);
+    QVERIFY(report(&counter, service, 300 + 2048 + 512 + 4096));
+    QCOMPARE(counter.effectiveInterval(), 1u);
+    QTRY_COMPARE(registeredInterval(), 1u);
+}
+
+void UtCounter::testPerService()
+{
+    Counter counter;
+    startAdaptive(&counter, 8);
+
+    // The bytes of the services are not mixed, a busy service keeps the
+    // interval down while another one is idle
+    const QString busy("/service/busy");
+    const QString idle("/service/idle");
+    QVERIFY(report(&counter, busy, 1000000));
+    QVERIFY(report(&counter, idle, 10));
+    QVERIFY(report(&counter, busy, 1002048));
+    QVERIFY(report(&counter, idle, 20));
+    QVERIFY(report(&counter, idle, 30));
+    QVERIFY(report(&counter, idle, 40));
+    QCOMPARE(counter.effectiveInterval(), 1u);
+
+    QVERIFY(report(&counter, busy, 1002048));
+    QVERIFY(report(&counter, idle, 50));
+    QCOMPARE(counter.effectiveInterval(), 2u);
+}
+
+void UtCounter::testQuota()
+{
+    Counter counter;
+    startAdaptive(&counter, 2);
+
+    const QString first("/service/quota1");
+    const QString second("/service/quota2");
+    QVERIFY(report(&counter, first, 0));
+    QVERIFY(report(&counter, first, 100));
+    QVERIFY(report(&counter, first, 200));
+    QVERIFY(report(&counter, first, 300));
+    QCOMPARE(counter.effectiveInterval(), 2u);
+
+    // Counted from when the quota is set, over all the services
+    counter.setQuota(QUOTA);
+    QCOMPARE(counter.quotaUsed(), quint64(0));
+
+    QTest::qWait(2500); // slow enough not to reach the quota within the interval
+    QVERIFY(report(&counter, first, 300 + QUOTA * 45 / 100));
+    QCOMPARE(counter.quotaUsed(), quint64(QUOTA * 45 / 100));
+    QCOMPARE(counter.effectiveInterval(), 2u);
+
+    QVERIFY(report(&counter, second, 5000000000ULL));
+    QCOMPARE(counter.quotaUsed(), quint64(QUOTA * 45 / 100));
+    QVERIFY(report(&counter, second, 5000000000ULL, QUOTA * 45 / 100));
+    QCOMPARE(counter.quotaUsed(), quint64(QUOTA * 90 / 100));
+    QCOMPARE(counter.effectiveInterval(), 1u);
+    QTRY_COMPARE(registeredInterval(), 1u);
+
+    // A new quota starts over
+    counter.setQuota(2 * QUOTA);
+    QCOMPARE(counter.quotaUsed(), quint64(0));
+}
+
+void UtCounter::start(Counter *counter, quint32 accuracy, quint32 interval)
+{
+    counter->setAccuracy(accuracy); // kB
+    counter->setInterval(interval);
+    counter->setRunning(true);
+    QTRY_VERIFY(counter->running());
+}
+
+void UtCounter::startAdaptive(Counter *counter, quint32 maximumInterval)
+{
+    counter->setAccuracy(1); // kB
+    counter->setMinimumInterval(1);
+    counter->setMaximumInterval(maximumInterval);
+    counter->setAdaptive(true);
+    counter->setRunning(true);
+    QTRY_VERIFY(counter->running());
+    QCOMPARE(counter->effectiveInterval(), 1u);
+}
+
+// Waits until the report is passed on to the counter
+bool UtCounter::report(Counter *counter, const QString &servicePath, quint64 rxBytes, quint64 txBytes)
+{
+    QSignalSpy spy(counter, SIGNAL(counterChanged(QString,QVariantMap,bool)));
+
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+    QDBusReply<void> reply = manager.call("mock_usage", servicePath, qulonglong(rxBytes), qulonglong(txBytes));
+    if (!reply.isValid()) {
+        qWarning() << reply.error();
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!timer.hasExpired(SIGNAL_WAIT_TIMEOUT)) {
+        for (const QList<QVariant> &arguments : spy) {
+            if (arguments.at(0).toString() == servicePath)
+                return true;
+        }
+        spy.wait(100);
+    }
+    return false;
+}
+
+// RX.Bytes of the latest report the spy has seen
+quint64 UtCounter::rxBytes(const QSignalSpy &spy)
+{
+    return spy.isEmpty() ? 0 : spy.last().at(1).toMap().value("RX.Bytes").toULongLong();
+}
+
+quint32 UtCounter::registeredInterval()
+{
+    return mockValue("mock_counterPeriod");
+}
+
+quint32 UtCounter::mockValue(const QString &method)
+{
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+    QDBusReply<quint32> reply = manager.call(method);
+    return reply.isValid() ? reply.value() : 0;
+}
+
+void UtCounter::resetRegistrations()
+{
+    // Let the counters of the previous tests go first
+    QTest::qWait(100);
+
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+    QDBusReply<void> reply = manager.call("mock_resetCounts");
+    QVERIFY2(reply.isValid(), qPrintable(reply.error().message()));
+}
+
+/*
+ * \class Tests::UtCounter::ManagerMock
+ */
+
+UtCounter::ManagerMock::ManagerMock()
+    : MainObjectMock("net.connman", "/"),
+      m_counterAccuracy(0),
+      m_counterPeriod(0),
+      m_registerCount(0),
+      m_unregisterCount(0)
+{
+}
+
+QVariantMap UtCounter::ManagerMock::GetProperties() const
+{
+    return defaultManagerProperties();
+}
+
+ConnmanObjectList UtCounter::ManagerMock::GetTechnologies() const
+{
+    return ConnmanObjectList();
+}
+
+ConnmanObjectList UtCounter::ManagerMock::GetServices() const
+{
+    return ConnmanObjectList();
+}
+
+void UtCounter::ManagerMock::RegisterCounter(const QDBusObjectPath &path, quint32 accuracy,
+        quint32 period, const QDBusMessage &message)
+{
+    m_counterService = message.service();
+    m_counterPath = path.path();
+    m_counterAccuracy = accuracy;
+    m_counterPeriod = period;
+    m_registerCount++;
+}
+
+void UtCounter::ManagerMock::UnregisterCounter(const QDBusObjectPath &path)
+{
+    if (path.path() == m_counterPath) {
+        m_counterPath.clear();
+        m_counterAccuracy = 0;
+        m_counterPeriod = 0;
+        m_unregisterCount++;
+    }
+}
+
+quint32 UtCounter::ManagerMock::mock_counterAccuracy() const
+{
+    return m_counterAccuracy;
+}
+
+quint32 UtCounter::ManagerMock::mock_counterPeriod() const
+{
+    return m_counterPeriod;
+}
+
+quint32 UtCounter::ManagerMock::mock_registerCount() const
+{
+    return m_registerCount;
+}
+
+quint32 UtCounter::ManagerMock::mock_unregisterCount() const
+{
+    return m_unregisterCount;
+}
+
+void UtCounter::ManagerMock::mock_resetCounts()
+{
+    m_registerCount = 0;
+    m_unregisterCount = 0;
+}
+
+void UtCounter::ManagerMock::mock_usage(const QString &servicePath, qulonglong rxBytes, qulonglong txBytes)
+{
+    if (m_counterPath.isEmpty()) {
+        qWarning("%s: No counter registered", Q_FUNC_INFO);
+        return;
+    }
+
+    QVariantMap home;
+    home["RX.Bytes"] = QVariant::fromValue<quint64>(rxBytes);
+    home["TX.Bytes"] = QVariant::fromValue<quint64>(txBytes);
+
+    QDBusMessage usage = QDBusMessage::createMethodCall(m_counterService, m_counterPath,
+            "net.connman.Counter", "Usage");
+    usage << QVariant::fromValue(QDBusObjectPath(servicePath)) << home << QVariantMap();
+    bus().send(usage);
+}
+
+TEST_MAIN_WITH_MOCK(UtCounter, UtCounter::ManagerMock)
+
+#include "ut_counter.moc"
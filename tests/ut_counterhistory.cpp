@@ -0,0 +1,295 @@
+#include <QtCore/QRegularExpression>
+#include <QtCore/QTemporaryDir>
+
+#include "../libconnman-qt/counterhistory.h"
+#include "../libconnman-qt/counterhistoryfile.h"
+#include "testbase.h"
+
+namespace Tests {
+
+class UtCounterHistory : public TestBase
+{
+    Q_OBJECT
+
+    enum {
+        ROLLUP_MONTH = 200001,
+    };
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testHeaderValidation_data();
+    void testHeaderValidation();
+    void testCompact();
+    void testRollupEviction();
+    void testServiceSlotReuse();
+    void testRestoreOutOfOrder();
+    void testLocking();
+
+private:
+    static CounterHistoryFile::Record record(qint64 timestamp, quint64 rxBytes, int service = 0);
+    QString storagePath() const;
+
+private:
+    QTemporaryDir *m_dir;
+};
+
+} // namespace Tests
+
+using namespace Tests;
+
+/*
+ * \class Tests::UtCounterHistory
+ */
+
+void UtCounterHistory::init()
+{
+    m_dir = new QTemporaryDir;
+    QVERIFY(m_dir->isValid());
+}
+
+void UtCounterHistory::cleanup()
+{
+    delete m_dir;
+    m_dir = nullptr;
+}
+
+void UtCounterHistory::testHeaderValidation_data()
+{
+    QTest::addColumn<qint64>("offset");
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<bool>("truncate");
+    QTest::addColumn<bool>("kept");
+
+    const quint32 records = 1000000;
+    const quint32 services = 65;
+
+    QTest::newRow("valid") << qint64(0) << QByteArray() << false << true;
+    QTest::newRow("magic") << qint64(0) << QByteArray("XMNHIST1") << false << false;
+    QTest::newRow("version") << qint64(8) << QByteArray("\x02\0\0\0", 4) << false << false;
+    QTest::newRow("record size") << qint64(12) << QByteArray("\x10\0\0\0", 4) << false << false;
+    QTest::newRow("service count") << qint64(16)
+            << QByteArray(reinterpret_cast<const char *>(&services), 4) << false << false;
+    QTest::newRow("record count") << qint64(20)
+            << QByteArray(reinterpret_cast<const char *>(&records), 4) << false << false;
+    QTest::newRow("size") << qint64(0) << QByteArray() << true << false;
+}
+
+void UtCounterHistory::testHeaderValidation()
+{
+    QFETCH(qint64, offset);
+    QFETCH(QByteArray, data);
+    QFETCH(bool, truncate);
+    QFETCH(bool, kept);
+
+    {
+        CounterHistoryFile file;
+        QVERIFY(file.open(storagePath()));
+        QCOMPARE(file.serviceIndex("/service/a"), 0);
+        file.append(record(1000, 10));
+        file.append(record(2000, 20));
+    }
+
+    QFile raw(storagePath());
+    QVERIFY(raw.open(QIODevice::ReadWrite));
+    if (!data.isEmpty()) {
+        QVERIFY(raw.seek(offset));
+        QCOMPARE(raw.write(data), qint64(data.size()));
+    }
+    if (truncate)
+        QVERIFY(raw.resize(raw.size() - 1));
+    raw.close();
+
+    CounterHistoryFile file;
+    QVERIFY(file.open(storagePath()));
+    if (kept) {
+        QCOMPARE(file.services(), QStringList() << "/service/a");
+        QCOMPARE(file.recordCount(), 2);
+        QCOMPARE(file.record(1).timestamp, qint64(2000));
+        QCOMPARE(file.record(1).rxBytes, quint64(20));
+    } else {
+        // Initialized again, not read out of bounds
+        QCOMPARE(file.services(), QStringList());
+        QCOMPARE(file.recordCount(), 0);
+    }
+}
+
+void UtCounterHistory::testCompact()
+{
+    CounterHistoryFile file;
+    QVERIFY(file.open(storagePath()));
+    QCOMPARE(file.serviceIndex("/service/a"), 0);
+
+    const int capacity = file.recordCapacity();
+    QVERIFY(capacity > 0);
+    for (int i = 0; i < capacity; ++i)
+        file.append(record(i, i));
+    QCOMPARE(file.recordCount(), capacity);
+
+    // The older half is dropped, the rest moved to the start
+    file.append(record(capacity, capacity));
+    QCOMPARE(file.recordCount(), capacity / 2 + 1);
+    for (int i = 0; i < file.recordCount(); ++i) {
+        QCOMPARE(file.record(i).timestamp, qint64(capacity / 2 + i));
+        QCOMPARE(file.record(i).rxBytes, quint64(capacity / 2 + i));
+    }
+
+    // And the same after mapping it again
+    file.close();
+    QVERIFY(file.open(storagePath()));
+    QCOMPARE(file.recordCount(), capacity / 2 + 1);
+    QCOMPARE(file.record(0).timestamp, qint64(capacity / 2));
+    QCOMPARE(file.record(capacity / 2).timestamp, qint64(capacity));
+}
+
+void UtCounterHistory::testRollupEviction()
+{
+    CounterHistoryFile file;
+    QVERIFY(file.open(storagePath()));
+
+    const int capacity = file.rollupCapacity();
+    QVERIFY(capacity > 0);
+
+    // Fill the table in reverse, the oldest month isn't in the first slot
+    for (int i = capacity - 1; i >= 0; --i) {
+        CounterHistoryFile::Rollup *rollup = file.rollup(0, false, ROLLUP_MONTH + i);
+        QVERIFY(rollup);
+        rollup->rxBytes = i + 1;
+    }
+
+    // Another month replaces the oldest one
+    CounterHistoryFile::Rollup *rollup = file.rollup(0, false, ROLLUP_MONTH + capacity);
+    QVERIFY(rollup);
+    QCOMPARE(rollup->rxBytes, quint64(0));
+    rollup->rxBytes = capacity + 1;
+
+    QList<quint32> months;
+    for (int i = 0; i < capacity; ++i) {
+        QVERIFY(file.rollup(i).used);
+        months.append(file.rollup(i).month);
+    }
+    QVERIFY(!months.contains(ROLLUP_MONTH));
+    QVERIFY(months.contains(ROLLUP_MONTH + 1));
+    QVERIFY(months.contains(ROLLUP_MONTH + capacity));
+
+    // The others are kept, also after mapping the file again
+    file.close();
+    QVERIFY(file.open(storagePath()));
+    QCOMPARE(file.rollup(0, false, ROLLUP_MONTH + 1)->rxBytes, quint64(2));
+    QCOMPARE(file.rollup(0, false, ROLLUP_MONTH + capacity)->rxBytes, quint64(capacity + 1));
+}
+
+void UtCounterHistory::testServiceSlotReuse()
+{
+    CounterHistoryFile file;
+    QVERIFY(file.open(storagePath()));
+
+    int services = 0;
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("Not storing the counter history of"));
+    while (file.serviceIndex(QString("/service/%1").arg(services)) >= 0)
+        ++services;
+    QVERIFY(services > 3);
+
+    // All referenced, the first one and the rest by records, the second
+    // one by its totals
+    file.append(record(0, 1, 0));
+    QVERIFY(file.rollup(1, false, ROLLUP_MONTH));
+    for (int i = 2; i < services; ++i)
+        file.append(record(i, 1, i));
+
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("Not storing the counter history of"));
+    QCOMPARE(file.serviceIndex("/service/new"), -1);
+
+    // The compaction drops all records but the ones of the third service
+    for (int i = file.recordCount(); i <= file.recordCapacity(); ++i)
+        file.append(record(services + i, 1, 2));
+    QCOMPARE(file.record(0).service, quint16(2));
+
+    // The slots are taken in order, the totals keep the second one
+    QCOMPARE(file.serviceIndex("/service/new"), 0);
+    QCOMPARE(file.serviceIndex("/service/another"), 3);
+    QCOMPARE(file.serviceIndex("/service/new"), 0);
+    QCOMPARE(file.services().count(), services);
+    QCOMPARE(file.services().at(0), QString("/service/new"));
+    QCOMPARE(file.services().at(1), QString("/service/1"));
+
+    file.close();
+    QVERIFY(file.open(storagePath()));
+    QCOMPARE(file.services().count(), services);
+    QCOMPARE(file.services().at(0), QString("/service/new"));
+    QCOMPARE(file.services().at(3), QString("/service/another"));
+}
+
+void UtCounterHistory::testRestoreOutOfOrder()
+{
+    {
+        CounterHistoryFile file;
+        QVERIFY(file.open(storagePath()));
+        QCOMPARE(file.serviceIndex("/service/a"), 0);
+        QCOMPARE(file.serviceIndex("/service/b"), 1);
+        file.append(record(1000, 100));
+        file.append(record(2000, 200));
+        file.append(record(1500, 150)); // left over from a compaction
+        file.append(record(1200, 50, 1));
+        file.append(record(3000, 300));
+        file.append(record(99, 1, 2)); // unknown service
+    }
+
+    CounterHistory history;
+    history.setStoragePath(storagePath());
+
+    QCOMPARE(history.services(), QStringList() << "/service/a" << "/service/b");
+    QCOMPARE(history.count("/service/a"), 3);
+    QCOMPARE(history.sample("/service/a", 0).timestamp, qint64(1000));
+    QCOMPARE(history.sample("/service/a", 1).timestamp, qint64(2000));
+    QCOMPARE(history.sample("/service/a", 2).timestamp, qint64(3000));
+    QCOMPARE(history.count("/service/b"), 1);
+
+    // The search by time works on the restored series
+    const QVector<CounterSample> samples(history.samples("/service/a", 1500, 3000));
+    QCOMPARE(samples.count(), 1);
+    QCOMPARE(samples.first().rxBytes, quint64(200));
+}
+
+void UtCounterHistory::testLocking()
+{
+    CounterHistoryFile first;
+    QVERIFY(first.open(storagePath()));
+    QCOMPARE(first.serviceIndex("/service/a"), 0);
+    first.append(record(1000, 10));
+
+    // Not shared with another writer
+    CounterHistoryFile second;
+    QTest::ignoreMessage(QtWarningMsg, QRegularExpression("is in use by another process"));
+    QVERIFY(!second.open(storagePath()));
+    QVERIFY(!second.isOpen());
+    QCOMPARE(second.recordCount(), 0);
+    QCOMPARE(second.serviceIndex("/service/b"), -1);
+
+    first.close();
+    QVERIFY(second.open(storagePath()));
+    QCOMPARE(second.recordCount(), 1);
+}
+
+CounterHistoryFile::Record UtCounterHistory::record(qint64 timestamp, quint64 rxBytes, int service)
+{
+    CounterHistoryFile::Record record;
+    record.timestamp = timestamp;
+    record.rxBytes = rxBytes;
+    record.txBytes = 0;
+    record.seconds = 0;
+    record.service = quint16(service);
+    record.roaming = 0;
+    record.reserved = 0;
+    return record;
+}
+
+QString UtCounterHistory::storagePath() const
+{
+    return m_dir->path() + "/counters/history";
+}
+
+QTEST_GUILESS_MAIN(Tests::UtCounterHistory)
+
+#include "ut_counterhistory.moc"
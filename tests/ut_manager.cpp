@@ -1,4 +1,5 @@
 #include <QtCore/QPointer>
+#include <QtCore/QThread>
 
 #include "../libconnman-qt/networkmanager.h"
 #include "testbase.h"
@@ -34,6 +35,10 @@ private slots:
     void testAddedTechnologyProperties();
     void testAvailabilityChanged();
     void testServiceRemoved();
+    void testServiceFilters();
+    void testServiceFilterUpdate();
+    void testServiceAccounting();
+    void testSnapshot();
     void testTechnologyRemoved();
     void testRegisterCounter();
 
@@ -66,6 +71,8 @@ public:
     Q_SCRIPTABLE void mock_addService(const QString &path, const QVariantMap &properties,
             const QDBusMessage &message);
     Q_SCRIPTABLE void mock_removeService(const QString &path, const QDBusMessage &message);
+    Q_SCRIPTABLE void mock_setServiceProperty(const QString &path, const QString &name,
+            const QDBusVariant &value, const QDBusMessage &message);
     Q_SCRIPTABLE void mock_addTechnology(const QString &path, const QVariantMap &properties,
             const QDBusMessage &message);
     Q_SCRIPTABLE void mock_removeTechnology(const QString &path, const QDBusMessage &message);
@@ -101,6 +108,18 @@ public:
 
     QVariantMap properties() const { return m_properties; }
 
+    void setProperty(const QString &name, const QVariant &value)
+    {
+        m_properties[name] = value;
+        Q_EMIT PropertyChanged(name, QDBusVariant(value));
+    }
+
+public:
+    Q_SCRIPTABLE QVariantMap GetProperties() const { return m_properties; }
+
+signals:
+    Q_SCRIPTABLE void PropertyChanged(const QString &name, const QDBusVariant &value);
+
 private:
     QVariantMap m_properties;
 };
@@ -220,6 +239,11 @@ void UtManager::testServiceAdded()
     const QVector<NetworkService *> services = m_manager->getServices();
     QCOMPARE(services.count(), 1);
     QCOMPARE(services.at(0)->path(), injectedServicePath);
+    QCOMPARE(services.at(0)->name(), injectedServiceProperties["Name"].toString());
+
+    // Created from the record, the rest of the properties follow
+    QVERIFY(waitForSignal(services.at(0), SIGNAL(propertiesReady())));
+    QCOMPARE(services.at(0)->nameservers(), injectedServiceProperties["Nameservers"].toStringList());
 
     QCOMPARE(m_manager->servicesList(injectedServiceType), QStringList() << injectedServicePath);
 }
@@ -329,6 +353,192 @@ void UtManager::testServiceRemoved()
     QCOMPARE(services.count(), 0);
 }
 
+void UtManager::testServiceFilters()
+{
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+
+    const QString injectedServicePath = "/service_filtered";
+    const QVariantMap injectedServiceProperties = defaultServiceProperties();
+
+    m_manager->setServiceFilters(NetworkServiceFilter::List()
+            << NetworkServiceFilter::minimumStrength(injectedServiceProperties["Strength"].toUInt() + 1));
+
+    QDBusPendingReply<> reply = manager.asyncCall("mock_addService", injectedServicePath,
+            injectedServiceProperties);
+
+    QDBusPendingCallWatcher watcher(reply);
+    QVERIFY(waitForSignal(&watcher, SIGNAL(finished(QDBusPendingCallWatcher*))));
+    QVERIFY(reply.isValid());
+
+    QCOMPARE(m_manager->getServices().count(), 0);
+
+    // Restoring the default filters lets the service through with
+    // the properties reported when it was added
+    SignalSpy serviceAddedSpy(m_manager, SIGNAL(serviceAdded(QString)));
+
+    m_manager->setServiceFilters(NetworkServiceFilter::defaultFilters());
+
+    QCOMPARE(serviceAddedSpy.count(), 1);
+    QCOMPARE(serviceAddedSpy.at(0).at(0).toString(), injectedServicePath);
+
+    const QVector<NetworkService *> services = m_manager->getServices();
+    QCOMPARE(services.count(), 1);
+    QCOMPARE(services.at(0)->name(), injectedServiceProperties["Name"].toString());
+
+    SignalSpy serviceRemovedSpy(m_manager, SIGNAL(serviceRemoved(QString)));
+
+    reply = manager.asyncCall("mock_removeService", injectedServicePath);
+
+    QVERIFY(waitForSignal(&serviceRemovedSpy));
+    QCOMPARE(m_manager->getServices().count(), 0);
+}
+
+void UtManager::testServiceFilterUpdate()
+{
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+
+    const QString injectedServicePath = "/service_strength";
+    const QVariantMap injectedServiceProperties = defaultServiceProperties();
+    const uint strength = injectedServiceProperties["Strength"].toUInt();
+
+    m_manager->setServiceFilters(NetworkServiceFilter::List()
+            << NetworkServiceFilter::minimumStrength(strength + 1));
+
+    QDBusPendingReply<> reply = manager.asyncCall("mock_addService", injectedServicePath,
+            injectedServiceProperties);
+
+    QDBusPendingCallWatcher watcher(reply);
+    QVERIFY(waitForSignal(&watcher, SIGNAL(finished(QDBusPendingCallWatcher*))));
+    QVERIFY(reply.isValid());
+
+    QCOMPARE(m_manager->servicesList(QString()), QStringList());
+
+    // A hidden service shows up once it gets strong enough, without
+    // another ServicesChanged
+    SignalSpy serviceAddedSpy(m_manager, SIGNAL(serviceAdded(QString)));
+    SignalSpy servicesChangedSpy(m_manager, SIGNAL(servicesChanged()));
+
+    reply = manager.asyncCall("mock_setServiceProperty", injectedServicePath, "Strength",
+            QVariant::fromValue(QDBusVariant(QVariant::fromValue<uchar>(strength + 10))));
+
+    QVERIFY(waitForSignal(&serviceAddedSpy));
+    QCOMPARE(serviceAddedSpy.at(0).at(0).toString(), injectedServicePath);
+    QVERIFY(servicesChangedSpy.count() > 0);
+    QCOMPARE(m_manager->servicesList(QString()), QStringList() << injectedServicePath);
+
+    // And goes away when it gets weak again
+    SignalSpy serviceRemovedSpy(m_manager, SIGNAL(serviceRemoved(QString)));
+
+    reply = manager.asyncCall("mock_setServiceProperty", injectedServicePath, "Strength",
+            QVariant::fromValue(QDBusVariant(QVariant::fromValue<uchar>(strength - 10))));
+
+    QVERIFY(waitForSignal(&serviceRemovedSpy));
+    QCOMPARE(serviceRemovedSpy.at(0).at(0).toString(), injectedServicePath);
+    QCOMPARE(m_manager->servicesList(QString()), QStringList());
+
+    m_manager->setServiceFilters(NetworkServiceFilter::defaultFilters());
+    QCOMPARE(m_manager->servicesList(QString()), QStringList() << injectedServicePath);
+
+    serviceRemovedSpy.clear();
+    reply = manager.asyncCall("mock_removeService", injectedServicePath);
+
+    QVERIFY(waitForSignal(&serviceRemovedSpy));
+    QCOMPARE(m_manager->servicesList(QString()), QStringList());
+}
+
+void UtManager::testServiceAccounting()
+{
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+
+    const QString injectedServicePath = "/service_accounted";
+    const QVariantMap injectedServiceProperties = defaultServiceProperties();
+
+    SignalSpy serviceAddedSpy(m_manager, SIGNAL(serviceAdded(QString)));
+
+    QDBusPendingReply<> reply = manager.asyncCall("mock_addService", injectedServicePath,
+            injectedServiceProperties);
+
+    QVERIFY(waitForSignal(&serviceAddedSpy));
+    QCOMPARE(serviceAddedSpy.at(0).at(0).toString(), injectedServicePath);
+
+    // Listed with the record only
+    QCOMPARE(m_manager->serviceObjectCount(), 0);
+    QCOMPARE(m_manager->servicesList(QString()), QStringList() << injectedServicePath);
+    const qint64 recordUsage = m_manager->serviceMemoryUsage(injectedServicePath);
+    QVERIFY(recordUsage > 0);
+    QCOMPARE(m_manager->serviceMemoryUsage(), recordUsage);
+
+    // The object is counted on top of the record, with the properties it
+    // has fetched by itself
+    const QVector<NetworkService *> services = m_manager->getServices();
+    QCOMPARE(services.count(), 1);
+    QCOMPARE(m_manager->serviceObjectCount(), 1);
+    const qint64 objectUsage = m_manager->serviceMemoryUsage(injectedServicePath);
+    QVERIFY(objectUsage > recordUsage);
+
+    QVERIFY(waitForSignal(services.at(0), SIGNAL(propertiesReady())));
+    QVERIFY(m_manager->serviceMemoryUsage(injectedServicePath) > objectUsage);
+    QCOMPARE(m_manager->serviceMemoryUsage(), m_manager->serviceMemoryUsage(injectedServicePath));
+
+    SignalSpy serviceRemovedSpy(m_manager, SIGNAL(serviceRemoved(QString)));
+
+    reply = manager.asyncCall("mock_removeService", injectedServicePath);
+
+    QVERIFY(waitForSignal(&serviceRemovedSpy));
+    QCOMPARE(m_manager->serviceObjectCount(), 0);
+    QCOMPARE(m_manager->serviceMemoryUsage(injectedServicePath), Q_INT64_C(0));
+    QCOMPARE(m_manager->serviceMemoryUsage(), Q_INT64_C(0));
+}
+
+void UtManager::testSnapshot()
+{
+    struct Reader : public QThread
+    {
+        Reader(NetworkManager *manager) : m_manager(manager) {}
+        void run() override { m_snapshot = m_manager->snapshot(); }
+
+        NetworkManager *m_manager;
+        NetworkSnapshot m_snapshot;
+    };
+
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+
+    const QString injectedServicePath = "/service_snapshot";
+    const QVariantMap injectedServiceProperties = defaultServiceProperties();
+
+    SignalSpy serviceAddedSpy(m_manager, SIGNAL(serviceAdded(QString)));
+
+    QDBusPendingReply<> reply = manager.asyncCall("mock_addService", injectedServicePath,
+            injectedServiceProperties);
+
+    QVERIFY(waitForSignal(&serviceAddedSpy));
+
+    // Published once the update has been applied
+    QTRY_COMPARE(m_manager->snapshot().service(injectedServicePath).path, injectedServicePath);
+
+    Reader reader(m_manager);
+    reader.start();
+    QVERIFY(reader.wait());
+
+    const NetworkSnapshot snapshot(reader.m_snapshot);
+    QVERIFY(snapshot.serial() > 0);
+    QCOMPARE(snapshot.state(), m_manager->state());
+    QCOMPARE(snapshot.offlineMode(), m_manager->offlineMode());
+    QCOMPARE(snapshot.technologies().count(), m_manager->getTechnologies().count());
+    QCOMPARE(snapshot.service(injectedServicePath).name, injectedServiceProperties["Name"].toString());
+    QVERIFY(snapshot.service("/no_such_service").path.isEmpty());
+
+    SignalSpy serviceRemovedSpy(m_manager, SIGNAL(serviceRemoved(QString)));
+
+    reply = manager.asyncCall("mock_removeService", injectedServicePath);
+
+    QVERIFY(waitForSignal(&serviceRemovedSpy));
+    QTRY_VERIFY(m_manager->snapshot().service(injectedServicePath).path.isEmpty());
+
+    // Taken snapshots don't change
+    QCOMPARE(snapshot.service(injectedServicePath).path, injectedServicePath);
+}
+
 void UtManager::testTechnologyRemoved()
 {
     QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
@@ -528,6 +738,20 @@ void UtManager::ManagerMock::mock_removeService(const QString &path, const QDBus
     Q_EMIT ServicesChanged(ConnmanObjectList(), QList<QDBusObjectPath>() << QDBusObjectPath(path));
 }
 
+void UtManager::ManagerMock::mock_setServiceProperty(const QString &path, const QString &name,
+        const QDBusVariant &value, const QDBusMessage &message)
+{
+    ServiceMock *const service = m_services.value(path);
+    if (!service) {
+        const QString err = QString("Service at path '%1' does not exist").arg(path);
+        qWarning("%s: %s", Q_FUNC_INFO, qPrintable(err));
+        bus().send(message.createErrorReply(QDBusError::Failed, err));
+        return;
+    }
+
+    service->setProperty(name, value.variant());
+}
+
 void UtManager::ManagerMock::mock_addTechnology(const QString &path, const QVariantMap &properties,
         const QDBusMessage &message)
 {
@@ -0,0 +1,174 @@
+#include "../libconnman-qt/connmanpacresolver.h"
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QTemporaryFile>
+#include <QtTest/QTest>
+
+namespace Tests {
+
+class UtPac : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void testParseResult();
+    void testQueryProxy_data();
+    void testQueryProxy();
+    void testSocketQuery();
+    void testMissingScript();
+    void testRunawayScript();
+    void benchmarkCachedQuery();
+
+private:
+    static QString firstProxy(const QList<QNetworkProxy> &proxies);
+
+private:
+    QTemporaryFile m_script;
+    QScopedPointer<ConnmanPacResolver> m_resolver;
+};
+
+void UtPac::initTestCase()
+{
+    QVERIFY(m_script.open());
+    m_script.write(
+        "function FindProxyForURL(url, host) {\n"
+        "    if (isPlainHostName(host) || dnsDomainIs(host, '.local'))\n"
+        "        return 'DIRECT';\n"
+        "    if (/^\\d+\\.\\d+\\.\\d+\\.\\d+$/.test(host) && isInNet(host, '10.0.0.0', '255.0.0.0'))\n"
+        "        return 'SOCKS5 socks.example.com';\n"
+        "    if (shExpMatch(url, 'ftp:*'))\n"
+        "        return 'PROXY ftp.example.com:2121';\n"
+        "    if (shExpMatch(host, '*.example.?om'))\n"
+        "        return 'PROXY proxy.example.com:3128; SOCKS socks.example.com:1081; DIRECT';\n"
+        "    return 'PROXY proxy.example.com';\n"
+        "}\n");
+    m_script.flush();
+
+    m_resolver.reset(new ConnmanPacResolver(QUrl::fromLocalFile(m_script.fileName())));
+
+    // Nothing is cached while the script is being loaded
+    QTRY_COMPARE(firstProxy(m_resolver->queryProxy(QNetworkProxyQuery(QUrl("http://foo.org/")))),
+                 QString("http://proxy.example.com:8080"));
+}
+
+void UtPac::testParseResult()
+{
+    const QList<QNetworkProxy> proxies(ConnmanPacResolver::parseResult(
+            " PROXY  a.org:81;socks b.org; HTTPS c.org:443; SOCKS4 d.org; DIRECT; PROXY [::1]:3128; bogus"));
+
+    QCOMPARE(proxies.count(), 4);
+    QCOMPARE(proxies.at(0).type(), QNetworkProxy::HttpProxy);
+    QCOMPARE(proxies.at(0).hostName(), QString("a.org"));
+    QCOMPARE(proxies.at(0).port(), quint16(81));
+    QCOMPARE(proxies.at(1).type(), QNetworkProxy::Socks5Proxy);
+    QCOMPARE(proxies.at(1).hostName(), QString("b.org"));
+    QCOMPARE(proxies.at(1).port(), quint16(1080));
+    QCOMPARE(proxies.at(2).type(), QNetworkProxy::NoProxy);
+    QCOMPARE(proxies.at(3).hostName(), QString("::1"));
+    QCOMPARE(proxies.at(3).port(), quint16(3128));
+}
+
+void UtPac::testQueryProxy_data()
+{
+    QTest::addColumn<QString>("url");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("plain") << "http://intranet/index.html" << "";
+    QTest::newRow("local") << "https://printer.local/" << "";
+    QTest::newRow("net") << "http://10.1.2.3:8000/" << "socks5://socks.example.com:1080";
+    QTest::newRow("scheme") << "ftp://files.org/pub" << "http://ftp.example.com:2121";
+    QTest::newRow("pattern") << "http://www.example.com/" << "http://proxy.example.com:3128";
+    QTest::newRow("default") << "https://www.jolla.com/" << "http://proxy.example.com:8080";
+}
+
+void UtPac::testQueryProxy()
+{
+    QFETCH(QString, url);
+    QFETCH(QString, expected);
+
+    // Second round comes from the cache
+    for (int i = 0; i < 2; ++i)
+        QCOMPARE(firstProxy(m_resolver->queryProxy(QNetworkProxyQuery(QUrl(url)))), expected);
+}
+
+void UtPac::testSocketQuery()
+{
+    // HTTP proxies can't be used for listening or UDP
+    const QList<QNetworkProxy> proxies(m_resolver->queryProxy(
+            QNetworkProxyQuery(quint16(0), QString(), QNetworkProxyQuery::TcpServer)));
+    QCOMPARE(firstProxy(proxies), QString());
+
+    const QList<QNetworkProxy> udp(m_resolver->queryProxy(
+            QNetworkProxyQuery("www.example.com", 53, QString(), QNetworkProxyQuery::UdpSocket)));
+    QCOMPARE(udp.count(), 2);
+    QCOMPARE(firstProxy(udp), QString("socks5://socks.example.com:1081"));
+    QCOMPARE(udp.at(1).type(), QNetworkProxy::NoProxy);
+}
+
+void UtPac::testMissingScript()
+{
+    ConnmanPacResolver resolver(QUrl::fromLocalFile(m_script.fileName() + ".missing"));
+    QTRY_COMPARE(firstProxy(resolver.queryProxy(QNetworkProxyQuery(QUrl("http://foo.org/")))), QString());
+}
+
+void UtPac::testRunawayScript()
+{
+#if QT_VERSION < QT_VERSION_CHECK(5,14,0)
+    QSKIP("Scripts can't be interrupted");
+#endif
+    QTemporaryFile script;
+    QVERIFY(script.open());
+    script.write(
+        "function FindProxyForURL(url, host) {\n"
+        "    while (host == 'loop.org') {}\n"
+        "    return 'PROXY proxy.example.com';\n"
+        "}\n");
+    script.flush();
+
+    QScopedPointer<ConnmanPacResolver> resolver(new ConnmanPacResolver(QUrl::fromLocalFile(script.fileName())));
+    QTRY_COMPARE(firstProxy(resolver->queryProxy(QNetworkProxyQuery(QUrl("http://foo.org/")))),
+                 QString("http://proxy.example.com:8080"));
+
+    // Times out with a direct connection and gets interrupted
+    QElapsedTimer timer;
+    timer.start();
+    QCOMPARE(firstProxy(resolver->queryProxy(QNetworkProxyQuery(QUrl("http://loop.org/")))), QString());
+    QVERIFY(timer.elapsed() < 10000);
+    QTRY_COMPARE(firstProxy(resolver->queryProxy(QNetworkProxyQuery(QUrl("http://bar.org/")))),
+                 QString("http://proxy.example.com:8080"));
+
+    // The engine thread isn't joined
+    timer.restart();
+    resolver.reset();
+    QVERIFY(timer.elapsed() < 1000);
+}
+
+void UtPac::benchmarkCachedQuery()
+{
+    const QNetworkProxyQuery query(QUrl("http://www.example.com/some/page.html"));
+    m_resolver->queryProxy(query);
+
+    QBENCHMARK {
+        m_resolver->queryProxy(query);
+    }
+}
+
+QString UtPac::firstProxy(const QList<QNetworkProxy> &proxies)
+{
+    if (proxies.isEmpty() || proxies.first().type() == QNetworkProxy::NoProxy)
+        return QString();
+
+    const QNetworkProxy &proxy = proxies.first();
+    return QString("%1://%2:%3")
+        .arg(proxy.type() == QNetworkProxy::Socks5Proxy ? "socks5" : "http")
+        .arg(proxy.hostName())
+        .arg(proxy.port());
+}
+
+} // namespace Tests
+
+QTEST_GUILESS_MAIN(Tests::UtPac)
+
+#include "ut_pac.moc"
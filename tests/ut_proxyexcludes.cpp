@@ -0,0 +1,92 @@
+#include "../libconnman-qt/connmanproxyexcludes.h"
+
+#include <QtTest/QTest>
+
+namespace Tests {
+
+class UtProxyExcludes : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testMatches_data();
+    void testMatches();
+    void testQuery();
+    void testEverything();
+    void benchmarkMatches();
+};
+
+void UtProxyExcludes::testMatches_data()
+{
+    QTest::addColumn<QString>("host");
+    QTest::addColumn<bool>("excluded");
+
+    QTest::newRow("localhost") << "localhost" << true;
+    QTest::newRow("localhost.") << "LocalHost." << true;
+    QTest::newRow("domain") << "example.com" << true;
+    QTest::newRow("subdomain") << "www.intra.example.com" << true;
+    QTest::newRow("other domain") << "example.org" << false;
+    QTest::newRow("suffix only") << "badexample.com" << false;
+    QTest::newRow("dotted domain") << "corp.net" << true;
+    QTest::newRow("dotted subdomain") << "mail.corp.net" << true;
+    QTest::newRow("wildcard domain") << "jolla.org" << false;
+    QTest::newRow("wildcard subdomain") << "build.jolla.org" << true;
+    QTest::newRow("parent") << "org" << false;
+    QTest::newRow("ipv4") << "192.168.1.5" << true;
+    QTest::newRow("ipv4 other") << "192.168.1.6" << false;
+    QTest::newRow("ipv4 subnet") << "10.20.30.40" << true;
+    QTest::newRow("ipv4 outside") << "11.0.0.1" << false;
+    QTest::newRow("ipv6") << "::1" << true;
+    QTest::newRow("ipv6 subnet") << "fe80::1234" << true;
+    QTest::newRow("ipv6 outside") << "2001:db8::1" << false;
+    QTest::newRow("empty") << "" << false;
+}
+
+void UtProxyExcludes::testMatches()
+{
+    QFETCH(QString, host);
+    QFETCH(bool, excluded);
+
+    const ConnmanProxyExcludes excludes(QStringList()
+            << "localhost" << "Example.com" << " .corp.net" << "*.jolla.org" << "foo*.bar"
+            << "192.168.1.5" << "10.0.0.0/8" << "::1" << "fe80::/10");
+
+    QCOMPARE(excludes.matches(host), excluded);
+}
+
+void UtProxyExcludes::testQuery()
+{
+    const ConnmanProxyExcludes excludes(QStringList() << "example.com");
+
+    QVERIFY(excludes.matches(QNetworkProxyQuery(QUrl("https://www.example.com:8443/index.html"))));
+    QVERIFY(!excludes.matches(QNetworkProxyQuery(QUrl("https://www.example.org/"))));
+    QVERIFY(excludes.matches(QNetworkProxyQuery("example.com", 22)));
+    QVERIFY(!excludes.matches(QNetworkProxyQuery(quint16(8080))));
+}
+
+void UtProxyExcludes::testEverything()
+{
+    QVERIFY(ConnmanProxyExcludes().isEmpty());
+    QVERIFY(!ConnmanProxyExcludes().matches("localhost"));
+    QVERIFY(ConnmanProxyExcludes(QStringList() << "*").matches("example.com"));
+    QVERIFY(ConnmanProxyExcludes(QStringList() << "*").matches("127.0.0.1"));
+}
+
+void UtProxyExcludes::benchmarkMatches()
+{
+    QStringList list;
+    for (int i = 0; i < 1000; ++i)
+        list << QString("host%1.domain%2.example.com").arg(i).arg(i % 10);
+    const ConnmanProxyExcludes excludes(list);
+    const QString host("www.host999.domain9.example.com");
+
+    QBENCHMARK {
+        excludes.matches(host);
+    }
+}
+
+} // namespace Tests
+
+QTEST_GUILESS_MAIN(Tests::UtProxyExcludes)
+
+#include "ut_proxyexcludes.moc"
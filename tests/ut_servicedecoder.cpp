@@ -0,0 +1,342 @@
+#include <QtCore/QAtomicPointer>
+#include <QtCore/QThread>
+
+#include "../libconnman-qt/networkmanager.h"
+#include "../libconnman-qt/networkservicedecoder.h"
+#include "../libconnman-qt/networksnapshot.h"
+#include "testbase.h"
+
+namespace Tests {
+
+class UtServiceDecoder : public TestBase
+{
+    Q_OBJECT
+
+    enum {
+        SERVICE_COUNT = 20,
+        GENERATION = 7,
+        FLUSH_DELAY = 50, // [ms] as in the decoder
+    };
+
+public:
+    class ManagerMock;
+    class ServiceMock;
+
+signals:
+    void changesReceived();
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testThreadHandOff();
+    void testFlushCoalescing();
+    void testStaleGeneration();
+    void testForegroundSwitch();
+
+private slots:
+    void onChangesReady(const NetworkServiceChanges::Ref &changes);
+
+private:
+    static QString servicePath(int index);
+    static QObject *managerPrivate(NetworkManager *manager);
+    void setStrength(const QList<int> &indices, int strength, int steps);
+
+private:
+    QThread *m_thread;
+    NetworkServiceDecoder *m_decoder;
+    QAtomicPointer<QThread> m_emitter;
+    QList<NetworkServiceChanges::Ref> m_changes;
+};
+
+class UtServiceDecoder::ManagerMock : public MainObjectMock
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "net.connman.Manager")
+
+public:
+    ManagerMock();
+
+public:
+    Q_SCRIPTABLE QVariantMap GetProperties() const;
+    Q_SCRIPTABLE ConnmanObjectList GetTechnologies() const;
+    Q_SCRIPTABLE ConnmanObjectList GetServices() const;
+
+    // mock API
+    Q_SCRIPTABLE void mock_setStrength(const QStringList &paths, int strength, int steps);
+
+signals:
+    Q_SCRIPTABLE void PropertyChanged(const QString &name, const QDBusVariant &value);
+    Q_SCRIPTABLE void ServicesChanged(ConnmanObjectList changed,
+            const QList<QDBusObjectPath> &removed);
+
+private:
+    QMap<QString, ServiceMock *> m_services;
+};
+
+class UtServiceDecoder::ServiceMock : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "net.connman.Service")
+
+public:
+    ServiceMock(const QVariantMap &properties, ManagerMock *manager)
+        : QObject(manager),
+          m_properties(properties)
+    {
+    }
+
+    QVariantMap properties() const { return m_properties; }
+
+    void setProperty(const QString &name, const QVariant &value)
+    {
+        m_properties[name] = value;
+        Q_EMIT PropertyChanged(name, QDBusVariant(value));
+    }
+
+public:
+    Q_SCRIPTABLE QVariantMap GetProperties() const { return m_properties; }
+
+signals:
+    Q_SCRIPTABLE void PropertyChanged(const QString &name, const QDBusVariant &value);
+
+private:
+    QVariantMap m_properties;
+};
+
+} // namespace Tests
+
+using namespace Tests;
+
+/*
+ * \class Tests::UtServiceDecoder
+ */
+
+void UtServiceDecoder::initTestCase()
+{
+    qRegisterMetaType<NetworkServiceChanges::Ref>("NetworkServiceChanges::Ref");
+    QVERIFY(waitForService("net.connman", "/", "net.connman.Manager"));
+}
+
+void UtServiceDecoder::init()
+{
+    m_emitter = nullptr;
+    m_changes.clear();
+
+    m_thread = new QThread;
+    m_decoder = new NetworkServiceDecoder(GENERATION);
+    m_decoder->moveToThread(m_thread);
+    connect(m_thread, SIGNAL(finished()), m_decoder, SLOT(deleteLater()));
+    connect(m_decoder, &NetworkServiceDecoder::changesReady, m_decoder, [this]() {
+        m_emitter = QThread::currentThread();
+    }, Qt::DirectConnection);
+    connect(m_decoder, SIGNAL(changesReady(NetworkServiceChanges::Ref)),
+            this, SLOT(onChangesReady(NetworkServiceChanges::Ref)), Qt::QueuedConnection);
+    m_thread->start();
+}
+
+void UtServiceDecoder::cleanup()
+{
+    QMetaObject::invokeMethod(m_decoder, "stop", Qt::BlockingQueuedConnection);
+    m_thread->quit();
+    QVERIFY(m_thread->wait(SIGNAL_WAIT_TIMEOUT));
+    delete m_thread;
+}
+
+void UtServiceDecoder::testThreadHandOff()
+{
+    QMetaObject::invokeMethod(m_decoder, "start", Qt::QueuedConnection);
+    QVERIFY(waitForSignal(this, SIGNAL(changesReceived())));
+
+    // Decoded on the worker thread, delivered to this one
+    QCOMPARE(m_emitter.loadAcquire(), m_thread);
+    QCOMPARE(m_changes.count(), 1);
+
+    const NetworkServiceChanges::Ref listing(m_changes.first());
+    QVERIFY(listing->listing);
+    QCOMPARE(listing->generation, uint(GENERATION));
+    QCOMPARE(listing->services.count(), (int)SERVICE_COUNT);
+    QCOMPARE(listing->services.at(0).path, servicePath(0));
+    QCOMPARE(listing->services.at(0).name, QString("Wireless 0"));
+    QVERIFY(listing->removed.isEmpty());
+}
+
+void UtServiceDecoder::testFlushCoalescing()
+{
+    QMetaObject::invokeMethod(m_decoder, "start", Qt::QueuedConnection);
+    QVERIFY(waitForSignal(this, SIGNAL(changesReceived())));
+    m_changes.clear();
+
+    // A burst of changes to two services is one change set with the last
+    // values only
+    setStrength(QList<int>() << 0 << 1, 80, 10);
+
+    QVERIFY(waitForSignal(this, SIGNAL(changesReceived())));
+    QTest::qWait(3 * FLUSH_DELAY);
+    QCOMPARE(m_changes.count(), 1);
+
+    const NetworkServiceChanges::Ref changes(m_changes.first());
+    QVERIFY(!changes->listing);
+    QCOMPARE(changes->generation, uint(GENERATION));
+    QCOMPARE(changes->services.count(), 2);
+    QStringList paths;
+    for (const NetworkServiceRecord &record : changes->services) {
+        paths.append(record.path);
+        QCOMPARE(int(record.strength), 80);
+    }
+    paths.sort();
+    QCOMPARE(paths, QStringList() << servicePath(0) << servicePath(1));
+
+    // Setting the same value again is no change
+    m_changes.clear();
+    setStrength(QList<int>() << 0, 80, 1);
+    QTest::qWait(3 * FLUSH_DELAY);
+    QCOMPARE(m_changes.count(), 0);
+}
+
+void UtServiceDecoder::testStaleGeneration()
+{
+    NetworkManager manager;
+    manager.setBackgroundDecoding(true);
+    QTRY_COMPARE(manager.servicesList(QString()).count(), (int)SERVICE_COUNT);
+
+    // Change sets of a decoder that has been replaced are dropped. An
+    // empty listing would remove all services otherwise.
+    QObject *priv = managerPrivate(&manager);
+    QVERIFY(priv);
+
+    NetworkServiceChanges *stale = new NetworkServiceChanges;
+    stale->generation = 0;
+    stale->listing = true;
+    QVERIFY(QMetaObject::invokeMethod(priv, "applyChanges",
+            Q_ARG(NetworkServiceChanges::Ref, NetworkServiceChanges::Ref(stale))));
+
+    QCOMPARE(manager.servicesList(QString()).count(), (int)SERVICE_COUNT);
+
+    // The current decoder keeps delivering
+    setStrength(QList<int>() << 2, 33, 3);
+    QTRY_COMPARE(int(manager.snapshot().service(servicePath(2)).strength), 33);
+}
+
+void UtServiceDecoder::testForegroundSwitch()
+{
+    NetworkManager manager;
+    manager.setBackgroundDecoding(true);
+    QTRY_COMPARE(manager.servicesList(QString()).count(), (int)SERVICE_COUNT);
+
+    // Tear the decoder down with changes in flight. The blocking stop must
+    // not dead lock, whatever it had collected is not applied any more.
+    QDBusInterface mock("net.connman", "/", "net.connman.Manager", bus());
+    mock.asyncCall("mock_setStrength", QStringList() << servicePath(3), 20, 20);
+    manager.setBackgroundDecoding(false);
+    QVERIFY(!manager.backgroundDecoding());
+
+    // The foreground path takes over with a fresh listing
+    QTRY_COMPARE(int(manager.snapshot().service(servicePath(3)).strength), 20);
+    QCOMPARE(manager.servicesList(QString()).count(), (int)SERVICE_COUNT);
+
+    setStrength(QList<int>() << 3, 70, 1);
+    QTRY_COMPARE(int(manager.snapshot().service(servicePath(3)).strength), 70);
+}
+
+void UtServiceDecoder::onChangesReady(const NetworkServiceChanges::Ref &changes)
+{
+    m_changes.append(changes);
+    Q_EMIT changesReceived();
+}
+
+QString UtServiceDecoder::servicePath(int index)
+{
+    return QString("/net/connman/service/wifi_%1").arg(index);
+}
+
+QObject *UtServiceDecoder::managerPrivate(NetworkManager *manager)
+{
+    const QList<QObject *> children(manager->children());
+    for (QObject *child : children) {
+        if (qstrcmp(child->metaObject()->className(), "NetworkManager::Private") == 0)
+            return child;
+    }
+    return nullptr;
+}
+
+void UtServiceDecoder::setStrength(const QList<int> &indices, int strength, int steps)
+{
+    QStringList paths;
+    for (int index : indices)
+        paths.append(servicePath(index));
+
+    QDBusInterface mock("net.connman", "/", "net.connman.Manager", bus());
+    QDBusReply<void> reply = mock.call("mock_setStrength", paths, strength, steps);
+    QVERIFY2(reply.isValid(), qPrintable(reply.error().message()));
+}
+
+/*
+ * \class Tests::UtServiceDecoder::ManagerMock
+ */
+
+UtServiceDecoder::ManagerMock::ManagerMock()
+    : MainObjectMock("net.connman", "/")
+{
+    for (int i = 0; i < SERVICE_COUNT; i++) {
+        QVariantMap properties;
+        properties["Name"] = QString("Wireless %1").arg(i);
+        properties["Type"] = "wifi";
+        properties["State"] = "idle";
+        properties["Strength"] = QVariant::fromValue<uchar>(50);
+        properties["Security"] = QStringList() << "psk";
+        properties["Favorite"] = false;
+        properties["AutoConnect"] = false;
+        properties["Nameservers"] = QStringList() << "10.0.0.1";
+
+        ServiceMock *const service = new ServiceMock(properties, this);
+        if (!bus().registerObject(servicePath(i), service, QDBusConnection::ExportScriptableContents))
+            qFatal("Failed to register service object: %s", qPrintable(bus().lastError().message()));
+        m_services.insert(servicePath(i), service);
+    }
+}
+
+QVariantMap UtServiceDecoder::ManagerMock::GetProperties() const
+{
+    return defaultManagerProperties();
+}
+
+ConnmanObjectList UtServiceDecoder::ManagerMock::GetTechnologies() const
+{
+    return ConnmanObjectList();
+}
+
+ConnmanObjectList UtServiceDecoder::ManagerMock::GetServices() const
+{
+    ConnmanObjectList services;
+    QMapIterator<QString, ServiceMock *> it(m_services);
+    while (it.hasNext()) {
+        it.next();
+
+        ConnmanObject object = {
+            QDBusObjectPath(it.key()),
+            it.value()->properties(),
+        };
+
+        services.append(object);
+    }
+
+    return services;
+}
+
+// Ramps the strength of the services up to the value, one signal per
+// service and step
+void UtServiceDecoder::ManagerMock::mock_setStrength(const QStringList &paths, int strength, int steps)
+{
+    for (int i = steps - 1; i >= 0; --i) {
+        for (const QString &path : paths) {
+            if (ServiceMock *service = m_services.value(path))
+                service->setProperty("Strength", QVariant::fromValue<uchar>(strength - i));
+        }
+    }
+}
+
+TEST_MAIN_WITH_MOCK(UtServiceDecoder, UtServiceDecoder::ManagerMock)
+
+#include "ut_servicedecoder.moc"
@@ -0,0 +1,181 @@
+#include "../libconnman-qt/networkservicerecord.h"
+#include "testbase.h"
+
+namespace Tests {
+
+class UtServiceRecord : public TestBase
+{
+    Q_OBJECT
+
+    enum {
+        SERVICE_COUNT = 500,
+    };
+
+public:
+    class ManagerMock;
+
+private slots:
+    void initTestCase();
+
+    void testDecodeList();
+    void testDecodeListMerge();
+    void benchmarkObjectList();
+    void benchmarkDecodeList();
+
+private:
+    QDBusArgument services() const;
+
+private:
+    QDBusMessage m_reply;
+};
+
+class UtServiceRecord::ManagerMock : public MainObjectMock
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "net.connman.Manager")
+
+public:
+    ManagerMock();
+
+public:
+    Q_SCRIPTABLE ConnmanObjectList GetServices() const;
+
+private:
+    ConnmanObjectList m_services;
+};
+
+} // namespace Tests
+
+using namespace Tests;
+
+/*
+ * \class Tests::UtServiceRecord
+ */
+
+void UtServiceRecord::initTestCase()
+{
+    QVERIFY(waitForService("net.connman", "/", "net.connman.Manager"));
+
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+    m_reply = manager.call("GetServices");
+    QCOMPARE(m_reply.type(), QDBusMessage::ReplyMessage);
+}
+
+QDBusArgument UtServiceRecord::services() const
+{
+    // A fresh copy to read from, the one in the reply stays at the start
+    return m_reply.arguments().at(0).value<QDBusArgument>();
+}
+
+void UtServiceRecord::testDecodeList()
+{
+    const ConnmanObjectList objects(qdbus_cast<ConnmanObjectList>(services()));
+    const QVector<NetworkServiceRecord> records(NetworkServiceRecord::decodeList(services()));
+
+    QCOMPARE(objects.count(), (int)SERVICE_COUNT);
+    QCOMPARE(records.count(), objects.count());
+
+    for (int i = 0; i < objects.count(); i++) {
+        NetworkServiceRecord expected(objects.at(i).objpath.path());
+        expected.update(objects.at(i).properties);
+
+        QCOMPARE(records.at(i).path, expected.path);
+        QCOMPARE(records.at(i).toMap(), expected.toMap());
+    }
+}
+
+void UtServiceRecord::testDecodeListMerge()
+{
+    const QString path("/net/connman/service/wifi_0");
+
+    NetworkServiceRecord known(path);
+    known.bssid = "01:23:45:67:89:ab";
+    known.flags |= NetworkServiceRecord::Saved;
+
+    QHash<QString, NetworkServiceRecord> current;
+    current.insert(path, known);
+
+    const QVector<NetworkServiceRecord> records(NetworkServiceRecord::decodeList(services(), current));
+
+    // Properties not in the payload are kept, reported ones are applied
+    QCOMPARE(records.at(0).path, path);
+    QCOMPARE(records.at(0).bssid, known.bssid);
+    QVERIFY(records.at(0).saved());
+    QCOMPARE(records.at(0).name, QString("Wireless 0"));
+    QVERIFY(records.at(1).bssid.isEmpty());
+    QVERIFY(!records.at(1).saved());
+}
+
+void UtServiceRecord::benchmarkObjectList()
+{
+    QBENCHMARK {
+        const ConnmanObjectList objects(qdbus_cast<ConnmanObjectList>(services()));
+        QVector<NetworkServiceRecord> records;
+        records.reserve(objects.count());
+        for (const ConnmanObject &object : objects) {
+            records.append(NetworkServiceRecord(object.objpath.path()));
+            records.last().update(object.properties);
+        }
+    }
+}
+
+void UtServiceRecord::benchmarkDecodeList()
+{
+    QBENCHMARK {
+        const QVector<NetworkServiceRecord> records(NetworkServiceRecord::decodeList(services()));
+        Q_UNUSED(records)
+    }
+}
+
+/*
+ * \class Tests::UtServiceRecord::ManagerMock
+ */
+
+UtServiceRecord::ManagerMock::ManagerMock()
+    : MainObjectMock("net.connman", "/")
+{
+    for (int i = 0; i < SERVICE_COUNT; i++) {
+        QVariantMap ipv4;
+        ipv4["Method"] = "dhcp";
+        ipv4["Address"] = QString("10.0.%1.%2").arg(i / 256).arg(i % 256);
+        ipv4["Netmask"] = "255.255.255.0";
+        ipv4["Gateway"] = "10.0.0.1";
+
+        QVariantMap ethernet;
+        ethernet["Method"] = "auto";
+        ethernet["Interface"] = "wlan0";
+        ethernet["Address"] = "00:11:22:33:44:55";
+        ethernet["MTU"] = 1500;
+
+        QVariantMap properties;
+        properties["Name"] = QString("Wireless %1").arg(i);
+        properties["Type"] = "wifi";
+        properties["State"] = (i == 0) ? "online" : "idle";
+        properties["Strength"] = QVariant::fromValue<uchar>(i % 100);
+        properties["Security"] = QStringList() << ((i % 3) ? "psk" : "none");
+        properties["Favorite"] = (i % 10 == 0);
+        properties["AutoConnect"] = (i % 10 == 0);
+        properties["Immutable"] = false;
+        properties["Nameservers"] = QStringList() << "10.0.0.1";
+        properties["Domains"] = QStringList();
+        properties["IPv4"] = ipv4;
+        properties["IPv4.Configuration"] = ipv4;
+        properties["Ethernet"] = ethernet;
+
+        ConnmanObject object = {
+            QDBusObjectPath(QString("/net/connman/service/wifi_%1").arg(i)),
+            properties,
+        };
+
+        m_services.append(object);
+    }
+}
+
+ConnmanObjectList UtServiceRecord::ManagerMock::GetServices() const
+{
+    return m_services;
+}
+
+TEST_MAIN_WITH_MOCK(UtServiceRecord, UtServiceRecord::ManagerMock)
+
+#include "ut_servicerecord.moc"
@@ -3,6 +3,7 @@
 #include "../libconnman-qt/connman_session_interface.h"
 #include "../libconnman-qt/networksession.h"
 #include "../libconnman-qt/sessionagent.h"
+#include "../libconnman-qt/sessionpool.h"
 #include "testbase.h"
 
 namespace Tests {
@@ -11,6 +12,11 @@ class UtSession : public TestBase
 {
     Q_OBJECT
 
+    enum {
+        IDLE_GRACE_PERIOD = 500, // [ms]
+        SHORT_WHILE = 200, // [ms]
+    };
+
 public:
     class ManagerMock;
     class SessionMock;
@@ -26,15 +32,22 @@ private slots:
     void testProperties();
     void testWriteProperties_data();
     void testWriteProperties();
+    void testUnchangedSettings();
     void testRequestConnect();
     void testRequestDisconnect();
     void testRequestDestroy();
     void testSetPath();
     void testPropertiesAfterSetPath_data();
     void testPropertiesAfterSetPath();
+    void testPoolSharing();
+    void testPoolMove();
+    void testPoolMoveSettings();
+    void testPoolConnect();
+    void testPoolIdleExpiry();
 
 private:
     QObject *findSessionNotificationAdaptor() const;
+    static NetworkSession *createSession(const QString &path);
 
 private:
     QPointer<NetworkSession> m_session;
@@ -59,11 +72,18 @@ public:
             const QDBusObjectPath &notifier, const QDBusMessage &message);
     Q_SCRIPTABLE void DestroySession(const QDBusObjectPath &path, const QDBusMessage &message);
 
+    // mock API
+    Q_SCRIPTABLE QVariantMap mock_createSettings() const;
+    Q_SCRIPTABLE int mock_changeCount() const;
+    void countChange() { m_changeCount++; }
+
 signals:
     Q_SCRIPTABLE void PropertyChanged(const QString &name, const QVariant &value);
 
 private:
     int m_sessionNextIndex;
+    int m_changeCount;
+    QVariantMap m_createSettings;
     QMap<QString, SessionMock *> m_sessions;
 };
 
@@ -74,7 +94,7 @@ class UtSession::SessionMock : public QObject
 
 public:
     SessionMock(const QString &path, const QString &notifierService,
-        const QString &notifierPath, ManagerMock *manager);
+        const QString &notifierPath, const QVariantMap &settings, ManagerMock *manager);
 
 public:
     Q_SCRIPTABLE void Connect(const QDBusMessage &message);
@@ -177,6 +197,32 @@ void UtSession::testWriteProperties()
     QCOMPARE(m_session->property(QTest::currentDataTag()), newValue);
 }
 
+void UtSession::testUnchangedSettings()
+{
+    SignalSpy stateSpy(m_session, SIGNAL(stateChanged(QString)));
+    SignalSpy nameSpy(m_session, SIGNAL(nameChanged(QString)));
+    SignalSpy settingsSpy(m_session, SIGNAL(settingsChanged(QVariantMap)));
+
+    QVariantMap settings;
+    settings["State"] = m_session->state();
+    settings["Name"] = "Wi-Fi BAR";
+
+    m_session->sessionSettingsUpdated(settings);
+    QCOMPARE(stateSpy.count(), 0);
+    QCOMPARE(nameSpy.count(), 1);
+    QCOMPARE(settingsSpy.count(), 1);
+
+    m_session->sessionSettingsUpdated(settings);
+    QCOMPARE(nameSpy.count(), 1);
+    QCOMPARE(settingsSpy.count(), 1);
+
+    // Back to what the session has
+    settings["Name"] = SessionMock::defaultSettings().value("Name");
+    m_session->sessionSettingsUpdated(settings);
+    QCOMPARE(nameSpy.count(), 2);
+    QCOMPARE(m_session->name(), settings["Name"].toString());
+}
+
 void UtSession::testRequestConnect()
 {
     SignalSpy stateSpy(m_session, SIGNAL(stateChanged(QString)));
@@ -203,7 +249,7 @@ void UtSession::testRequestDisconnect()
 
 void UtSession::testRequestDestroy()
 {
-    SignalSpy releasedSpy(m_session->m_sessionAgent, SIGNAL(released()));
+    SignalSpy releasedSpy(m_session->sessionAgent(), SIGNAL(released()));
 
     m_session->requestDestroy();
 
@@ -252,10 +298,156 @@ void UtSession::testPropertiesAfterSetPath()
     QCOMPARE(m_session->property(QTest::currentDataTag()), expected);
 }
 
+void UtSession::testPoolSharing()
+{
+    const QString path("/ConnmanQmlSessionAgentShared");
+    QSharedPointer<SessionPool> pool(SessionPool::sharedInstance());
+
+    QScopedPointer<NetworkSession> first(createSession(path));
+    QVERIFY(waitForSignal(first.data(), SIGNAL(settingsChanged(QVariantMap))));
+
+    // The same path and settings are the same session
+    QScopedPointer<NetworkSession> second(createSession(path));
+    QVERIFY(first->sessionAgent());
+    QCOMPARE(second->sessionAgent(), first->sessionAgent());
+    QCOMPARE(pool->refCount(first->sessionAgent()), 2);
+
+    // ConnMan doesn't send the settings again, they come from the agent
+    QCOMPARE(second->state(), first->state());
+    QCOMPARE(second->name(), first->name());
+    QCOMPARE(second->ipv4(), first->ipv4());
+
+    second.reset();
+    QCOMPARE(pool->refCount(first->sessionAgent()), 1);
+}
+
+void UtSession::testPoolMove()
+{
+    const QString path("/ConnmanQmlSessionAgentMoved");
+    QSharedPointer<SessionPool> pool(SessionPool::sharedInstance());
+
+    QScopedPointer<NetworkSession> first(createSession(path));
+    QVERIFY(waitForSignal(first.data(), SIGNAL(settingsChanged(QVariantMap))));
+    QScopedPointer<NetworkSession> second(createSession(path));
+    SessionAgent *const shared = first->sessionAgent();
+    QCOMPARE(second->sessionAgent(), shared);
+
+    // Other settings move to a session of their own, the other user stays
+    first->setAllowedBearers(QStringList() << "ethernet");
+    QTRY_VERIFY(first->sessionAgent() != shared);
+    QCOMPARE(second->sessionAgent(), shared);
+    QCOMPARE(pool->refCount(shared), 1);
+    QCOMPARE(pool->refCount(first->sessionAgent()), 1);
+
+    // And the same settings join it again
+    second->setAllowedBearers(QStringList() << "ethernet");
+    QTRY_COMPARE(second->sessionAgent(), first->sessionAgent());
+    QCOMPARE(pool->refCount(first->sessionAgent()), 2);
+    QCOMPARE(pool->refCount(shared), 0);
+}
+
+void UtSession::testPoolMoveSettings()
+{
+    const QString path("/ConnmanQmlSessionAgentMovedSettings");
+    QDBusInterface manager("net.connman", "/", "net.connman.Manager", bus());
+
+    QScopedPointer<NetworkSession> first(createSession(path));
+    QVERIFY(waitForSignal(first.data(), SIGNAL(settingsChanged(QVariantMap))));
+    QScopedPointer<NetworkSession> second(createSession(path));
+    SessionAgent *const shared = first->sessionAgent();
+    QCOMPARE(second->sessionAgent(), shared);
+    QCOMPARE(first->name(), SessionMock::defaultSettings().value("Name").toString());
+
+    QDBusReply<int> changes = manager.call("mock_changeCount");
+    QVERIFY2(changes.isValid(), qPrintable(changes.error().message()));
+
+    QSignalSpy nameSpy(first.data(), SIGNAL(nameChanged(QString)));
+    QSignalSpy ipv4Spy(first.data(), SIGNAL(ipv4Changed(QVariantMap)));
+    first->setAllowedBearers(QStringList() << "ethernet");
+    first->setConnectionType("local");
+    QTRY_VERIFY(first->sessionAgent() != shared);
+
+    // The new session is created with the settings, not changed after
+    QDBusReply<QVariantMap> created = manager.call("mock_createSettings");
+    QVERIFY2(created.isValid(), qPrintable(created.error().message()));
+    QCOMPARE(created.value().value("AllowedBearers").toStringList(), QStringList() << "ethernet");
+    QCOMPARE(created.value().value("ConnectionType").toString(), QString("local"));
+    QDBusReply<int> changesAfter = manager.call("mock_changeCount");
+    QCOMPARE(changesAfter.value(), changes.value());
+
+    // What the previous session reported is cleared until the new one
+    // reports its own
+    QTRY_COMPARE(nameSpy.count(), 2);
+    QCOMPARE(nameSpy.at(0).at(0).toString(), QString());
+    QCOMPARE(nameSpy.at(1).at(0).toString(), SessionMock::defaultSettings().value("Name").toString());
+    QCOMPARE(ipv4Spy.count(), 2);
+    QVERIFY(ipv4Spy.at(0).at(0).toMap().isEmpty());
+    QCOMPARE(first->allowedBearers(), QStringList() << "ethernet");
+    QCOMPARE(first->connectionType(), QString("local"));
+
+    // The other user keeps the shared session and its settings
+    QCOMPARE(second->sessionAgent(), shared);
+    QCOMPARE(second->name(), SessionMock::defaultSettings().value("Name").toString());
+}
+
+void UtSession::testPoolConnect()
+{
+    const QString path("/ConnmanQmlSessionAgentConnected");
+
+    QScopedPointer<NetworkSession> first(createSession(path));
+    QVERIFY(waitForSignal(first.data(), SIGNAL(settingsChanged(QVariantMap))));
+    QScopedPointer<NetworkSession> second(createSession(path));
+    QCOMPARE(second->sessionAgent(), first->sessionAgent());
+
+    first->requestConnect();
+    QTRY_COMPARE(first->state(), QString("connected"));
+    QTRY_COMPARE(second->state(), QString("connected"));
+    second->requestConnect();
+
+    // Still connected for the other one
+    first->requestDisconnect();
+    QTest::qWait(SHORT_WHILE);
+    QCOMPARE(second->state(), QString("connected"));
+
+    // Until the last connect is withdrawn
+    second->requestDisconnect();
+    QTRY_COMPARE(second->state(), QString("disconnect"));
+    QCOMPARE(first->state(), QString("disconnect"));
+}
+
+void UtSession::testPoolIdleExpiry()
+{
+    const QString path("/ConnmanQmlSessionAgentIdle");
+    QSharedPointer<SessionPool> pool(SessionPool::sharedInstance());
+    const int gracePeriod = pool->idleGracePeriod();
+    pool->setIdleGracePeriod(IDLE_GRACE_PERIOD);
+
+    NetworkSession *session = createSession(path);
+    QVERIFY(waitForSignal(session, SIGNAL(settingsChanged(QVariantMap))));
+    QPointer<SessionAgent> agent(session->sessionAgent());
+    delete session;
+
+    // Kept unused for the grace period and taken again
+    QVERIFY(agent);
+    QCOMPARE(pool->refCount(agent), 0);
+    session = createSession(path);
+    QCOMPARE(session->sessionAgent(), agent.data());
+    QCOMPARE(pool->refCount(agent), 1);
+    QCOMPARE(session->name(), SessionMock::defaultSettings().value("Name").toString());
+    delete session;
+
+    // Destroyed once it has passed
+    QTest::qWait(IDLE_GRACE_PERIOD / 2);
+    QVERIFY(agent);
+    QTRY_VERIFY(agent.isNull());
+
+    pool->setIdleGracePeriod(gracePeriod);
+}
+
 QObject *UtSession::findSessionNotificationAdaptor() const
 {
     QObject *sessionNotificationAdaptor = 0;
-    Q_FOREACH (QObject *const object, m_session->m_sessionAgent->findChildren<QObject *>()) {
+    Q_FOREACH (QObject *const object, m_session->sessionAgent()->findChildren<QObject *>()) {
         if (object->inherits("SessionNotificationAdaptor")) {
             sessionNotificationAdaptor = object;
             break;
@@ -265,13 +457,21 @@ QObject *UtSession::findSessionNotificationAdaptor() const
     return sessionNotificationAdaptor;
 }
 
+NetworkSession *UtSession::createSession(const QString &path)
+{
+    NetworkSession *const session = new NetworkSession;
+    session->setPath(path);
+    return session;
+}
+
 /*
  * \class Tests::UtSession::ManagerMock
  */
 
 UtSession::ManagerMock::ManagerMock()
     : MainObjectMock("net.connman", "/"),
-      m_sessionNextIndex(0)
+      m_sessionNextIndex(0),
+      m_changeCount(0)
 {
 }
 
@@ -305,17 +505,13 @@ ConnmanObjectList UtSession::ManagerMock::GetServices() const
 QDBusObjectPath UtSession::ManagerMock::CreateSession(const QVariantMap &settings,
         const QDBusObjectPath &notifier, const QDBusMessage &message)
 {
-    if (!settings.isEmpty()) {
-        const QString err = QString("Unimplemented case: settings is not empty");
-        qWarning("%s: %s", Q_FUNC_INFO, qPrintable(err));
-        bus().send(message.createErrorReply(QDBusError::Failed, err));
-        return QDBusObjectPath();
-    }
+    m_createSettings = settings;
 
     const int index = m_sessionNextIndex++;
     const QString path = QString("/session%1").arg(index);
 
-    SessionMock *const session = new SessionMock(path, message.service(), notifier.path(), this);
+    SessionMock *const session = new SessionMock(path, message.service(), notifier.path(),
+            settings, this);
 
     if (!bus().registerObject(path, session, QDBusConnection::ExportScriptableContents)) {
         const QString err = QString("Failed to register session object: %1")
@@ -355,18 +551,31 @@ void UtSession::ManagerMock::DestroySession(const QDBusObjectPath &path, const Q
     session->deleteLater();
 }
 
+QVariantMap UtSession::ManagerMock::mock_createSettings() const
+{
+    return m_createSettings;
+}
+
+int UtSession::ManagerMock::mock_changeCount() const
+{
+    return m_changeCount;
+}
+
 /*
  * \class Tests::UtSession::SessionMock
  */
 
 UtSession::SessionMock::SessionMock(const QString &path, const QString &notifierService,
-        const QString &notifierPath, ManagerMock *manager)
+        const QString &notifierPath, const QVariantMap &settings, ManagerMock *manager)
     : QObject(manager),
       m_path(path),
       m_notifierService(notifierService),
       m_notifierPath(notifierPath),
       m_settings(defaultSettings())
 {
+    for (QVariantMap::ConstIterator it = settings.constBegin(); it != settings.constEnd(); ++it)
+        m_settings[it.key()] = it.value();
+
     QTimer::singleShot(0, this, SLOT(notifyInitialUpdate()));
 }
 
@@ -415,6 +624,7 @@ void UtSession::SessionMock::Change(const QString &name, const QDBusVariant &val
         const QDBusMessage &message)
 {
     m_settings[name] = value.variant();
+    manager()->countChange();
 
     bus().send(message.createReply());
 